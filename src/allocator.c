@@ -0,0 +1,173 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "allocator.h"
+
+#include <string.h>
+
+void* MMUAllocate(const MMUAllocator* allocator, size_t size) {
+    if (!allocator) {
+        return malloc(size);
+    }
+    return allocator->allocate(size, allocator->userData);
+}
+
+void* MMUReallocate(const MMUAllocator* allocator, void* ptr, size_t size) {
+    if (!allocator) {
+        return realloc(ptr, size);
+    }
+    return allocator->reallocate(ptr, size, allocator->userData);
+}
+
+void MMUDeallocate(const MMUAllocator* allocator, void* ptr) {
+    if (!allocator) {
+        free(ptr);
+        return;
+    }
+    allocator->deallocate(ptr, allocator->userData);
+}
+
+// Every arena allocation is preceded by its size, padded so that the
+// memory handed out keeps malloc's alignment
+enum {
+    MMUArenaAlignment = 16,
+    MMUArenaHeaderSize = 16
+};
+
+static size_t MMUArenaFootprint(size_t size) {
+    return MMUArenaHeaderSize + ((size + MMUArenaAlignment - 1) & ~(size_t)(MMUArenaAlignment - 1));
+}
+
+static int MMUArenaOwns(MMUArena* arena, void* ptr) {
+    return (char*)ptr >= arena->block && (char*)ptr < arena->block + arena->capacity;
+}
+
+static char* MMUArenaHeader(void* ptr) {
+    return (char*)ptr - MMUArenaHeaderSize;
+}
+
+static size_t MMUArenaSize(void* ptr) {
+    size_t size;
+    memcpy(&size, MMUArenaHeader(ptr), sizeof(size));
+    return size;
+}
+
+static void* MMUArenaAllocate(size_t size, void* userData) {
+    MMUArena* arena = (MMUArena*)userData;
+    size_t footprint = MMUArenaFootprint(size);
+    char* header;
+
+    if (arena->capacity - arena->used < footprint) {
+        arena->overflow += footprint;
+        return malloc(size);
+    }
+
+    header = arena->block + arena->used;
+    memcpy(header, &size, sizeof(size));
+    arena->last = arena->used;
+    arena->used += footprint;
+    return header + MMUArenaHeaderSize;
+}
+
+static void MMUArenaDeallocate(void* ptr, void* userData) {
+    MMUArena* arena = (MMUArena*)userData;
+
+    if (!ptr) {
+        return;
+    }
+    if (!MMUArenaOwns(arena, ptr)) {
+        free(ptr);
+        return;
+    }
+
+    // Only the most recent allocation can be given back
+    if (MMUArenaHeader(ptr) == arena->block + arena->last) {
+        arena->used = arena->last;
+    }
+}
+
+static void* MMUArenaReallocate(void* ptr, size_t size, void* userData) {
+    MMUArena* arena = (MMUArena*)userData;
+    size_t oldSize;
+    void* newPtr;
+
+    if (!ptr) {
+        return MMUArenaAllocate(size, userData);
+    }
+    if (!MMUArenaOwns(arena, ptr)) {
+        return realloc(ptr, size);
+    }
+
+    oldSize = MMUArenaSize(ptr);
+    if (MMUArenaHeader(ptr) == arena->block + arena->last) {
+        // The most recent allocation can grow or shrink in place
+        size_t footprint = MMUArenaFootprint(size);
+        if (arena->capacity - arena->last >= footprint) {
+            memcpy(MMUArenaHeader(ptr), &size, sizeof(size));
+            arena->used = arena->last + footprint;
+            return ptr;
+        }
+    } else if (size <= oldSize) {
+        return ptr;
+    }
+
+    newPtr = MMUArenaAllocate(size, userData);
+    if (newPtr) {
+        memcpy(newPtr, ptr, oldSize < size ? oldSize : size);
+    }
+    return newPtr;
+}
+
+void mmuArenaInit(MMUArena* arena, size_t capacity) {
+    arena->allocator.allocate = MMUArenaAllocate;
+    arena->allocator.reallocate = MMUArenaReallocate;
+    arena->allocator.deallocate = MMUArenaDeallocate;
+    arena->allocator.userData = arena;
+
+    arena->block = capacity ? malloc(capacity) : NULL;
+    arena->capacity = arena->block ? capacity : 0;
+    arena->used = 0;
+    arena->last = 0;
+    arena->overflow = 0;
+}
+
+void mmuArenaDestroy(MMUArena* arena) {
+    free(arena->block);
+    arena->block = NULL;
+    arena->capacity = 0;
+}
+
+void mmuArenaReset(MMUArena* arena) {
+    if (arena->overflow) {
+        // Grow to fit everything the last round needed, with some headroom
+        size_t capacity = arena->capacity + arena->overflow;
+        capacity += capacity / 4;
+
+        free(arena->block);
+        arena->block = malloc(capacity);
+        arena->capacity = arena->block ? capacity : 0;
+        arena->overflow = 0;
+    }
+
+    arena->used = 0;
+    arena->last = 0;
+}
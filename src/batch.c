@@ -0,0 +1,337 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+
+#include "allocator.h"
+#include "document.h"
+#include "html-parser.h"
+
+#include <libxml/parser.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+// Batches are split into one contiguous range per worker. Workers take
+// documents from the front of their own range and, once it is empty, steal
+// single documents from the ranges of the others, so uneven document sizes
+// still keep every thread busy without any locking.
+//
+// The threads belong to an MMUBatchPool and wait for the next batch in
+// between, so only creating and destroying a pool starts and joins them.
+
+enum {
+    MMUBatchCacheLineSize = 64
+};
+
+typedef struct MMUBatchWorker {
+    // Next unclaimed document of this worker's range, claimed with a
+    // fetch-add by the owner and by thieves alike
+    atomic_size_t next;
+    size_t end;
+    char padding[MMUBatchCacheLineSize];
+
+    struct MMUBatchPool* pool;
+    unsigned int index;
+    pthread_t thread;
+    // A copy of the batch options pointing at worker-local stats, merged
+    // once the batch is done
+    MMUOptions options;
+    MMUStats stats;
+} MMUBatchWorker;
+
+typedef struct MMUBatch {
+    const char* const* inputs;
+    const MMUCallbacks* callbacks;
+    const MMUOptions* options;
+    void* const* callbackContexts;
+    MMUDocument* documents;
+    MMUStatus* statuses;
+} MMUBatch;
+
+struct MMUBatchPool {
+    const MMUAllocator* allocator;
+    // The calling thread is the first worker, the rest have threads
+    MMUBatchWorker* workers;
+    unsigned int workerCount;
+
+    // Held for a whole batch, so that batches from different threads take
+    // turns
+    pthread_mutex_t batchLock;
+    pthread_mutex_t lock;
+    // Signalled when a batch is started or the pool is stopping
+    pthread_cond_t started;
+    // Signalled when the last thread is done with a batch
+    pthread_cond_t finished;
+    const MMUBatch* batch;
+    unsigned long generation;
+    unsigned int running;
+    int stopping;
+};
+
+static pthread_once_t libxml2Initialised = PTHREAD_ONCE_INIT;
+
+static void initialiseLibxml2(void) {
+    xmlInitParser();
+}
+
+static int claimDocument(MMUBatchWorker* worker, size_t* index) {
+    // Cheap check first, so that drained ranges aren't hammered by thieves
+    if (atomic_load_explicit(&worker->next, memory_order_relaxed) >= worker->end) {
+        return 0;
+    }
+    *index = atomic_fetch_add_explicit(&worker->next, 1, memory_order_relaxed);
+    return *index < worker->end;
+}
+
+static int nextDocument(MMUBatchWorker* worker, size_t* index) {
+    MMUBatchPool* pool = worker->pool;
+    unsigned int i;
+
+    if (claimDocument(worker, index)) {
+        return 1;
+    }
+    for (i = 1; i < pool->workerCount; ++i) {
+        if (claimDocument(pool->workers + (worker->index + i) % pool->workerCount, index)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void parseDocument(const MMUBatch* batch, MMUHtmlParser* parser, size_t index) {
+    const char* html = batch->inputs[index];
+    MMUStatus status;
+
+    if (batch->documents) {
+        MMUDocument* document = batch->documents + index;
+        MMUDocumentPrepare(document, parser->builder->options, strlen(html));
+        MMUHtmlParserReset(parser, document);
+    } else {
+        MMUHtmlParserReset(parser, batch->callbackContexts ? batch->callbackContexts[index] : NULL);
+    }
+    status = MMUHtmlParserParse(parser, html, strlen(html));
+    if (batch->statuses) {
+        batch->statuses[index] = status;
+    }
+}
+
+// Each batch may come with other callbacks and options, so the parser is
+// only kept for the length of one
+static void runBatch(MMUBatchWorker* worker, const MMUBatch* batch) {
+    MMUHtmlParser parser[1];
+    size_t index;
+
+    MMUHtmlParserInit(parser, batch->callbacks, &worker->options, NULL);
+    while (nextDocument(worker, &index)) {
+        parseDocument(batch, parser, index);
+    }
+    MMUHtmlParserDestroy(parser);
+}
+
+static void* runWorker(void* data) {
+    MMUBatchWorker* worker = (MMUBatchWorker*)data;
+    MMUBatchPool* pool = worker->pool;
+    unsigned long generation = 0;
+
+    for (;;) {
+        const MMUBatch* batch;
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == generation && !pool->stopping) {
+            pthread_cond_wait(&pool->started, &pool->lock);
+        }
+        if (pool->stopping) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        generation = pool->generation;
+        batch = pool->batch;
+        pthread_mutex_unlock(&pool->lock);
+
+        runBatch(worker, batch);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->finished);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+unsigned int MMUBatchDefaultThreadCount(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (unsigned int)cpus : 1;
+}
+
+MMUBatchPool* mmuBatchPoolCreate(unsigned int threadCount, const MMUAllocator* allocator) {
+    MMUBatchPool* pool;
+    unsigned int i;
+
+    if (threadCount == 0) {
+        threadCount = MMUBatchDefaultThreadCount();
+    }
+
+    pthread_once(&libxml2Initialised, initialiseLibxml2);
+
+    pool = MMUAllocate(allocator, sizeof(MMUBatchPool));
+    memset(pool, 0, sizeof(*pool));
+    pool->allocator = allocator;
+    pool->workers = MMUAllocate(allocator, threadCount * sizeof(MMUBatchWorker));
+    pthread_mutex_init(&pool->batchLock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->started, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+
+    for (i = 0; i < threadCount; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+    // A single thread pool doesn't start any threads at all, and one whose
+    // threads can't all be started makes do with those which were
+    pool->workerCount = 1;
+    for (i = 1; i < threadCount; ++i) {
+        if (pthread_create(&pool->workers[i].thread, NULL, runWorker, pool->workers + i) != 0) {
+            break;
+        }
+        ++pool->workerCount;
+    }
+    return pool;
+}
+
+void mmuBatchPoolDestroy(MMUBatchPool* pool) {
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->started);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->workerCount; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->started);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->batchLock);
+    MMUDeallocate(pool->allocator, pool->workers);
+    MMUDeallocate(pool->allocator, pool);
+}
+
+static void parseBatch(MMUBatchPool* pool, const MMUBatch* batch, size_t count) {
+    const MMUOptions* options = batch->options;
+    unsigned int workerCount;
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->batchLock);
+
+    workerCount = pool->workerCount;
+    for (i = 0; i < workerCount; ++i) {
+        MMUBatchWorker* worker = pool->workers + i;
+        atomic_init(&worker->next, count * i / workerCount);
+        worker->end = count * (i + 1) / workerCount;
+        worker->options = *options;
+        memset(&worker->stats, 0, sizeof(worker->stats));
+        worker->options.stats = options->stats ? &worker->stats : NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->batch = batch;
+    pool->running = workerCount - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->started);
+    pthread_mutex_unlock(&pool->lock);
+
+    runBatch(pool->workers, batch);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pool->batch = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (options->stats) {
+        for (i = 0; i < workerCount; ++i) {
+            mmuStatsMerge(options->stats, &pool->workers[i].stats);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->batchLock);
+}
+
+void mmuParseHtmlBatchPooled(MMUBatchPool* pool, const char* const* inputs, size_t count,
+        const MMUCallbacks* callbacks, const MMUOptions* options,
+        void* const* callbackContexts, MMUStatus* statuses) {
+    MMUBatch batch;
+    batch.inputs = inputs;
+    batch.callbacks = callbacks;
+    batch.options = options;
+    batch.callbackContexts = callbackContexts;
+    batch.documents = NULL;
+    batch.statuses = statuses;
+    parseBatch(pool, &batch, count);
+}
+
+void mmuParseHtmlDocumentBatchPooled(MMUBatchPool* pool, const char* const* inputs, size_t count,
+        const MMUOptions* options, MMUDocument* documents, MMUStatus* statuses) {
+    MMUBatch batch;
+    batch.inputs = inputs;
+    batch.callbacks = &mmuDocumentCallbacks;
+    batch.options = options;
+    batch.callbackContexts = NULL;
+    batch.documents = documents;
+    batch.statuses = statuses;
+    parseBatch(pool, &batch, count);
+}
+
+// The one-off versions start no more threads than there are documents
+
+static unsigned int oneOffThreadCount(size_t count, unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = MMUBatchDefaultThreadCount();
+    }
+    if (threadCount > count) {
+        threadCount = count ? (unsigned int)count : 1;
+    }
+    return threadCount;
+}
+
+void mmuParseHtmlBatch(const char* const* inputs, size_t count,
+        const MMUCallbacks* callbacks, const MMUOptions* options,
+        void* const* callbackContexts, MMUStatus* statuses, unsigned int threadCount) {
+    MMUBatchPool* pool = mmuBatchPoolCreate(oneOffThreadCount(count, threadCount), options->allocator);
+    mmuParseHtmlBatchPooled(pool, inputs, count, callbacks, options, callbackContexts, statuses);
+    mmuBatchPoolDestroy(pool);
+}
+
+void mmuParseHtmlDocumentBatch(const char* const* inputs, size_t count,
+        const MMUOptions* options, MMUDocument* documents, MMUStatus* statuses,
+        unsigned int threadCount) {
+    MMUBatchPool* pool = mmuBatchPoolCreate(oneOffThreadCount(count, threadCount), options->allocator);
+    mmuParseHtmlDocumentBatchPooled(pool, inputs, count, options, documents, statuses);
+    mmuBatchPoolDestroy(pool);
+}
@@ -0,0 +1,609 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "html-parser.h"
+
+#include <libxml/parser.h>
+#include <libxml/xmlmemory.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Throughput benchmark. Every category of the corpus is parsed by every
+// back-end in a forked child process, so that peak RSS is per run. Results
+// are printed as a table, or as JSON with --json for comparing commits.
+
+typedef struct BenchText {
+    char* data;
+    size_t len;
+    size_t capacity;
+} BenchText;
+
+typedef struct BenchCorpus {
+    BenchText* docs;
+    size_t count;
+    size_t bytes;
+} BenchCorpus;
+
+typedef struct BenchConfig {
+    const char* backend;
+    const char* category;
+    size_t docs;
+    unsigned int iterations;
+    unsigned int seed;
+    int json;
+    char** files;
+    int fileCount;
+} BenchConfig;
+
+enum BenchBackend {
+    BENCH_BACKEND_LIBXML2
+  , BENCH_BACKEND_STREAM
+  , BENCH_BACKEND_NATIVE
+  , BENCH_BACKEND_COUNT
+};
+
+static const char* const backendNames[BENCH_BACKEND_COUNT] = {
+    "libxml2",
+    "stream",
+    "native"
+};
+
+enum BenchCategory {
+    BENCH_CATEGORY_SNIPPETS
+  , BENCH_CATEGORY_ARTICLES
+  , BENCH_CATEGORY_LISTS
+  , BENCH_CATEGORY_LINKS
+  , BENCH_CATEGORY_ENTITIES
+  , BENCH_CATEGORY_TAG_SOUP
+  , BENCH_CATEGORY_FILES
+  , BENCH_CATEGORY_COUNT
+};
+
+static const char* const categoryNames[BENCH_CATEGORY_COUNT] = {
+    "snippets",
+    "articles",
+    "lists",
+    "links",
+    "entities",
+    "tagsoup",
+    "files"
+};
+
+// Documents generated per category by default, articles are much larger
+// so fewer of them are needed
+static const size_t defaultDocs[BENCH_CATEGORY_COUNT] = {
+    20000, 200, 1000, 2000, 2000, 2000, 0
+};
+
+// Allocation counting
+
+static size_t allocationCount;
+
+static void* countMalloc(size_t size) {
+    ++allocationCount;
+    return malloc(size);
+}
+
+static void* countRealloc(void* ptr, size_t size) {
+    ++allocationCount;
+    return realloc(ptr, size);
+}
+
+static char* countStrdup(const char* str) {
+    ++allocationCount;
+    return strdup(str);
+}
+
+static void* countAllocate(size_t size, void* userData) {
+    return countMalloc(size);
+}
+
+static void* countReallocate(void* ptr, size_t size, void* userData) {
+    return countRealloc(ptr, size);
+}
+
+static void countDeallocate(void* ptr, void* userData) {
+    free(ptr);
+}
+
+static const MMUAllocator countingAllocator = {
+    countAllocate,
+    countReallocate,
+    countDeallocate,
+    NULL
+};
+
+// Corpus generation
+
+static unsigned int randomState;
+
+static unsigned int nextRandom(void) {
+    // xorshift32, the corpus only has to be varied and reproducible
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static unsigned int randomBelow(unsigned int n) {
+    return nextRandom() % n;
+}
+
+static void textReserve(BenchText* text, size_t len) {
+    if (text->capacity - text->len < len + 1) {
+        size_t capacity = text->capacity ? text->capacity : 256;
+        while (capacity - text->len < len + 1) {
+            capacity *= 2;
+        }
+        text->data = realloc(text->data, capacity);
+        text->capacity = capacity;
+    }
+}
+
+static void textAppend(BenchText* text, const char* str) {
+    size_t len = strlen(str);
+    textReserve(text, len);
+    memcpy(text->data + text->len, str, len + 1);
+    text->len += len;
+}
+
+static void textAppendf(BenchText* text, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    textAppend(text, line);
+}
+
+static const char* const words[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "markup",
+    "parser", "paragraph", "lorem", "ipsum", "dolor", "sit", "amet", "style",
+    "callback", "buffer", "node", "text", "link", "bold", "and", "of", "to",
+    "caf\xC3\xA9", "na\xC3\xAFve", "\xE6\x97\xA5\xE6\x9C\xAC", "\xF0\x9F\x98\x80"
+};
+
+static void appendWords(BenchText* text, unsigned int count) {
+    unsigned int i;
+    for (i = 0; i < count; ++i) {
+        if (i > 0) {
+            textAppend(text, " ");
+        }
+        textAppend(text, words[randomBelow(sizeof(words) / sizeof(words[0]))]);
+    }
+}
+
+// A sentence with the occasional inline element
+static void appendSentence(BenchText* text) {
+    unsigned int parts = 1 + randomBelow(4);
+    unsigned int i;
+    for (i = 0; i < parts; ++i) {
+        static const char* const inlineTags[] = { "b", "i", "em", "strong", "u" };
+        unsigned int kind = randomBelow(8);
+        if (i > 0) {
+            textAppend(text, " ");
+        }
+        if (kind < 2) {
+            const char* tag = inlineTags[randomBelow(5)];
+            textAppendf(text, "<%s>", tag);
+            appendWords(text, 1 + randomBelow(4));
+            textAppendf(text, "</%s>", tag);
+        } else if (kind == 2) {
+            textAppendf(text, "<a href=\"https://example.com/%u\">", nextRandom() % 100000);
+            appendWords(text, 1 + randomBelow(3));
+            textAppend(text, "</a>");
+        } else {
+            appendWords(text, 3 + randomBelow(10));
+        }
+    }
+    textAppend(text, ".");
+}
+
+static void generateSnippet(BenchText* text) {
+    unsigned int sentences = 1 + randomBelow(3);
+    unsigned int i;
+    for (i = 0; i < sentences; ++i) {
+        appendSentence(text);
+        if (randomBelow(4) == 0) {
+            textAppend(text, "<br>");
+        }
+    }
+}
+
+static void generateArticle(BenchText* text) {
+    unsigned int sections = 5 + randomBelow(10);
+    unsigned int i, j;
+    textAppend(text, "<!DOCTYPE html><html><head><title>Article</title></head><body>");
+    for (i = 0; i < sections; ++i) {
+        unsigned int level = 1 + randomBelow(3);
+        textAppendf(text, "<h%u>", level);
+        appendWords(text, 2 + randomBelow(5));
+        textAppendf(text, "</h%u>", level);
+        for (j = 3 + randomBelow(8); j > 0; --j) {
+            unsigned int sentences = 3 + randomBelow(8);
+            textAppend(text, "<p>");
+            while (sentences-- > 0) {
+                appendSentence(text);
+                textAppend(text, " ");
+            }
+            textAppend(text, "</p>\n");
+        }
+    }
+    textAppend(text, "</body></html>");
+}
+
+static void appendList(BenchText* text, unsigned int depth) {
+    const char* tag = randomBelow(2) ? "ul" : "ol";
+    unsigned int items = 1 + randomBelow(3);
+    textAppendf(text, "<%s>", tag);
+    while (items-- > 0) {
+        textAppend(text, "<li>");
+        appendWords(text, 1 + randomBelow(6));
+        if (depth > 0 && randomBelow(3) > 0) {
+            appendList(text, depth - 1);
+        }
+        textAppend(text, "</li>");
+    }
+    textAppendf(text, "</%s>", tag);
+}
+
+static void generateLists(BenchText* text) {
+    appendList(text, 2 + randomBelow(7));
+}
+
+static void generateLinks(BenchText* text) {
+    unsigned int links = 20 + randomBelow(60);
+    textAppend(text, "<p>");
+    while (links-- > 0) {
+        textAppendf(text, "<a class=\"link\" href=\"https://example.com/path/%u?q=%u&amp;page=%u\" rel=nofollow>",
+                nextRandom() % 100000, nextRandom() % 1000, randomBelow(10));
+        appendWords(text, 1 + randomBelow(3));
+        textAppend(text, "</a>, ");
+    }
+    textAppend(text, "</p>");
+}
+
+static void generateEntities(BenchText* text) {
+    static const char* const entities[] = {
+        "&amp;", "&lt;", "&gt;", "&quot;", "&nbsp;", "&eacute;", "&copy;", "&mdash;",
+        "&#233;", "&#x1F600;", "&#8212;", "&hellip;", "&unknown;", "&amp"
+    };
+    unsigned int runs = 50 + randomBelow(100);
+    textAppend(text, "<p>");
+    while (runs-- > 0) {
+        textAppend(text, entities[randomBelow(sizeof(entities) / sizeof(entities[0]))]);
+        if (randomBelow(2)) {
+            appendWords(text, 1 + randomBelow(2));
+        }
+    }
+    textAppend(text, "</p>");
+}
+
+static void generateTagSoup(BenchText* text) {
+    static const char* const pieces[] = {
+        "<b>", "</b>", "<i>", "</i>", "<p>", "</p>", "<a href=x>", "</a>", "<div>",
+        "</div>", "<table><tr><td>", "</td>", "<li>", "<ul>", "</ul>", "<br>", "</br>",
+        "<unknown attr='1'>", "</unknown>", "<!-- comment -->", "<script>var x = '</b>';</script>",
+        "<style>p { }</style>", "a < b", "&", "&#;", "<h2>", "</h3>", "<span", ">",
+        "<em><strong>", "</em></strong>", "\"", "<![CDATA[x]]>", "<?pi?>"
+    };
+    unsigned int count = 50 + randomBelow(200);
+    while (count-- > 0) {
+        if (randomBelow(3) == 0) {
+            appendWords(text, 1 + randomBelow(3));
+        } else {
+            textAppend(text, pieces[randomBelow(sizeof(pieces) / sizeof(pieces[0]))]);
+        }
+    }
+}
+
+static BenchText readFile(const char* path) {
+    BenchText text = { NULL, 0, 0 };
+    FILE* file = fopen(path, "rb");
+    char chunk[65536];
+    size_t len;
+
+    textReserve(&text, 0);
+    if (!file) {
+        fprintf(stderr, "bench: cannot open %s\n", path);
+        exit(1);
+    }
+    while ((len = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        textReserve(&text, len);
+        memcpy(text.data + text.len, chunk, len);
+        text.len += len;
+    }
+    text.data[text.len] = '\0';
+    fclose(file);
+    return text;
+}
+
+static void generateCorpus(BenchCorpus* corpus, int category, const BenchConfig* config) {
+    size_t i;
+
+    if (category == BENCH_CATEGORY_FILES) {
+        corpus->count = config->fileCount;
+    } else {
+        corpus->count = config->docs ? config->docs : defaultDocs[category];
+    }
+    corpus->docs = calloc(corpus->count, sizeof(BenchText));
+    corpus->bytes = 0;
+
+    randomState = config->seed * 2654435761u + category + 1;
+    for (i = 0; i < corpus->count; ++i) {
+        BenchText* text = corpus->docs + i;
+        switch (category) {
+            case BENCH_CATEGORY_SNIPPETS:
+                generateSnippet(text);
+                break;
+            case BENCH_CATEGORY_ARTICLES:
+                generateArticle(text);
+                break;
+            case BENCH_CATEGORY_LISTS:
+                generateLists(text);
+                break;
+            case BENCH_CATEGORY_LINKS:
+                generateLinks(text);
+                break;
+            case BENCH_CATEGORY_ENTITIES:
+                generateEntities(text);
+                break;
+            case BENCH_CATEGORY_TAG_SOUP:
+                generateTagSoup(text);
+                break;
+            case BENCH_CATEGORY_FILES:
+                *text = readFile(config->files[i]);
+                break;
+        }
+        corpus->bytes += text->len;
+    }
+}
+
+// Parsing
+
+static size_t outputBytes;
+
+static void onAppendText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
+    outputBytes += len;
+}
+
+static void onStartLink(const char* href, void* callbackContext) {
+}
+
+static void onEndLink(void* callbackContext) {
+}
+
+static void onStartListItem(int depth, unsigned int index, void* callbackContext) {
+}
+
+static void onEndListItem(void* callbackContext) {
+}
+
+static void onFinish(void* callbackContext) {
+}
+
+static const MMUCallbacks callbacks = {
+    .appendText = onAppendText,
+    .startLink = onStartLink,
+    .endLink = onEndLink,
+    .startListItem = onStartListItem,
+    .endListItem = onEndListItem,
+    .finish = onFinish
+};
+
+static void parseDocument(const BenchText* text, int backend, const MMUOptions* options) {
+    if (backend == BENCH_BACKEND_STREAM) {
+        static const size_t chunkSize = 4096;
+        MMUHtmlParser parser[1];
+        size_t offset;
+
+        MMUHtmlParserInit(parser, &callbacks, options, NULL);
+        for (offset = 0; offset < text->len; offset += chunkSize) {
+            size_t len = text->len - offset < chunkSize ? text->len - offset : chunkSize;
+            MMUHtmlParserFeed(parser, text->data + offset, len);
+        }
+        MMUHtmlParserEnd(parser);
+        MMUHtmlParserDestroy(parser);
+    } else {
+        mmuParseHtml(text->data, &callbacks, options, NULL);
+    }
+}
+
+static double nowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const double* sorted, size_t count, double fraction) {
+    size_t index = (size_t)(fraction * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void runBenchmark(int backend, int category, const BenchConfig* config) {
+    BenchCorpus corpus;
+    MMUOptions options;
+    double* latencies;
+    double start, total;
+    size_t parses, i;
+    unsigned int iteration;
+    struct rusage usage;
+
+    generateCorpus(&corpus, category, config);
+    if (corpus.count == 0) {
+        return;
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.lineSeparator = "\n";
+    options.paragraphSeparator = "\n\n";
+    options.htmlBackend = backend == BENCH_BACKEND_NATIVE ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2;
+    options.allocator = &countingAllocator;
+
+    // Warm up caches and libxml2's global state before measuring
+    for (i = 0; i < corpus.count && i < 100; ++i) {
+        parseDocument(corpus.docs + i, backend, &options);
+    }
+
+    parses = corpus.count * config->iterations;
+    latencies = malloc(parses * sizeof(double));
+    allocationCount = 0;
+
+    total = nowSeconds();
+    for (iteration = 0; iteration < config->iterations; ++iteration) {
+        for (i = 0; i < corpus.count; ++i) {
+            start = nowSeconds();
+            parseDocument(corpus.docs + i, backend, &options);
+            latencies[iteration * corpus.count + i] = nowSeconds() - start;
+        }
+    }
+    total = nowSeconds() - total;
+
+    qsort(latencies, parses, sizeof(double), compareDoubles);
+    getrusage(RUSAGE_SELF, &usage);
+
+    if (config->json) {
+        printf("{\"backend\": \"%s\", \"category\": \"%s\", \"docs\": %zu, \"bytes\": %zu, "
+                "\"docsPerSec\": %.1f, \"mbPerSec\": %.2f, \"p50Us\": %.2f, \"p99Us\": %.2f, "
+                "\"allocsPerDoc\": %.2f, \"peakRssKb\": %ld}",
+                backendNames[backend], categoryNames[category], corpus.count, corpus.bytes,
+                parses / total, corpus.bytes * (double)config->iterations / total / 1e6,
+                percentile(latencies, parses, 0.5) * 1e6, percentile(latencies, parses, 0.99) * 1e6,
+                (double)allocationCount / parses, usage.ru_maxrss);
+    } else {
+        printf("%-8s %-9s %8zu %10zu %12.1f %9.2f %10.2f %10.2f %9.2f %10ld\n",
+                backendNames[backend], categoryNames[category], corpus.count, corpus.bytes,
+                parses / total, corpus.bytes * (double)config->iterations / total / 1e6,
+                percentile(latencies, parses, 0.5) * 1e6, percentile(latencies, parses, 0.99) * 1e6,
+                (double)allocationCount / parses, usage.ru_maxrss);
+    }
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: bench [--json] [--backend libxml2|stream|native] [--category name]\n"
+            "             [--docs n] [--iterations n] [--seed n] [file...]\n"
+            "Categories: snippets articles lists links entities tagsoup, plus files\n"
+            "when files are given.\n");
+    exit(1);
+}
+
+static int findName(const char* const* names, int count, const char* name) {
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    fprintf(stderr, "bench: unknown name %s\n", name);
+    usage();
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = { NULL, NULL, 0, 3, 1, 0, NULL, 0 };
+    int backend, category, i;
+    int first = 1;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0) {
+            config.json = 1;
+        } else if (i + 1 < argc && strcmp(argv[i], "--backend") == 0) {
+            config.backend = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--category") == 0) {
+            config.category = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--docs") == 0) {
+            config.docs = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--iterations") == 0) {
+            config.iterations = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+            config.seed = strtoul(argv[++i], NULL, 10);
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else {
+            break;
+        }
+    }
+    config.files = argv + i;
+    config.fileCount = argc - i;
+    if (config.iterations == 0) {
+        usage();
+    }
+    if (config.backend) {
+        findName(backendNames, BENCH_BACKEND_COUNT, config.backend);
+    }
+    if (config.category) {
+        findName(categoryNames, BENCH_CATEGORY_COUNT, config.category);
+    }
+
+    // libxml2's allocations are counted too, this has to happen before any
+    // other libxml2 call
+    xmlMemSetup(free, countMalloc, countRealloc, countStrdup);
+    xmlInitParser();
+
+    if (config.json) {
+        printf("{\"iterations\": %u, \"seed\": %u, \"results\": [\n", config.iterations, config.seed);
+    } else {
+        printf("%-8s %-9s %8s %10s %12s %9s %10s %10s %9s %10s\n", "backend", "category", "docs",
+                "bytes", "docs/s", "MB/s", "p50 us", "p99 us", "allocs", "rss KiB");
+    }
+    fflush(stdout);
+
+    for (category = 0; category < BENCH_CATEGORY_COUNT; ++category) {
+        if (config.category && strcmp(config.category, categoryNames[category]) != 0) {
+            continue;
+        }
+        if (category == BENCH_CATEGORY_FILES ? config.fileCount == 0 : config.fileCount > 0 && !config.category) {
+            // Given files replace the generated corpus unless a category
+            // was asked for explicitly
+            continue;
+        }
+
+        for (backend = 0; backend < BENCH_BACKEND_COUNT; ++backend) {
+            pid_t child;
+            int status;
+
+            if (config.backend && strcmp(config.backend, backendNames[backend]) != 0) {
+                continue;
+            }
+
+            if (config.json) {
+                printf(first ? "  " : ",\n  ");
+                fflush(stdout);
+            }
+            first = 0;
+
+            child = fork();
+            if (child < 0) {
+                perror("bench: fork");
+                return 1;
+            }
+            if (child == 0) {
+                runBenchmark(backend, category, &config);
+                _exit(0);
+            }
+            if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "bench: %s/%s failed\n", backendNames[backend], categoryNames[category]);
+                return 1;
+            }
+        }
+    }
+
+    if (config.json) {
+        printf("\n]}\n");
+    }
+    return 0;
+}
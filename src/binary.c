@@ -0,0 +1,332 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "allocator.h"
+
+#include <string.h>
+
+// Layout of an encoding, all integers little endian:
+//
+//     magic        4 bytes, "MMUB"
+//     version      u32
+//     textSize     u64
+//     stringsSize  u64
+//     eventsSize   u64
+//     text         the runs of text one after another, each NUL terminated
+//     strings      the hrefs of the links in order, each NUL terminated
+//     events       a stream of unsigned LEB128 varints
+//
+// Each event starts with a varint holding its type in the low bits:
+//
+//     text             (len << 3 | 0), (textStyle | headingLevel << 8)
+//     start link       (len << 3 | 1)
+//     end link         2
+//     start list item  3, depth, index
+//     end list item    4
+//
+// Text and hrefs are not addressed: every text event takes the next run
+// of len bytes (plus its terminator) and every link the next href, so a
+// span costs two or three bytes of events.
+
+enum {
+    MMUBinaryHeaderSize = 32,
+    MMUBinaryEventTypeBits = 3,
+    MMUBinaryInitialSize = 256
+};
+
+enum MMUBinaryEventType {
+    MMU_BINARY_EVENT_TEXT = 0
+  , MMU_BINARY_EVENT_START_LINK
+  , MMU_BINARY_EVENT_END_LINK
+  , MMU_BINARY_EVENT_START_LIST_ITEM
+  , MMU_BINARY_EVENT_END_LIST_ITEM
+};
+
+static void MMUBinaryReserve(MMUBinaryWriter* writer, unsigned char** data, size_t* capacity,
+        size_t needed) {
+    size_t newCapacity;
+
+    if (needed <= *capacity) {
+        return;
+    }
+
+    newCapacity = *capacity ? *capacity : MMUBinaryInitialSize;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    *data = MMUReallocate(writer->allocator, *data, newCapacity);
+    *capacity = newCapacity;
+}
+
+static void MMUBinaryAppend(MMUBinaryWriter* writer, unsigned char** data, size_t* len,
+        size_t* capacity, const void* bytes, size_t size) {
+    MMUBinaryReserve(writer, data, capacity, *len + size);
+    memcpy(*data + *len, bytes, size);
+    *len += size;
+}
+
+static void MMUBinaryAppendVarint(MMUBinaryWriter* writer, unsigned long long value) {
+    unsigned char bytes[10];
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        bytes[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = (unsigned char)value;
+    MMUBinaryAppend(writer, &writer->events, &writer->eventsLen, &writer->eventsCapacity, bytes, len);
+}
+
+static void MMUBinaryAppendText(const char* text, size_t len,
+        const MMUContext* textContext, void* callbackContext) {
+    MMUBinaryWriter* writer = (MMUBinaryWriter*)callbackContext;
+
+    MMUBinaryReserve(writer, &writer->text, &writer->textCapacity, writer->textLen + len + 1);
+    memcpy(writer->text + writer->textLen, text, len);
+    writer->text[writer->textLen + len] = '\0';
+    writer->textLen += len + 1;
+
+    MMUBinaryAppendVarint(writer, (unsigned long long)len << MMUBinaryEventTypeBits | MMU_BINARY_EVENT_TEXT);
+    MMUBinaryAppendVarint(writer, textContext->textStyle
+            | (unsigned long long)(unsigned char)textContext->headingLevel << 8);
+}
+
+static void MMUBinaryStartLink(const char* href, void* callbackContext) {
+    MMUBinaryWriter* writer = (MMUBinaryWriter*)callbackContext;
+    size_t len = strlen(href);
+
+    MMUBinaryAppend(writer, &writer->strings, &writer->stringsLen, &writer->stringsCapacity, href, len + 1);
+    MMUBinaryAppendVarint(writer, (unsigned long long)len << MMUBinaryEventTypeBits | MMU_BINARY_EVENT_START_LINK);
+}
+
+static void MMUBinaryEndLink(void* callbackContext) {
+    MMUBinaryAppendVarint((MMUBinaryWriter*)callbackContext, MMU_BINARY_EVENT_END_LINK);
+}
+
+static void MMUBinaryStartListItem(int depth, unsigned int index, void* callbackContext) {
+    MMUBinaryWriter* writer = (MMUBinaryWriter*)callbackContext;
+
+    MMUBinaryAppendVarint(writer, MMU_BINARY_EVENT_START_LIST_ITEM);
+    MMUBinaryAppendVarint(writer, (unsigned long long)depth);
+    MMUBinaryAppendVarint(writer, index);
+}
+
+static void MMUBinaryEndListItem(void* callbackContext) {
+    MMUBinaryAppendVarint((MMUBinaryWriter*)callbackContext, MMU_BINARY_EVENT_END_LIST_ITEM);
+}
+
+static void MMUBinaryWriteU32(unsigned char* out, unsigned long value) {
+    int i;
+    for (i = 0; i < 4; ++i) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void MMUBinaryWriteU64(unsigned char* out, unsigned long long value) {
+    int i;
+    for (i = 0; i < 8; ++i) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void MMUBinaryFinish(void* callbackContext) {
+    MMUBinaryWriter* writer = (MMUBinaryWriter*)callbackContext;
+    unsigned char* out;
+
+    writer->len = MMUBinaryHeaderSize + writer->textLen + writer->stringsLen + writer->eventsLen;
+    MMUBinaryReserve(writer, &writer->data, &writer->capacity, writer->len);
+
+    out = writer->data;
+    memcpy(out, "MMUB", 4);
+    MMUBinaryWriteU32(out + 4, MMU_BINARY_VERSION);
+    MMUBinaryWriteU64(out + 8, writer->textLen);
+    MMUBinaryWriteU64(out + 16, writer->stringsLen);
+    MMUBinaryWriteU64(out + 24, writer->eventsLen);
+    out += MMUBinaryHeaderSize;
+    // memcpy with a NULL source is undefined, even for no bytes
+    if (writer->textLen) {
+        memcpy(out, writer->text, writer->textLen);
+    }
+    out += writer->textLen;
+    if (writer->stringsLen) {
+        memcpy(out, writer->strings, writer->stringsLen);
+    }
+    out += writer->stringsLen;
+    if (writer->eventsLen) {
+        memcpy(out, writer->events, writer->eventsLen);
+    }
+}
+
+const MMUCallbacks mmuBinaryWriterCallbacks = {
+    MMUBinaryAppendText,
+    MMUBinaryStartLink,
+    MMUBinaryEndLink,
+    MMUBinaryStartListItem,
+    MMUBinaryEndListItem,
+    MMUBinaryFinish,
+    NULL
+};
+
+void mmuBinaryWriterInit(MMUBinaryWriter* writer) {
+    memset(writer, 0, sizeof(MMUBinaryWriter));
+}
+
+void mmuBinaryWriterDestroy(MMUBinaryWriter* writer) {
+    const MMUAllocator* allocator = writer->allocator;
+
+    MMUDeallocate(allocator, writer->data);
+    MMUDeallocate(allocator, writer->text);
+    MMUDeallocate(allocator, writer->strings);
+    MMUDeallocate(allocator, writer->events);
+    mmuBinaryWriterInit(writer);
+    writer->allocator = allocator;
+}
+
+void mmuBinaryWriterClear(MMUBinaryWriter* writer) {
+    writer->len = 0;
+    writer->textLen = 0;
+    writer->stringsLen = 0;
+    writer->eventsLen = 0;
+}
+
+MMUStatus mmuParseHtmlBinary(const char* html, const MMUOptions* options, MMUBinaryWriter* writer) {
+    mmuBinaryWriterClear(writer);
+    return mmuParseHtml(html, &mmuBinaryWriterCallbacks, options, writer);
+}
+
+static unsigned long long MMUBinaryReadU64(const unsigned char* in) {
+    unsigned long long value = 0;
+    int i;
+    for (i = 7; i >= 0; --i) {
+        value = value << 8 | in[i];
+    }
+    return value;
+}
+
+static int MMUBinaryReadVarint(const unsigned char** cursor, const unsigned char* end,
+        unsigned long long* value) {
+    const unsigned char* p = *cursor;
+    unsigned int shift = 0;
+
+    *value = 0;
+    while (p < end && shift < 64) {
+        unsigned char byte = *p++;
+        *value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *cursor = p;
+            return 1;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+// Takes the next NUL terminated run of len bytes from [*cursor, end)
+static const char* MMUBinaryTakeRun(const unsigned char** cursor, const unsigned char* end,
+        unsigned long long len) {
+    const unsigned char* run = *cursor;
+
+    if (len >= (unsigned long long)(end - run) || run[len] != '\0') {
+        return NULL;
+    }
+    *cursor = run + len + 1;
+    return (const char*)run;
+}
+
+int mmuBinaryReplay(const void* data, size_t len, const MMUCallbacks* callbacks,
+        void* callbackContext) {
+    const unsigned char* in = (const unsigned char*)data;
+    const unsigned char* text;
+    const unsigned char* textEnd;
+    const unsigned char* strings;
+    const unsigned char* stringsEnd;
+    const unsigned char* events;
+    const unsigned char* end;
+    unsigned long long textSize;
+    unsigned long long stringsSize;
+    unsigned long long eventsSize;
+
+    if (len < MMUBinaryHeaderSize || memcmp(in, "MMUB", 4) != 0
+            || in[4] != MMU_BINARY_VERSION || in[5] || in[6] || in[7]) {
+        return 0;
+    }
+    textSize = MMUBinaryReadU64(in + 8);
+    stringsSize = MMUBinaryReadU64(in + 16);
+    eventsSize = MMUBinaryReadU64(in + 24);
+    len -= MMUBinaryHeaderSize;
+    if (textSize > len || stringsSize > len - textSize || eventsSize != len - textSize - stringsSize) {
+        return 0;
+    }
+
+    text = in + MMUBinaryHeaderSize;
+    textEnd = strings = text + textSize;
+    stringsEnd = events = strings + stringsSize;
+    end = events + eventsSize;
+
+    while (events < end) {
+        unsigned long long event;
+        unsigned long long value;
+        unsigned long long index;
+        const char* run;
+
+        if (!MMUBinaryReadVarint(&events, end, &event)) {
+            return 0;
+        }
+        switch (event & ((1 << MMUBinaryEventTypeBits) - 1)) {
+            case MMU_BINARY_EVENT_TEXT: {
+                MMUContext context;
+                if (!MMUBinaryReadVarint(&events, end, &value)
+                        || !(run = MMUBinaryTakeRun(&text, textEnd, event >> MMUBinaryEventTypeBits))) {
+                    return 0;
+                }
+                context.textStyle = (unsigned char)value;
+                context.headingLevel = (char)(value >> 8);
+                callbacks->appendText(run, (size_t)(event >> MMUBinaryEventTypeBits), &context, callbackContext);
+                break;
+            }
+            case MMU_BINARY_EVENT_START_LINK:
+                if (!(run = MMUBinaryTakeRun(&strings, stringsEnd, event >> MMUBinaryEventTypeBits))) {
+                    return 0;
+                }
+                callbacks->startLink(run, callbackContext);
+                break;
+            case MMU_BINARY_EVENT_END_LINK:
+                callbacks->endLink(callbackContext);
+                break;
+            case MMU_BINARY_EVENT_START_LIST_ITEM:
+                if (!MMUBinaryReadVarint(&events, end, &value)
+                        || !MMUBinaryReadVarint(&events, end, &index)) {
+                    return 0;
+                }
+                callbacks->startListItem((int)value, (unsigned int)index, callbackContext);
+                break;
+            case MMU_BINARY_EVENT_END_LIST_ITEM:
+                callbacks->endListItem(callbackContext);
+                break;
+            default:
+                return 0;
+        }
+    }
+
+    callbacks->finish(callbackContext);
+    return 1;
+}
@@ -22,6 +22,10 @@
 
 #include "builder.h"
 
+#include "allocator.h"
+#include "simd.h"
+#include "stats.h"
+
 #include <assert.h>
 #include <stdlib.h>
 
@@ -30,13 +34,15 @@ static void MMUContextClone(MMUContext* out,
         const MMUContext* in);
 
 static void MMUContextStackInit(MMUContextStack* stack);
-static MMUContext* MMUContextStackPush(
-        MMUContextStack* stack);
+static MMUContext* MMUContextStackPush(MMUBuilder* builder);
 static void MMUContextStackPop(MMUContextStack* stack);
 
+static void MMUBuilderCopyText(MMUBuilder* builder, const char* text, size_t size);
+static void MMUBuilderTakeBorrowedText(MMUBuilder* builder);
 static void MMUBuilderStartBlock(MMUBuilder* builder);
 static size_t MMUBuilderCurrentOffset(MMUBuilder* builder);
-static void MMUBuilderFlush(MMUBuilder* builder);
+static void MMUBuilderFlushUtf16(MMUBuilder* builder, const char* text, size_t size,
+        const MMUContext* context);
 
 void MMUContextInit(MMUContext* context) {
     memset(context, 0, sizeof(MMUContext));
@@ -51,18 +57,19 @@ void MMUContextClone(MMUContext* out,
 
 void MMUContextStackInit(MMUContextStack* stack) {
     stack->level = 0;
-    MMUContextInit(stack->stack);
+    MMUContextInit(stack->heapStack ? stack->heapStack : stack->inlineStack);
 }
 
-MMUContext* MMUContextStackPush(MMUContextStack* stack) {
-    ++stack->level;
-
-    assert(stack->level < MMUContextStackSize);
+MMUContext* MMUContextStackPush(MMUBuilder* builder) {
+    MMUContextStack* stack = builder->contextStack;
+    MMUContext* contexts;
 
-    MMUContextClone(stack->stack + stack->level,
-            stack->stack + stack->level - 1);
+    MMUBuilderReserveStacks(builder, stack->level + 1, builder->listDepth);
+    contexts = MMUBuilderContexts(builder);
+    ++stack->level;
+    MMUContextClone(contexts + stack->level, contexts + stack->level - 1);
 
-    return stack->stack + stack->level;
+    return contexts + stack->level;
 }
 
 void MMUContextStackPop(MMUContextStack* stack) {
@@ -71,104 +78,577 @@ void MMUContextStackPop(MMUContextStack* stack) {
 }
 
 MMUContext* MMUContextStackTop(MMUContextStack* stack) {
-    return stack->stack + stack->level;
+    return (stack->heapStack ? stack->heapStack : stack->inlineStack) + stack->level;
 }
 
-int MMUContextStackCurrentEqualsPrev(MMUContextStack* stack) {
-    assert(stack->level);
-    return memcmp(stack->stack + stack->level,
-            stack->stack + stack->level - 1, sizeof(MMUContext)) == 0;
+MMUContext* MMUBuilderContexts(MMUBuilder* builder) {
+    MMUContextStack* stack = builder->contextStack;
+    return stack->heapStack ? stack->heapStack : stack->inlineStack;
+}
+
+MMUListState* MMUBuilderLists(MMUBuilder* builder) {
+    return builder->listHeapStack ? builder->listHeapStack : builder->listInlineStack;
+}
+
+// Makes room for count entries of size bytes in a stack which is inline
+// until it first outgrows it, then on the heap for good
+static void* MMUBuilderReserveStack(MMUBuilder* builder, void* inlineStack, size_t inlineCount,
+        void** heapStack, unsigned int* heapCapacity, size_t count, size_t size) {
+    unsigned int capacity;
+
+    if (!*heapStack && count <= inlineCount) {
+        return inlineStack;
+    }
+    if (*heapStack && count <= *heapCapacity) {
+        return *heapStack;
+    }
+
+    capacity = *heapCapacity ? *heapCapacity : (unsigned int)inlineCount;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    if (*heapStack) {
+        *heapStack = MMUReallocate(builder->options->allocator, *heapStack, capacity * size);
+    } else {
+        *heapStack = MMUAllocate(builder->options->allocator, capacity * size);
+        memcpy(*heapStack, inlineStack, inlineCount * size);
+    }
+    *heapCapacity = capacity;
+    return *heapStack;
+}
+
+static void MMUBuilderPushSpan(MMUBuilder* builder, MMUSpanKind kind) {
+    unsigned char* spans = MMUBuilderReserveStack(builder, builder->spanInlineStack,
+            MMUSpanStackInlineSize, (void**)&builder->spanHeapStack, &builder->spanHeapCapacity,
+            builder->spanDepth + 1, sizeof(unsigned char));
+    spans[builder->spanDepth++] = (unsigned char)kind;
+}
+
+static unsigned char* MMUBuilderSpans(MMUBuilder* builder) {
+    return builder->spanHeapStack ? builder->spanHeapStack : builder->spanInlineStack;
+}
+
+void MMUBuilderReserveStacks(MMUBuilder* builder, unsigned int contextLevel, int listDepth) {
+    MMUContextStack* stack = builder->contextStack;
+
+    MMUBuilderReserveStack(builder, stack->inlineStack, MMUContextStackInlineSize,
+            (void**)&stack->heapStack, &stack->heapCapacity, contextLevel + 1, sizeof(MMUContext));
+    MMUBuilderReserveStack(builder, builder->listInlineStack, MMUListStackInlineSize,
+            (void**)&builder->listHeapStack, &builder->listHeapCapacity, (size_t)listDepth,
+            sizeof(MMUListState));
+}
+
+static size_t MMUBuilderInitialBufferSize(const MMUBuilder* builder) {
+    return builder->options->bufferSize ? builder->options->bufferSize : MMUBuilderDefaultBufferSize;
 }
 
 void MMUBuilderInit(MMUBuilder* builder, const MMUCallbacks* callbacks,
         const MMUOptions* options, void* callbackContext) {
-    static const size_t INITIAL_BUFFER_SIZE = 4096;
-
-    MMUContextStackInit(builder->contextStack);
     builder->callbacks = callbacks;
     builder->options = options;
 
-    builder->buffer = malloc(INITIAL_BUFFER_SIZE);
-    builder->bufferLen = 0;
-    builder->bufferCapacity = INITIAL_BUFFER_SIZE;
+    // Buffers are allocated on first use, so that a parser which is kept
+    // around idle costs no more than the struct
+    builder->buffer = NULL;
+    builder->bufferCapacity = 0;
 
-    builder->inParagraph = 0;
+    builder->utf16Buffer = NULL;
+    builder->utf16BufferCapacity = 0;
+
+    builder->contextStack->heapStack = NULL;
+    builder->contextStack->heapCapacity = 0;
+    builder->listHeapStack = NULL;
+    builder->listHeapCapacity = 0;
+    builder->spanHeapStack = NULL;
+    builder->spanHeapCapacity = 0;
+    builder->pendingHref = NULL;
+    builder->pendingHrefCapacity = 0;
+
+    MMUBuilderReset(builder, callbackContext);
+}
+
+void MMUBuilderDestroy(MMUBuilder* builder) {
+    MMUDeallocate(builder->options->allocator, builder->buffer);
+    MMUDeallocate(builder->options->allocator, builder->utf16Buffer);
+    MMUDeallocate(builder->options->allocator, builder->contextStack->heapStack);
+    MMUDeallocate(builder->options->allocator, builder->listHeapStack);
+    MMUDeallocate(builder->options->allocator, builder->spanHeapStack);
+    MMUDeallocate(builder->options->allocator, builder->pendingHref);
+}
 
+void MMUBuilderReset(MMUBuilder* builder, void* callbackContext) {
+    MMUContextStackInit(builder->contextStack);
+
+    builder->bufferLen = 0;
+    builder->borrowedText = NULL;
+    builder->borrowedLen = 0;
+    builder->inParagraph = 0;
     builder->listDepth = 0;
 
     builder->flushedLen = 0;
     builder->callbackContext = callbackContext;
+
+    builder->status = MMU_STATUS_OK;
+    builder->nodeCount = 0;
+    builder->linkCount = 0;
+    builder->deadline = 0;
+    builder->spanDepth = 0;
+    builder->spanStartOffset = (size_t)-1;
+    builder->previewChars = 0;
+    builder->linkPending = 0;
+    builder->blankState = MMU_BLANK_STATE_DROP;
+    builder->preformattedDepth = 0;
+    if (builder->options->limits && builder->options->limits->timeoutMilliseconds) {
+        builder->deadline = MMUStatsNow()
+            + builder->options->limits->timeoutMilliseconds * 1000000ULL;
+    }
 }
 
-void MMUBuilderDestroy(MMUBuilder* builder) {
-    free(builder->buffer);
+void MMUBuilderStop(MMUBuilder* builder, MMUStatus status) {
+    // The first limit hit is the one reported
+    if (!builder->status) {
+        builder->status = status;
+    }
 }
 
-void MMUBuilderPushBold(MMUBuilder* builder) {
-    if (!(MMUContextStackTop(builder->contextStack)->textStyle & MMU_TEXT_STYLE_BOLD)) {
-        MMUBuilderFlush(builder);
+void MMUBuilderCountNode(MMUBuilder* builder) {
+    const MMULimits* limits = builder->options->limits;
+
+    if (!limits) {
+        return;
+    }
+    ++builder->nodeCount;
+    if (limits->maxNodes && builder->nodeCount > limits->maxNodes) {
+        MMUBuilderStop(builder, MMU_STATUS_TOO_MANY_NODES);
     }
+    // Reading the clock costs about as much as a small node
+    if (builder->deadline && (builder->nodeCount & 255) == 0
+            && MMUStatsNow() > builder->deadline) {
+        MMUBuilderStop(builder, MMU_STATUS_TIMED_OUT);
+    }
+}
+
+void MMUBuilderCheckDepth(MMUBuilder* builder, unsigned int depth) {
+    const MMULimits* limits = builder->options->limits;
 
-    MMUContextStackPush(builder->contextStack)->textStyle |= MMU_TEXT_STYLE_BOLD;
+    if (limits && limits->maxDepth && depth > limits->maxDepth) {
+        MMUBuilderStop(builder, MMU_STATUS_TOO_DEEP);
+    }
 }
 
-void MMUBuilderPushItalic(MMUBuilder* builder) {
-    if (!(MMUContextStackTop(builder->contextStack)->textStyle & MMU_TEXT_STYLE_ITALIC)) {
-        MMUBuilderFlush(builder);
+void MMUBuilderCheckInputSize(MMUBuilder* builder, size_t size) {
+    const MMULimits* limits = builder->options->limits;
+
+    if (limits && limits->maxInputBytes && size > limits->maxInputBytes) {
+        MMUBuilderStop(builder, MMU_STATUS_INPUT_TOO_LARGE);
     }
+}
 
-    MMUContextStackPush(builder->contextStack)->textStyle |= MMU_TEXT_STYLE_ITALIC;
+static int MMUIsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
 }
 
-void MMUBuilderPushUnderline(MMUBuilder* builder) {
-    if (!(MMUContextStackTop(builder->contextStack)->textStyle & MMU_TEXT_STYLE_UNDERLINED)) {
-        MMUBuilderFlush(builder);
+// Length of text once cut back to the end of a word, dropping a word which
+// continues past it
+static size_t MMUBuilderWordEnd(const char* text, size_t len, int midWord) {
+    if (midWord) {
+        while (len && !MMUIsSpace(text[len - 1])) {
+            --len;
+        }
     }
+    while (len && MMUIsSpace(text[len - 1])) {
+        --len;
+    }
+    return len;
+}
 
-    MMUContextStackPush(builder->contextStack)->textStyle |= MMU_TEXT_STYLE_UNDERLINED;
+// Returns how much of text still fits in the preview, completing it if
+// that isn't all of it. maxOutputBytes cuts text at byteLimit, so a preview
+// which would end past that is left for it to stop.
+static size_t MMUBuilderFitPreview(MMUBuilder* builder, const char* text, size_t size,
+        size_t byteLimit) {
+    size_t budget = builder->options->previewLength - builder->previewChars;
+    size_t fit = 0;
+    int midWord;
+
+    // Walk budget characters in, to the lead byte of the first one left out
+    for (; fit < size; ++fit) {
+        if ((text[fit] & 0xC0) != 0x80) {
+            if (budget == 0) {
+                break;
+            }
+            --budget;
+        }
+    }
+    builder->previewChars = builder->options->previewLength - budget;
+    if (fit == size || fit > byteLimit) {
+        return size;
+    }
+
+    MMUBuilderStop(builder, MMU_STATUS_PREVIEW_TRUNCATED);
+    if (!(builder->options->outputFlags & MMU_OUTPUT_PREVIEW_WORDS)) {
+        return fit;
+    }
+
+    midWord = !MMUIsSpace(text[fit]);
+    fit = MMUBuilderWordEnd(text, fit, midWord);
+    if (fit == 0) {
+        // Nothing of this text is kept, so the word may have started in the
+        // pending run. Whatever was already flushed stays as it is.
+        midWord = midWord && !MMUIsSpace(text[0]);
+        if (builder->borrowedLen) {
+            builder->borrowedLen = MMUBuilderWordEnd(builder->borrowedText,
+                    builder->borrowedLen, midWord);
+        } else {
+            builder->bufferLen = MMUBuilderWordEnd(builder->buffer, builder->bufferLen, midWord);
+        }
+    }
+    return fit;
 }
 
-void MMUBuilderPushHeading(MMUBuilder* builder, int level) {
-    if (MMUContextStackTop(builder->contextStack)->headingLevel != level) {
+// Returns how much of text may still be appended under previewLength and
+// maxOutputBytes, stopping the builder if that isn't all of it
+static size_t MMUBuilderFitOutput(MMUBuilder* builder, const char* text, size_t size) {
+    const MMULimits* limits = builder->options->limits;
+    size_t offset, fit = size;
+
+    if (limits && limits->maxOutputBytes) {
+        offset = MMUBuilderCurrentOffset(builder);
+        if (offset + size > limits->maxOutputBytes) {
+            fit = offset < limits->maxOutputBytes ? limits->maxOutputBytes - offset : 0;
+            // Don't split a character
+            while (fit && (text[fit] & 0xC0) == 0x80) {
+                --fit;
+            }
+        }
+    }
+    // Whichever limit cuts text first is the one reported, the preview on a
+    // tie, however the text happens to be split into calls
+    if (builder->options->previewLength) {
+        size_t previewFit = MMUBuilderFitPreview(builder, text, size, fit);
+        if (previewFit < fit) {
+            fit = previewFit;
+        }
+    }
+    if (fit < size) {
+        MMUBuilderStop(builder, MMU_STATUS_OUTPUT_TOO_LARGE);
+    }
+    return fit;
+}
+
+static int MMUBuilderIsPlain(const MMUBuilder* builder) {
+    return (builder->options->outputFlags & MMU_OUTPUT_PLAIN_TEXT) != 0;
+}
+
+// Makes the startLink call held back for a preview, once it's known that
+// the link has text or something else follows its start
+static void MMUBuilderStartPendingLink(MMUBuilder* builder) {
+    builder->linkPending = 0;
+    if (!MMUBuilderIsPlain(builder)) {
+        MMUBuilderFlush(builder);
+    }
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
+    builder->callbacks->startLink(builder->pendingHref, builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
+}
+
+// Called before text is added to the pending run. Style changes don't
+// flush by themselves, the run only ends once text arrives under a context
+// which differs from its own, so markup which opens and closes styles
+// without changing how the text looks doesn't split it.
+static void MMUBuilderBeginRun(MMUBuilder* builder) {
+    const MMUContext* context = MMUContextStackTop(builder->contextStack);
+
+    if (builder->linkPending) {
+        MMUBuilderStartPendingLink(builder);
+    }
+
+    if (builder->bufferLen || builder->borrowedLen) {
+        if (memcmp(&builder->runContext, context, sizeof(MMUContext)) == 0) {
+            return;
+        }
         MMUBuilderFlush(builder);
     }
+    builder->runContext = *context;
+}
+
+// Marks the end of a preview which was cut short. A link cut before any of
+// its text is left out, so the ellipsis follows the text in front of it.
+static void MMUBuilderAppendEllipsis(MMUBuilder* builder) {
+    const char* ellipsis = builder->options->previewEllipsis;
+
+    if (builder->status != MMU_STATUS_PREVIEW_TRUNCATED) {
+        return;
+    }
+    if (builder->linkPending) {
+        builder->linkPending = 0;
+        --builder->spanDepth;
+    }
+    if (ellipsis) {
+        MMUBuilderBeginRun(builder);
+        MMUBuilderTakeBorrowedText(builder);
+        MMUBuilderCopyText(builder, ellipsis, strlen(ellipsis));
+    }
+}
+
+void MMUBuilderPushStyle(MMUBuilder* builder, unsigned char textStyle) {
+    if (builder->status || MMUBuilderIsPlain(builder)) {
+        return;
+    }
+    MMUContextStackPush(builder)->textStyle |= textStyle;
+    MMU_STATS_MAX(builder->options, maxContextDepth, builder->contextStack->level);
+}
+
+void MMUBuilderPushBold(MMUBuilder* builder) {
+    MMUBuilderPushStyle(builder, MMU_TEXT_STYLE_BOLD);
+}
+
+void MMUBuilderPushItalic(MMUBuilder* builder) {
+    MMUBuilderPushStyle(builder, MMU_TEXT_STYLE_ITALIC);
+}
 
-    MMUContextStackPush(builder->contextStack)->headingLevel = level;
+void MMUBuilderPushUnderline(MMUBuilder* builder) {
+    MMUBuilderPushStyle(builder, MMU_TEXT_STYLE_UNDERLINED);
+}
+
+void MMUBuilderPushHeading(MMUBuilder* builder, int level) {
+    if (builder->status || MMUBuilderIsPlain(builder)) {
+        return;
+    }
+    MMUContextStackPush(builder)->headingLevel = level;
+    MMU_STATS_MAX(builder->options, maxContextDepth, builder->contextStack->level);
 }
 
 void MMUBuilderPop(MMUBuilder* builder) {
-    if (!MMUContextStackCurrentEqualsPrev(builder->contextStack)) {
-        MMUBuilderFlush(builder);
+    if (builder->status || MMUBuilderIsPlain(builder)) {
+        return;
     }
     MMUContextStackPop(builder->contextStack);
 }
 
-void MMUBuilderAppendText(MMUBuilder* builder, const char* text, size_t size) {
-    while ((builder->bufferCapacity - builder->bufferLen) < (size + 1)) {
-        builder->buffer = realloc(builder->buffer, builder->bufferCapacity * 2);
+static void MMUBuilderCopyText(MMUBuilder* builder, const char* text, size_t size) {
+    // Plain text has no reason to keep a run together, so a full buffer is
+    // handed on rather than grown
+    if ((builder->bufferCapacity - builder->bufferLen) < (size + 1)
+            && builder->bufferLen && MMUBuilderIsPlain(builder)) {
+        MMUBuilderFlush(builder);
+    }
+    if ((builder->bufferCapacity - builder->bufferLen) < (size + 1)) {
+        size_t capacity = builder->bufferCapacity ? builder->bufferCapacity
+            : MMUBuilderInitialBufferSize(builder);
+        while ((capacity - builder->bufferLen) < (size + 1)) {
+            capacity *= 2;
+        }
+        builder->buffer = MMUReallocate(builder->options->allocator, builder->buffer, capacity);
+        builder->bufferCapacity = capacity;
+        MMU_STATS_ADD(builder->options, bufferReallocations, 1);
     }
 
     memcpy(builder->buffer + builder->bufferLen, text, size);
     builder->bufferLen += size;
 }
 
+// Copies a pending borrowed run into the buffer, so that text which isn't
+// part of it can follow
+static void MMUBuilderTakeBorrowedText(MMUBuilder* builder) {
+    if (builder->borrowedLen) {
+        MMUBuilderCopyText(builder, builder->borrowedText, builder->borrowedLen);
+        builder->borrowedLen = 0;
+    }
+}
+
+// Copies text in as far as the limits allow
+static void MMUBuilderAppendRun(MMUBuilder* builder, const char* text, size_t size) {
+    size = MMUBuilderFitOutput(builder, text, size);
+    if (size) {
+        MMUBuilderBeginRun(builder);
+        MMUBuilderTakeBorrowedText(builder);
+        MMUBuilderCopyText(builder, text, size);
+    }
+    MMUBuilderAppendEllipsis(builder);
+}
+
+// Appends text which may be kept until the pending run is flushed, rather
+// than copied, when it carries straight on from it or starts it
+static void MMUBuilderBorrowRun(MMUBuilder* builder, const char* text, size_t size) {
+    size = MMUBuilderFitOutput(builder, text, size);
+    if (size == 0) {
+        MMUBuilderAppendEllipsis(builder);
+        return;
+    }
+    MMUBuilderBeginRun(builder);
+    if (builder->borrowedLen && text == builder->borrowedText + builder->borrowedLen) {
+        builder->borrowedLen += size;
+    } else if (builder->borrowedLen == 0 && builder->bufferLen == 0) {
+        builder->borrowedText = text;
+        builder->borrowedLen = size;
+    } else {
+        MMUBuilderTakeBorrowedText(builder);
+        MMUBuilderCopyText(builder, text, size);
+    }
+    MMUBuilderAppendEllipsis(builder);
+}
+
+static void MMUBuilderAppendSpan(MMUBuilder* builder, const char* text, size_t size, int borrowed) {
+    // The space before it may have been the last thing which fitted
+    if (builder->status) {
+        return;
+    }
+    if (borrowed) {
+        MMUBuilderBorrowRun(builder, text, size);
+    } else {
+        MMUBuilderAppendRun(builder, text, size);
+    }
+}
+
+// MMU_OUTPUT_COLLAPSE_WHITESPACE: appends the words of text, with a space
+// wherever a run of blanks separated two of them (possibly across calls).
+// Stretches which are already collapsed, typically whole lines of prose,
+// go in with one append each, so they can also be borrowed.
+static void MMUBuilderAppendCollapsed(MMUBuilder* builder, const char* text, size_t size,
+        int borrowed) {
+    const char* start = text;
+    const char* end = text + size;
+
+    // Kept as it is, its own blanks standing in for any around it
+    if (builder->preformattedDepth) {
+        if (size == 0) {
+            return;
+        }
+        if (builder->blankState == MMU_BLANK_STATE_PENDING && !MMUIsSpace(text[0])) {
+            MMUBuilderAppendRun(builder, " ", 1);
+        }
+        MMUBuilderAppendSpan(builder, text, size, borrowed);
+        builder->blankState = MMUIsSpace(end[-1]) ? MMU_BLANK_STATE_DROP : MMU_BLANK_STATE_TEXT;
+        return;
+    }
+
+    while (text < end && !builder->status) {
+        const char* words = MMUSkipWhitespace(text, end);
+        const char* span = words;
+
+        if (words > text && builder->blankState == MMU_BLANK_STATE_TEXT) {
+            builder->blankState = MMU_BLANK_STATE_PENDING;
+        }
+        if (words == end) {
+            break;
+        }
+        if (builder->blankState == MMU_BLANK_STATE_PENDING) {
+            // The space can come from the text itself unless the blanks
+            // before the word were something else or in an earlier call
+            if (words > start && words[-1] == ' ') {
+                --span;
+            } else {
+                MMUBuilderAppendRun(builder, " ", 1);
+            }
+        }
+        text = MMUFindCollapsible(words, end);
+        MMUBuilderAppendSpan(builder, span, text - span, borrowed);
+        builder->blankState = MMU_BLANK_STATE_TEXT;
+    }
+}
+
+void MMUBuilderAppendText(MMUBuilder* builder, const char* text, size_t size) {
+    if (builder->status) {
+        return;
+    }
+    if (builder->options->outputFlags & MMU_OUTPUT_COLLAPSE_WHITESPACE) {
+        MMUBuilderAppendCollapsed(builder, text, size, 0);
+    } else {
+        MMUBuilderAppendRun(builder, text, size);
+    }
+}
+
+// Separators are never collapsed, and blanks around them are dropped
+static void MMUBuilderAppendSeparator(MMUBuilder* builder, const char* separator) {
+    if (builder->status) {
+        return;
+    }
+    MMUBuilderAppendRun(builder, separator, strlen(separator));
+    builder->blankState = MMU_BLANK_STATE_DROP;
+}
+
+void MMUBuilderAppendBorrowedText(MMUBuilder* builder, const char* text, size_t size) {
+    if (!(builder->options->outputFlags & MMU_OUTPUT_BORROWED_TEXT)) {
+        MMUBuilderAppendText(builder, text, size);
+        return;
+    }
+
+    if (builder->status) {
+        return;
+    }
+    if (builder->options->outputFlags & MMU_OUTPUT_COLLAPSE_WHITESPACE) {
+        MMUBuilderAppendCollapsed(builder, text, size, 1);
+    } else {
+        MMUBuilderBorrowRun(builder, text, size);
+    }
+}
+
 void MMUBuilderAppendLineSeparator(MMUBuilder* builder) {
-    const char* lineSeparator = builder->options->lineSeparator;
-    MMUBuilderAppendText(builder, lineSeparator, strlen(lineSeparator));
+    MMUBuilderAppendSeparator(builder, builder->options->lineSeparator);
 }
 
 void MMUBuilderStartLink(MMUBuilder* builder, const char* href) {
-    MMUBuilderFlush(builder);
+    const MMULimits* limits = builder->options->limits;
+
+    if (builder->status) {
+        return;
+    }
+    if (limits && limits->maxLinks && ++builder->linkCount > limits->maxLinks) {
+        MMUBuilderStop(builder, MMU_STATUS_TOO_MANY_LINKS);
+        return;
+    }
+    if (builder->linkPending) {
+        MMUBuilderStartPendingLink(builder);
+    }
+    if (builder->options->previewLength) {
+        size_t size = strlen(href) + 1;
+        if (builder->pendingHrefCapacity < size) {
+            builder->pendingHref = MMUReallocate(builder->options->allocator,
+                    builder->pendingHref, size);
+            builder->pendingHrefCapacity = size;
+        }
+        memcpy(builder->pendingHref, href, size);
+        MMUBuilderPushSpan(builder, MMU_SPAN_LINK);
+        builder->spanStartOffset = MMUBuilderCurrentOffset(builder);
+        builder->linkPending = 1;
+        return;
+    }
+    if (!MMUBuilderIsPlain(builder)) {
+        MMUBuilderFlush(builder);
+    }
+    MMUBuilderPushSpan(builder, MMU_SPAN_LINK);
+    builder->spanStartOffset = MMUBuilderCurrentOffset(builder);
+
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
     builder->callbacks->startLink(href, builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
 }
 
 void MMUBuilderEndLink(MMUBuilder* builder) {
-    MMUBuilderFlush(builder);
+    if (builder->status) {
+        return;
+    }
+    if (builder->linkPending) {
+        MMUBuilderStartPendingLink(builder);
+    }
+    if (!MMUBuilderIsPlain(builder)) {
+        MMUBuilderFlush(builder);
+    }
+    // Links and list items nest, so this is the innermost one
+    if (builder->spanDepth) {
+        --builder->spanDepth;
+    }
 
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
     builder->callbacks->endLink(builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
 }
 
 void MMUBuilderStartParagraph(MMUBuilder* builder) {
+    if (builder->status) {
+        return;
+    }
     MMUBuilderStartBlock(builder);
 
     builder->inParagraph = 1;
@@ -181,57 +661,185 @@ void MMUBuilderEndParagraph(MMUBuilder* builder) {
     builder->inParagraph = 0;
 }
 
-void MMUBuilderStartList(MMUBuilder* builder, int ordered) {
+void MMUBuilderStartPreformatted(MMUBuilder* builder) {
+    if (builder->status) {
+        return;
+    }
+    ++builder->preformattedDepth;
+}
+
+void MMUBuilderEndPreformatted(MMUBuilder* builder) {
+    if (builder->status) {
+        return;
+    }
+    assert(builder->preformattedDepth);
+    --builder->preformattedDepth;
+}
+
+void MMUBuilderStartList(MMUBuilder* builder, int ordered, unsigned int start) {
+    if (builder->status) {
+        return;
+    }
     MMUBuilderStartBlock(builder);
+    MMUBuilderReserveStacks(builder, builder->contextStack->level, builder->listDepth + 1);
     ++builder->listDepth;
-    MMUListState* listState = builder->listStack + builder->listDepth - 1;
-    listState->index = ordered ? 1 : 0;
+    MMU_STATS_MAX(builder->options, maxListDepth, (unsigned int)builder->listDepth);
+    MMUListState* listState = MMUBuilderLists(builder) + builder->listDepth - 1;
+    listState->index = ordered ? start : 0;
+    listState->ordered = (char)ordered;
 }
 
 void MMUBuilderEndList(MMUBuilder* builder) {
+    if (builder->status) {
+        return;
+    }
     assert(builder->listDepth);
     --builder->listDepth;
 }
 
 void MMUBuilderStartListItem(MMUBuilder* builder) {
+    if (builder->status) {
+        return;
+    }
     assert(builder->listDepth);
-    MMUBuilderFlush(builder);
-    MMUListState* listState = builder->listStack + builder->listDepth - 1;
+    if (builder->linkPending) {
+        MMUBuilderStartPendingLink(builder);
+    }
+    if (!MMUBuilderIsPlain(builder)) {
+        MMUBuilderFlush(builder);
+    }
+    MMUBuilderPushSpan(builder, MMU_SPAN_LIST_ITEM);
+    builder->spanStartOffset = MMUBuilderCurrentOffset(builder);
+    MMUListState* listState = MMUBuilderLists(builder) + builder->listDepth - 1;
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
     builder->callbacks->startListItem(builder->listDepth, listState->index, builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
 }
 
 void MMUBuilderEndListItem(MMUBuilder* builder) {
+    if (builder->status) {
+        return;
+    }
     assert(builder->listDepth);
+    if (builder->linkPending) {
+        MMUBuilderStartPendingLink(builder);
+    }
+    if (!MMUBuilderIsPlain(builder)) {
+        MMUBuilderFlush(builder);
+    }
+    if (builder->spanDepth) {
+        --builder->spanDepth;
+    }
+    MMUListState* listState = MMUBuilderLists(builder) + builder->listDepth - 1;
+    if (listState->ordered) {
+        ++listState->index;
+    }
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
     builder->callbacks->endListItem(builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
 }
 
-void MMUBuilderFinish(MMUBuilder* builder) {
+MMUStatus MMUBuilderFinish(MMUBuilder* builder) {
+    if (builder->linkPending) {
+        MMUBuilderStartPendingLink(builder);
+    }
     MMUBuilderFlush(builder);
+
+    // Whatever the parse left open is closed, innermost first. A stopped
+    // parse leaves spans open, and so does input which ends inside them,
+    // for which libxml2's push parser sends no end events.
+    {
+        const unsigned char* spans = MMUBuilderSpans(builder);
+        MMU_STATS_TIMER_START(builder->options, closeStart);
+        while (builder->spanDepth) {
+            if (spans[--builder->spanDepth] == MMU_SPAN_LINK) {
+                builder->callbacks->endLink(builder->callbackContext);
+            } else {
+                builder->callbacks->endListItem(builder->callbackContext);
+            }
+        }
+        MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, closeStart);
+    }
+
+    MMU_STATS_ADD(builder->options, documents, 1);
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
     builder->callbacks->finish(builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
+    return builder->status;
 }
 
 void MMUBuilderStartBlock(MMUBuilder* builder) {
     if (builder->inParagraph) {
         MMUBuilderEndParagraph(builder);
     } else if (MMUBuilderCurrentOffset(builder) > 0) {
-        MMUBuilderAppendText(builder, builder->options->paragraphSeparator, strlen(builder->options->paragraphSeparator));
+        MMUBuilderAppendSeparator(builder, builder->options->paragraphSeparator);
     }
 }
 
 size_t MMUBuilderCurrentOffset(MMUBuilder* builder) {
-    return builder->flushedLen + builder->bufferLen;
+    return builder->flushedLen + builder->bufferLen + builder->borrowedLen;
+}
+
+void MMUBuilderFlushUtf16(MMUBuilder* builder, const char* text, size_t size,
+        const MMUContext* context) {
+    size_t len;
+
+    // UTF-16 never needs more code units than UTF-8 needs bytes
+    if (builder->utf16BufferCapacity < size + 1) {
+        size_t capacity = builder->utf16BufferCapacity > builder->bufferCapacity
+            ? builder->utf16BufferCapacity : builder->bufferCapacity;
+        if (capacity == 0) {
+            // Borrowed text may arrive before the buffer was ever needed
+            capacity = MMUBuilderInitialBufferSize(builder);
+        }
+        while (capacity < size + 1) {
+            capacity *= 2;
+        }
+        builder->utf16Buffer = MMUReallocate(builder->options->allocator, builder->utf16Buffer,
+                capacity * sizeof(unsigned short));
+        builder->utf16BufferCapacity = capacity;
+        MMU_STATS_ADD(builder->options, bufferReallocations, 1);
+    }
+
+    len = MMUUtf8ToUtf16(text, text + size, builder->utf16Buffer);
+    builder->utf16Buffer[len] = 0;
+
+    MMU_STATS_TIMER_START(builder->options, callbackStart);
+    builder->callbacks->appendTextUtf16(builder->utf16Buffer, len, context, builder->callbackContext);
+    MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
 }
 
 void MMUBuilderFlush(MMUBuilder* builder) {
-    if (builder->bufferLen == 0) {
+    const char* text = builder->buffer;
+    size_t len = builder->bufferLen;
+
+    if (builder->borrowedLen) {
+        // Borrowed runs are only started on an empty buffer
+        text = builder->borrowedText;
+        len = builder->borrowedLen;
+    } else if (len == 0) {
         return;
+    } else {
+        // We always keep at least one spare slot in the buffer
+        // NULL terminate the string
+        builder->buffer[len] = '\0';
     }
 
-    const MMUContext* context = MMUContextStackTop(builder->contextStack);
-    // We always keep at least one spare slot in the buffer
-    // NULL terminate the string
-    builder->buffer[builder->bufferLen] = '\0';
-    builder->callbacks->appendText(builder->buffer, builder->bufferLen, context, builder->callbackContext);
-    builder->flushedLen += builder->bufferLen;
+    const MMUContext* context = &builder->runContext;
+    MMU_STATS_ADD(builder->options, flushes, 1);
+    MMU_STATS_ADD(builder->options, bytesEmitted, len);
+    if ((builder->options->outputFlags & MMU_OUTPUT_UTF16_TEXT) && builder->callbacks->appendTextUtf16) {
+        MMUBuilderFlushUtf16(builder, text, len, context);
+    } else {
+        MMU_STATS_TIMER_START(builder->options, callbackStart);
+        builder->callbacks->appendText(text, len, context, builder->callbackContext);
+        MMU_STATS_TIMER_END(builder->options, callbackNanoseconds, callbackStart);
+    }
+    builder->flushedLen += len;
     builder->bufferLen = 0;
+    builder->borrowedLen = 0;
+}
+
+size_t mmuUtf16Length(const char* text, size_t len) {
+    return MMUUtf8ToUtf16Length(text, text + len);
 }
@@ -28,16 +28,48 @@
 #include <string.h>
 
 enum MMUDefaults {
-    MMUContextStackSize = 128
+    // Deepest element nesting the front-ends style, the default and maximum
+    // of MMUOptions.maxDepth. The builder itself has no limit.
+    MMUMaxElementDepth = 127,
+    // Nesting kept inside the builder, deeper stacks move to the heap. Most
+    // documents never get that far, so parsers stay small.
+    MMUContextStackInlineSize = 16,
+    MMUListStackInlineSize = 4,
+    MMUSpanStackInlineSize = 16,
+    // Text buffer size for MMUOptions.bufferSize 0
+    MMUBuilderDefaultBufferSize = 4096
 };
 
+// The contexts of the open styled elements, the bottom one being the plain
+// context of the document. Entries are MMUBuilderContexts.
 typedef struct MMUContextStack {
-    MMUContext stack[MMUContextStackSize];
+    // NULL until the stack outgrows inlineStack
+    MMUContext* heapStack;
+    unsigned int heapCapacity;
     unsigned int level;
+    MMUContext inlineStack[MMUContextStackInlineSize];
 } MMUContextStack;
 
+// Where MMU_OUTPUT_COLLAPSE_WHITESPACE is in a run of text
+typedef enum MMUBlankState {
+    // At the start of the document or after a separator, blanks are dropped
+    MMU_BLANK_STATE_DROP
+    // After text, a blank may follow
+  , MMU_BLANK_STATE_TEXT
+    // Blanks were seen after text, a space goes before the next text
+  , MMU_BLANK_STATE_PENDING
+} MMUBlankState;
+
+// Links and list items, which the callbacks see start and end
+typedef enum MMUSpanKind {
+    MMU_SPAN_LINK
+  , MMU_SPAN_LIST_ITEM
+} MMUSpanKind;
+
 typedef struct MMUListState {
-    unsigned char index;
+    // Number of the current item, 0 in unordered lists
+    unsigned int index;
+    char ordered;
 } MMUListState;
 
 typedef struct MMUBuilder {
@@ -48,20 +80,82 @@ typedef struct MMUBuilder {
     char* buffer;
     size_t bufferLen;
     size_t bufferCapacity;
+
+    // A run of text which is still pointing at the input. It is only ever
+    // pending while buffer is empty and is copied into it as soon as
+    // anything else is appended.
+    const char* borrowedText;
+    size_t borrowedLen;
+    // Context of the pending text, which may no longer be the top of the
+    // context stack
+    MMUContext runContext;
+
+    // Transcoded runs for MMU_OUTPUT_UTF16_TEXT, allocated on first use
+    unsigned short* utf16Buffer;
+    size_t utf16BufferCapacity;
     
     char inParagraph;
 
-    MMUListState listStack[MMUContextStackSize];
+    // Open lists, see MMUBuilderLists
+    MMUListState* listHeapStack;
+    unsigned int listHeapCapacity;
     int listDepth;
+    MMUListState listInlineStack[MMUListStackInlineSize];
 
     size_t flushedLen;
     void* callbackContext;
+
+    // Set once one of options->limits is exceeded or the preview is complete,
+    // after which everything but MMUBuilderFinish is ignored
+    MMUStatus status;
+    size_t nodeCount;
+    size_t linkCount;
+    // MMUStatsNow based, 0 without a timeout
+    unsigned long long deadline;
+    // MMUSpanKinds of the open links and list items, innermost last, which
+    // MMUBuilderFinish closes in that order when the parse left them open
+    unsigned char* spanHeapStack;
+    unsigned int spanHeapCapacity;
+    unsigned int spanDepth;
+    unsigned char spanInlineStack[MMUSpanStackInlineSize];
+    // Output offset of the last link or list item to start, (size_t)-1
+    // before the first, which tells whether one ends empty at a cut
+    size_t spanStartOffset;
+    // Characters produced so far, only counted for options->previewLength
+    size_t previewChars;
+    // With a preview, startLink waits for the link's first text, so that a
+    // link which the preview ends in front of can be left out. The href is
+    // copied, as the front-ends only keep it for the start call.
+    char* pendingHref;
+    size_t pendingHrefCapacity;
+    char linkPending;
+    MMUBlankState blankState;
+    // Open <pre> elements, whose blanks MMU_OUTPUT_COLLAPSE_WHITESPACE keeps
+    unsigned int preformattedDepth;
 } MMUBuilder;
 
 void MMUBuilderInit(MMUBuilder* builder, const MMUCallbacks* callbacks,
         const MMUOptions* options, void* callbackContext);
 void MMUBuilderDestroy(MMUBuilder* builder);
-
+// Prepares for another document, keeping the buffers
+void MMUBuilderReset(MMUBuilder* builder, void* callbackContext);
+
+// The context stack from the bottom up to contextStack->level and the list
+// stack up to listDepth. MMUBuilderReserveStacks makes room for setting
+// them directly, which moves them, so it goes first.
+MMUContext* MMUBuilderContexts(MMUBuilder* builder);
+MMUListState* MMUBuilderLists(MMUBuilder* builder);
+void MMUBuilderReserveStacks(MMUBuilder* builder, unsigned int contextLevel, int listDepth);
+
+// Enforce options->limits. The front-ends count every element and text node
+// and check the depth of every element they open, and stop feeding the
+// builder once builder->status is set.
+void MMUBuilderStop(MMUBuilder* builder, MMUStatus status);
+void MMUBuilderCountNode(MMUBuilder* builder);
+void MMUBuilderCheckDepth(MMUBuilder* builder, unsigned int depth);
+void MMUBuilderCheckInputSize(MMUBuilder* builder, size_t size);
+
+void MMUBuilderPushStyle(MMUBuilder* builder, unsigned char textStyle);
 void MMUBuilderPushBold(MMUBuilder* builder);
 void MMUBuilderPushItalic(MMUBuilder* builder);
 void MMUBuilderPushUnderline(MMUBuilder* builder);
@@ -70,6 +164,10 @@ void MMUBuilderPushHeading(MMUBuilder* builder, int level);
 void MMUBuilderPop(MMUBuilder* builder);
 
 void MMUBuilderAppendText(MMUBuilder* builder, const char* text, size_t size);
+// As MMUBuilderAppendText, but with MMU_OUTPUT_BORROWED_TEXT the text is
+// handed to appendText in place when possible. It must stay valid until the
+// builder next flushes, which at the latest is MMUBuilderFinish.
+void MMUBuilderAppendBorrowedText(MMUBuilder* builder, const char* text, size_t size);
 void MMUBuilderAppendLineSeparator(MMUBuilder* builder);
 
 void MMUBuilderStartLink(MMUBuilder* builder, const char* href);
@@ -78,12 +176,21 @@ void MMUBuilderEndLink(MMUBuilder* builder);
 void MMUBuilderStartParagraph(MMUBuilder* builder);
 void MMUBuilderEndParagraph(MMUBuilder* builder);
 
-void MMUBuilderStartList(MMUBuilder* builder, int ordered);
+void MMUBuilderStartPreformatted(MMUBuilder* builder);
+void MMUBuilderEndPreformatted(MMUBuilder* builder);
+
+// Items of an ordered list are numbered from start
+void MMUBuilderStartList(MMUBuilder* builder, int ordered, unsigned int start);
 void MMUBuilderEndList(MMUBuilder* builder);
 
 void MMUBuilderStartListItem(MMUBuilder* builder);
 void MMUBuilderEndListItem(MMUBuilder* builder);
 
-void MMUBuilderFinish(MMUBuilder* builder);
+// Hands any pending text to appendText. Runs never continue across a
+// flush, so the output after it only depends on the builder's state.
+void MMUBuilderFlush(MMUBuilder* builder);
+
+// Returns builder->status
+MMUStatus MMUBuilderFinish(MMUBuilder* builder);
 
 #endif
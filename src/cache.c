@@ -0,0 +1,584 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "allocator.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// Each shard is an independently locked hash table with its own share of
+// the capacity. Entries hold the key (the options which affect the output,
+// then the input) followed by the recorded callbacks, in one allocation.
+// Eviction uses the CLOCK approximation of LRU: hits only set a flag, and
+// the hand clears flags until it finds an entry which wasn't used since it
+// last passed.
+
+enum {
+    MMUCacheDefaultShardCount = 16,
+    MMUCacheCacheLineSize = 64,
+    // Options keys which fit are built on the stack
+    MMUCacheOptionsKeySize = 256
+};
+
+enum MMUCacheRecordType {
+    MMU_CACHE_RECORD_TEXT = 0
+  , MMU_CACHE_RECORD_TEXT_UTF16
+  , MMU_CACHE_RECORD_START_LINK
+  , MMU_CACHE_RECORD_END_LINK
+  , MMU_CACHE_RECORD_START_LIST_ITEM
+  , MMU_CACHE_RECORD_END_LIST_ITEM
+};
+
+// Followed by len bytes of payload, padded to the record alignment: NUL
+// terminated text, UTF-16 text or href (the terminator included in len), or
+// the depth and index of a list item
+typedef struct MMUCacheRecord {
+    unsigned char type;
+    MMUContext context;
+    size_t len;
+} MMUCacheRecord;
+
+typedef struct MMUCacheListItem {
+    int depth;
+    unsigned int index;
+} MMUCacheListItem;
+
+typedef struct MMUCacheEntry {
+    struct MMUCacheEntry* next;
+    unsigned long long hash;
+    // One for the cache and one for each replay in progress, so that an
+    // entry can be evicted while another thread is still reading it
+    atomic_uint refs;
+    char referenced;
+    size_t optionsKeyLen;
+    size_t inputLen;
+    size_t recordsLen;
+    // Of the whole allocation, counted against the capacity
+    size_t size;
+    // MMU_STATUS_OK, or MMU_STATUS_PREVIEW_TRUNCATED for a cut short preview
+    MMUStatus status;
+} MMUCacheEntry;
+
+typedef struct MMUCacheShard {
+    pthread_mutex_t mutex;
+    MMUCacheEntry** buckets;
+    size_t bucketCount;
+    // Entries in the order the clock hand visits them
+    MMUCacheEntry** ring;
+    size_t ringCount;
+    size_t ringCapacity;
+    size_t hand;
+    size_t bytes;
+    size_t capacity;
+    MMUCacheStats stats;
+    char padding[MMUCacheCacheLineSize];
+} MMUCacheShard;
+
+struct MMUCache {
+    const MMUAllocator* allocator;
+    MMUCacheShard* shards;
+    unsigned int shardCount;
+};
+
+// Records the callbacks of a parse into what will become the entry, while
+// passing them on
+typedef struct MMUCacheRecorder {
+    const MMUCallbacks* callbacks;
+    void* callbackContext;
+    const MMUAllocator* allocator;
+    char* data;
+    size_t len;
+    size_t capacity;
+} MMUCacheRecorder;
+
+static size_t alignRecord(size_t len) {
+    return (len + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+static unsigned long long mix(unsigned long long h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+// A word at a time multiply-xor hash, which only has to be fast and spread
+// well since keys are compared in full
+static unsigned long long hashBytes(const char* p, size_t len, unsigned long long seed) {
+    unsigned long long h = seed ^ (len * 0x9E3779B97F4A7C15ULL);
+    unsigned long long word;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&word, p, 8);
+        h = (h ^ mix(word)) * 0x9E3779B97F4A7C15ULL;
+    }
+    word = 0;
+    memcpy(&word, p, len);
+    return mix(h ^ word);
+}
+
+// Everything in the options and callbacks which changes the callbacks made
+static size_t writeOptionsKey(char* out, size_t capacity, const MMUOptions* options,
+        const MMUCallbacks* callbacks) {
+    unsigned int header[4];
+    size_t len = 0;
+    size_t i;
+
+#define MMU_CACHE_KEY_APPEND(bytes, size) \
+    do { \
+        if (len + (size) <= capacity) { \
+            memcpy(out + len, (bytes), (size)); \
+        } \
+        len += (size); \
+    } while (0)
+
+    header[0] = (unsigned int)options->htmlBackend;
+    header[1] = options->maxDepth;
+    header[2] = options->outputFlags;
+    header[3] = callbacks->appendTextUtf16 != NULL;
+    MMU_CACHE_KEY_APPEND(header, sizeof(header));
+    MMU_CACHE_KEY_APPEND(options->lineSeparator, strlen(options->lineSeparator) + 1);
+    MMU_CACHE_KEY_APPEND(options->paragraphSeparator, strlen(options->paragraphSeparator) + 1);
+    MMU_CACHE_KEY_APPEND(options->encoding ? options->encoding : "",
+            options->encoding ? strlen(options->encoding) + 1 : 1);
+    MMU_CACHE_KEY_APPEND(&options->previewLength, sizeof(options->previewLength));
+    MMU_CACHE_KEY_APPEND(options->previewEllipsis ? options->previewEllipsis : "",
+            options->previewEllipsis ? strlen(options->previewEllipsis) + 1 : 1);
+    for (i = 0; i < options->extraTagCount; ++i) {
+        const MMUTagStyle* tag = options->extraTags + i;
+        MMU_CACHE_KEY_APPEND(tag->tagName, strlen(tag->tagName) + 1);
+        MMU_CACHE_KEY_APPEND(&tag->textStyle, 1);
+    }
+
+#undef MMU_CACHE_KEY_APPEND
+    return len;
+}
+
+static char* entryData(MMUCacheEntry* entry) {
+    return (char*)(entry + 1);
+}
+
+static const char* entryRecords(MMUCacheEntry* entry) {
+    return entryData(entry) + alignRecord(entry->optionsKeyLen + entry->inputLen);
+}
+
+static void releaseEntry(MMUCache* cache, MMUCacheEntry* entry) {
+    if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+        MMUDeallocate(cache->allocator, entry);
+    }
+}
+
+MMUCache* mmuCacheCreate(size_t capacity, unsigned int shardCount, const MMUAllocator* allocator) {
+    MMUCache* cache = MMUAllocate(allocator, sizeof(MMUCache));
+    unsigned int i;
+
+    if (shardCount == 0) {
+        shardCount = MMUCacheDefaultShardCount;
+    }
+    cache->allocator = allocator;
+    cache->shardCount = shardCount;
+    cache->shards = MMUAllocate(allocator, shardCount * sizeof(MMUCacheShard));
+    for (i = 0; i < shardCount; ++i) {
+        MMUCacheShard* shard = cache->shards + i;
+        pthread_mutex_init(&shard->mutex, NULL);
+        shard->buckets = NULL;
+        shard->bucketCount = 0;
+        shard->ring = NULL;
+        shard->ringCount = 0;
+        shard->ringCapacity = 0;
+        shard->hand = 0;
+        shard->bytes = 0;
+        shard->capacity = capacity / shardCount;
+        memset(&shard->stats, 0, sizeof(shard->stats));
+    }
+    return cache;
+}
+
+static void clearShard(MMUCache* cache, MMUCacheShard* shard) {
+    size_t i;
+
+    for (i = 0; i < shard->ringCount; ++i) {
+        releaseEntry(cache, shard->ring[i]);
+    }
+    if (shard->buckets) {
+        memset(shard->buckets, 0, shard->bucketCount * sizeof(MMUCacheEntry*));
+    }
+    shard->ringCount = 0;
+    shard->hand = 0;
+    shard->bytes = 0;
+}
+
+void mmuCacheDestroy(MMUCache* cache) {
+    unsigned int i;
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        MMUCacheShard* shard = cache->shards + i;
+        clearShard(cache, shard);
+        MMUDeallocate(cache->allocator, shard->buckets);
+        MMUDeallocate(cache->allocator, shard->ring);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+    MMUDeallocate(cache->allocator, cache->shards);
+    MMUDeallocate(cache->allocator, cache);
+}
+
+void mmuCacheClear(MMUCache* cache) {
+    unsigned int i;
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        MMUCacheShard* shard = cache->shards + i;
+        pthread_mutex_lock(&shard->mutex);
+        clearShard(cache, shard);
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+void mmuCacheGetStats(MMUCache* cache, MMUCacheStats* stats) {
+    unsigned int i;
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < cache->shardCount; ++i) {
+        MMUCacheShard* shard = cache->shards + i;
+        pthread_mutex_lock(&shard->mutex);
+        stats->hits += shard->stats.hits;
+        stats->misses += shard->stats.misses;
+        stats->insertions += shard->stats.insertions;
+        stats->evictions += shard->stats.evictions;
+        stats->entries += shard->ringCount;
+        stats->bytes += shard->bytes;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+static MMUCacheEntry** findEntry(MMUCacheShard* shard, unsigned long long hash,
+        const char* optionsKey, size_t optionsKeyLen, const char* input, size_t inputLen) {
+    MMUCacheEntry** link;
+
+    if (shard->bucketCount == 0) {
+        return NULL;
+    }
+    for (link = shard->buckets + (hash & (shard->bucketCount - 1)); *link; link = &(*link)->next) {
+        MMUCacheEntry* entry = *link;
+        if (entry->hash == hash
+                && entry->optionsKeyLen == optionsKeyLen && entry->inputLen == inputLen
+                && memcmp(entryData(entry), optionsKey, optionsKeyLen) == 0
+                && memcmp(entryData(entry) + optionsKeyLen, input, inputLen) == 0) {
+            return link;
+        }
+    }
+    return link;
+}
+
+static void evictEntry(MMUCache* cache, MMUCacheShard* shard) {
+    for (;;) {
+        MMUCacheEntry* entry = shard->ring[shard->hand];
+        MMUCacheEntry** link;
+
+        if (entry->referenced) {
+            entry->referenced = 0;
+            shard->hand = (shard->hand + 1) % shard->ringCount;
+            continue;
+        }
+
+        for (link = shard->buckets + (entry->hash & (shard->bucketCount - 1)); *link != entry;
+                link = &(*link)->next) {
+        }
+        *link = entry->next;
+        // The last entry takes the free slot, so it is visited a little early
+        shard->ring[shard->hand] = shard->ring[--shard->ringCount];
+        if (shard->hand >= shard->ringCount) {
+            shard->hand = 0;
+        }
+        shard->bytes -= entry->size;
+        ++shard->stats.evictions;
+        releaseEntry(cache, entry);
+        return;
+    }
+}
+
+static void growBuckets(MMUCache* cache, MMUCacheShard* shard) {
+    size_t bucketCount = shard->bucketCount ? shard->bucketCount * 2 : 64;
+    MMUCacheEntry** buckets = MMUAllocate(cache->allocator, bucketCount * sizeof(MMUCacheEntry*));
+    size_t i;
+
+    memset(buckets, 0, bucketCount * sizeof(MMUCacheEntry*));
+    for (i = 0; i < shard->ringCount; ++i) {
+        MMUCacheEntry* entry = shard->ring[i];
+        MMUCacheEntry** bucket = buckets + (entry->hash & (bucketCount - 1));
+        entry->next = *bucket;
+        *bucket = entry;
+    }
+    MMUDeallocate(cache->allocator, shard->buckets);
+    shard->buckets = buckets;
+    shard->bucketCount = bucketCount;
+}
+
+// Takes over the recorder's reference to entry, whether it is kept or not
+static void insertEntry(MMUCache* cache, MMUCacheShard* shard, MMUCacheEntry* entry) {
+    MMUCacheEntry** link;
+
+    if (entry->size > shard->capacity) {
+        releaseEntry(cache, entry);
+        return;
+    }
+    link = findEntry(shard, entry->hash, entryData(entry), entry->optionsKeyLen,
+            entryData(entry) + entry->optionsKeyLen, entry->inputLen);
+    if (link && *link) {
+        // Another thread got there first
+        releaseEntry(cache, entry);
+        return;
+    }
+
+    while (shard->bytes + entry->size > shard->capacity) {
+        evictEntry(cache, shard);
+    }
+    if (shard->ringCount >= shard->bucketCount) {
+        growBuckets(cache, shard);
+    }
+    if (shard->ringCount == shard->ringCapacity) {
+        shard->ringCapacity = shard->ringCapacity ? shard->ringCapacity * 2 : 64;
+        shard->ring = MMUReallocate(cache->allocator, shard->ring,
+                shard->ringCapacity * sizeof(MMUCacheEntry*));
+    }
+
+    link = shard->buckets + (entry->hash & (shard->bucketCount - 1));
+    entry->next = *link;
+    *link = entry;
+    shard->ring[shard->ringCount++] = entry;
+    shard->bytes += entry->size;
+    ++shard->stats.insertions;
+}
+
+static void replayEntry(MMUCacheEntry* entry, const MMUCallbacks* callbacks, void* callbackContext) {
+    const char* p = entryRecords(entry);
+    const char* end = p + entry->recordsLen;
+
+    while (p < end) {
+        const MMUCacheRecord* record = (const MMUCacheRecord*)p;
+        const char* payload = p + sizeof(MMUCacheRecord);
+
+        switch (record->type) {
+            case MMU_CACHE_RECORD_TEXT:
+                callbacks->appendText(payload, record->len - 1, &record->context, callbackContext);
+                break;
+            case MMU_CACHE_RECORD_TEXT_UTF16:
+                callbacks->appendTextUtf16((const unsigned short*)payload,
+                        record->len / sizeof(unsigned short) - 1, &record->context, callbackContext);
+                break;
+            case MMU_CACHE_RECORD_START_LINK:
+                callbacks->startLink(payload, callbackContext);
+                break;
+            case MMU_CACHE_RECORD_END_LINK:
+                callbacks->endLink(callbackContext);
+                break;
+            case MMU_CACHE_RECORD_START_LIST_ITEM: {
+                const MMUCacheListItem* item = (const MMUCacheListItem*)payload;
+                callbacks->startListItem(item->depth, item->index, callbackContext);
+                break;
+            }
+            case MMU_CACHE_RECORD_END_LIST_ITEM:
+                callbacks->endListItem(callbackContext);
+                break;
+        }
+        p = payload + alignRecord(record->len);
+    }
+    callbacks->finish(callbackContext);
+}
+
+static void reserve(MMUCacheRecorder* recorder, size_t size) {
+    if (recorder->capacity - recorder->len < size) {
+        size_t capacity = recorder->capacity;
+        while (capacity - recorder->len < size) {
+            capacity *= 2;
+        }
+        recorder->data = MMUReallocate(recorder->allocator, recorder->data, capacity);
+        recorder->capacity = capacity;
+    }
+}
+
+// Appends a record with room for len bytes of payload, which is zeroed
+static char* addRecord(MMUCacheRecorder* recorder, int type, const MMUContext* context, size_t len) {
+    size_t size = sizeof(MMUCacheRecord) + alignRecord(len);
+    MMUCacheRecord* record;
+
+    reserve(recorder, size);
+    record = (MMUCacheRecord*)(recorder->data + recorder->len);
+    memset(record, 0, size);
+    record->type = (unsigned char)type;
+    if (context) {
+        record->context = *context;
+    }
+    record->len = len;
+    recorder->len += size;
+    return (char*)(record + 1);
+}
+
+static void recordText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    char* payload = addRecord(recorder, MMU_CACHE_RECORD_TEXT, context, len + 1);
+    memcpy(payload, text, len);
+    recorder->callbacks->appendText(text, len, context, recorder->callbackContext);
+}
+
+static void recordTextUtf16(const unsigned short* text, size_t len, const MMUContext* context,
+        void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    char* payload = addRecord(recorder, MMU_CACHE_RECORD_TEXT_UTF16, context,
+            (len + 1) * sizeof(unsigned short));
+    memcpy(payload, text, len * sizeof(unsigned short));
+    recorder->callbacks->appendTextUtf16(text, len, context, recorder->callbackContext);
+}
+
+static void recordStartLink(const char* href, void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    size_t len = strlen(href);
+    memcpy(addRecord(recorder, MMU_CACHE_RECORD_START_LINK, NULL, len + 1), href, len);
+    recorder->callbacks->startLink(href, recorder->callbackContext);
+}
+
+static void recordEndLink(void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    addRecord(recorder, MMU_CACHE_RECORD_END_LINK, NULL, 0);
+    recorder->callbacks->endLink(recorder->callbackContext);
+}
+
+static void recordStartListItem(int depth, unsigned int index, void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    MMUCacheListItem* item = (MMUCacheListItem*)addRecord(recorder, MMU_CACHE_RECORD_START_LIST_ITEM,
+            NULL, sizeof(MMUCacheListItem));
+    item->depth = depth;
+    item->index = index;
+    recorder->callbacks->startListItem(depth, index, recorder->callbackContext);
+}
+
+static void recordEndListItem(void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    addRecord(recorder, MMU_CACHE_RECORD_END_LIST_ITEM, NULL, 0);
+    recorder->callbacks->endListItem(recorder->callbackContext);
+}
+
+static void recordFinish(void* callbackContext) {
+    MMUCacheRecorder* recorder = (MMUCacheRecorder*)callbackContext;
+    recorder->callbacks->finish(recorder->callbackContext);
+}
+
+MMUStatus mmuParseHtmlCached(MMUCache* cache, const char* html, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    char optionsKeyBuffer[MMUCacheOptionsKeySize];
+    char* optionsKey = optionsKeyBuffer;
+    size_t optionsKeyLen;
+    size_t inputLen;
+    unsigned long long hash;
+    MMUCacheShard* shard;
+    MMUCacheEntry** link;
+    MMUCacheEntry* entry = NULL;
+    MMUCacheRecorder recorder;
+    MMUCallbacks recordingCallbacks;
+    MMUStatus status;
+
+    // Limits aren't part of the key: whether a stored result fits them
+    // can't be told without parsing, so such parses skip the cache
+    if (options->limits) {
+        return mmuParseHtml(html, callbacks, options, callbackContext);
+    }
+
+    optionsKeyLen = writeOptionsKey(optionsKey, sizeof(optionsKeyBuffer), options, callbacks);
+    inputLen = strlen(html);
+    if (optionsKeyLen > sizeof(optionsKeyBuffer)) {
+        optionsKey = MMUAllocate(cache->allocator, optionsKeyLen);
+        writeOptionsKey(optionsKey, optionsKeyLen, options, callbacks);
+    }
+    hash = hashBytes(html, inputLen, hashBytes(optionsKey, optionsKeyLen, 0));
+    shard = cache->shards + (hash >> 32) % cache->shardCount;
+
+    pthread_mutex_lock(&shard->mutex);
+    link = findEntry(shard, hash, optionsKey, optionsKeyLen, html, inputLen);
+    if (link && *link) {
+        entry = *link;
+        entry->referenced = 1;
+        atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+        ++shard->stats.hits;
+    } else {
+        ++shard->stats.misses;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+
+    if (entry) {
+        replayEntry(entry, callbacks, callbackContext);
+        status = entry->status;
+        releaseEntry(cache, entry);
+        if (optionsKey != optionsKeyBuffer) {
+            MMUDeallocate(cache->allocator, optionsKey);
+        }
+        return status;
+    }
+
+    // Build the entry's header and key, then record behind them
+    recorder.callbacks = callbacks;
+    recorder.callbackContext = callbackContext;
+    recorder.allocator = cache->allocator;
+    recorder.len = sizeof(MMUCacheEntry) + alignRecord(optionsKeyLen + inputLen);
+    recorder.capacity = recorder.len + 256;
+    recorder.data = MMUAllocate(cache->allocator, recorder.capacity);
+    memcpy(recorder.data + sizeof(MMUCacheEntry), optionsKey, optionsKeyLen);
+    memcpy(recorder.data + sizeof(MMUCacheEntry) + optionsKeyLen, html, inputLen);
+    if (optionsKey != optionsKeyBuffer) {
+        MMUDeallocate(cache->allocator, optionsKey);
+    }
+
+    recordingCallbacks.appendText = recordText;
+    recordingCallbacks.startLink = recordStartLink;
+    recordingCallbacks.endLink = recordEndLink;
+    recordingCallbacks.startListItem = recordStartListItem;
+    recordingCallbacks.endListItem = recordEndListItem;
+    recordingCallbacks.finish = recordFinish;
+    recordingCallbacks.appendTextUtf16 = callbacks->appendTextUtf16 ? recordTextUtf16 : NULL;
+    status = mmuParseHtml(html, &recordingCallbacks, options, &recorder);
+
+    // Previews are part of the key, so they can be kept
+    if (status != MMU_STATUS_OK && status != MMU_STATUS_PREVIEW_TRUNCATED) {
+        MMUDeallocate(cache->allocator, recorder.data);
+        return status;
+    }
+
+    // Only what is used counts against the capacity, so don't keep any more
+    entry = MMUReallocate(cache->allocator, recorder.data, recorder.len);
+    entry->next = NULL;
+    entry->hash = hash;
+    atomic_init(&entry->refs, 1);
+    entry->referenced = 0;
+    entry->optionsKeyLen = optionsKeyLen;
+    entry->inputLen = inputLen;
+    entry->size = recorder.len;
+    entry->recordsLen = recorder.len - sizeof(MMUCacheEntry) - alignRecord(optionsKeyLen + inputLen);
+    entry->status = status;
+
+    pthread_mutex_lock(&shard->mutex);
+    insertEntry(cache, shard, entry);
+    pthread_mutex_unlock(&shard->mutex);
+    return status;
+}
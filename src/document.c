@@ -0,0 +1,228 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "document.h"
+
+#include "allocator.h"
+#include "simd.h"
+
+#include <string.h>
+
+// Initial capacities when the size of the input isn't known
+enum {
+    MMUDocumentInitialText = 1024,
+    MMUDocumentInitialSpans = 32,
+    MMUDocumentInitialLinks = 8,
+    MMUDocumentInitialHrefs = 256
+};
+
+static void MMUDocumentReserve(MMUDocument* document, void** data, size_t* capacity,
+        size_t needed, size_t elementSize, size_t initialCapacity) {
+    size_t newCapacity;
+
+    if (needed <= *capacity) {
+        return;
+    }
+
+    newCapacity = *capacity ? *capacity : initialCapacity;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    *data = MMUReallocate(document->allocator, *data, newCapacity * elementSize);
+    *capacity = newCapacity;
+}
+
+// Records a run which has just been appended to the text
+static void MMUDocumentAddSpan(MMUDocument* document, size_t len, size_t utf16Len,
+        const MMUContext* textContext) {
+    MMUSpan* last = document->spanCount ? document->spans + document->spanCount - 1 : NULL;
+
+    // The builder flushes whenever anything might have changed, so runs
+    // with the same attributes often arrive back to back
+    if (last && last->linkIndex == document->openLink
+            && memcmp(&last->context, textContext, sizeof(MMUContext)) == 0) {
+        last->length += len;
+        last->utf16Length += utf16Len;
+    } else {
+        MMUSpan* span;
+        MMUDocumentReserve(document, (void**)&document->spans, &document->spanCapacity,
+                document->spanCount + 1, sizeof(MMUSpan), MMUDocumentInitialSpans);
+        span = document->spans + document->spanCount++;
+        span->start = document->textLen;
+        span->length = len;
+        span->utf16Start = document->utf16Len;
+        span->utf16Length = utf16Len;
+        span->context = *textContext;
+        span->linkIndex = document->openLink;
+    }
+
+    document->textLen += len;
+    document->utf16Len += utf16Len;
+}
+
+static void MMUDocumentAppendText(const char* text, size_t len,
+        const MMUContext* textContext, void* callbackContext) {
+    MMUDocument* document = (MMUDocument*)callbackContext;
+    size_t utf16Len = 0;
+
+    // Keep room for the terminator written by finish
+    MMUDocumentReserve(document, (void**)&document->text, &document->textCapacity,
+            document->textLen + len + 1, 1, MMUDocumentInitialText);
+    memcpy(document->text + document->textLen, text, len);
+
+    if (document->outputFlags & (MMU_OUTPUT_UTF16_OFFSETS | MMU_OUTPUT_UTF16_TEXT)) {
+        utf16Len = MMUUtf8ToUtf16Length(text, text + len);
+    }
+    MMUDocumentAddSpan(document, len, utf16Len, textContext);
+}
+
+static void MMUDocumentAppendTextUtf16(const unsigned short* text, size_t len,
+        const MMUContext* textContext, void* callbackContext) {
+    MMUDocument* document = (MMUDocument*)callbackContext;
+
+    MMUDocumentReserve(document, (void**)&document->utf16Text, &document->utf16TextCapacity,
+            document->utf16Len + len + 1, sizeof(unsigned short), MMUDocumentInitialText);
+    memcpy(document->utf16Text + document->utf16Len, text, len * sizeof(unsigned short));
+
+    MMUDocumentAddSpan(document, 0, len, textContext);
+}
+
+static void MMUDocumentStartLink(const char* href, void* callbackContext) {
+    MMUDocument* document = (MMUDocument*)callbackContext;
+    size_t hrefLen = strlen(href);
+    MMULink* link;
+
+    MMUDocumentReserve(document, (void**)&document->links, &document->linkCapacity,
+            document->linkCount + 1, sizeof(MMULink), MMUDocumentInitialLinks);
+    MMUDocumentReserve(document, (void**)&document->hrefs, &document->hrefsCapacity,
+            document->hrefsLen + hrefLen + 1, 1, MMUDocumentInitialHrefs);
+
+    link = document->links + document->linkCount;
+    link->hrefOffset = document->hrefsLen;
+    link->start = document->textLen;
+    link->length = 0;
+    link->utf16Start = document->utf16Len;
+    link->utf16Length = 0;
+
+    memcpy(document->hrefs + document->hrefsLen, href, hrefLen + 1);
+    document->hrefsLen += hrefLen + 1;
+
+    document->openLink = (int)document->linkCount++;
+}
+
+static void MMUDocumentEndLink(void* callbackContext) {
+    MMUDocument* document = (MMUDocument*)callbackContext;
+
+    if (document->openLink >= 0) {
+        MMULink* link = document->links + document->openLink;
+        link->length = document->textLen - link->start;
+        link->utf16Length = document->utf16Len - link->utf16Start;
+        document->openLink = -1;
+    }
+}
+
+static void MMUDocumentStartListItem(int depth, unsigned int index, void* callbackContext) {
+}
+
+static void MMUDocumentEndListItem(void* callbackContext) {
+}
+
+static void MMUDocumentFinish(void* callbackContext) {
+    MMUDocument* document = (MMUDocument*)callbackContext;
+
+    if (document->outputFlags & MMU_OUTPUT_UTF16_TEXT) {
+        MMUDocumentReserve(document, (void**)&document->utf16Text, &document->utf16TextCapacity,
+                document->utf16Len + 1, sizeof(unsigned short), MMUDocumentInitialText);
+        document->utf16Text[document->utf16Len] = 0;
+    } else {
+        MMUDocumentReserve(document, (void**)&document->text, &document->textCapacity,
+                document->textLen + 1, 1, MMUDocumentInitialText);
+        document->text[document->textLen] = '\0';
+    }
+}
+
+const MMUCallbacks mmuDocumentCallbacks = {
+    MMUDocumentAppendText,
+    MMUDocumentStartLink,
+    MMUDocumentEndLink,
+    MMUDocumentStartListItem,
+    MMUDocumentEndListItem,
+    MMUDocumentFinish,
+    MMUDocumentAppendTextUtf16
+};
+
+void mmuDocumentInit(MMUDocument* document) {
+    memset(document, 0, sizeof(MMUDocument));
+    document->openLink = -1;
+}
+
+void mmuDocumentDestroy(MMUDocument* document) {
+    const MMUAllocator* allocator = document->allocator;
+
+    MMUDeallocate(allocator, document->text);
+    MMUDeallocate(allocator, document->utf16Text);
+    MMUDeallocate(allocator, document->spans);
+    MMUDeallocate(allocator, document->links);
+    MMUDeallocate(allocator, document->hrefs);
+    mmuDocumentInit(document);
+    document->allocator = allocator;
+}
+
+void mmuDocumentClear(MMUDocument* document) {
+    document->textLen = 0;
+    document->utf16Len = 0;
+    document->spanCount = 0;
+    document->linkCount = 0;
+    document->hrefsLen = 0;
+    document->openLink = -1;
+}
+
+const char* mmuDocumentGetHref(const MMUDocument* document, size_t linkIndex) {
+    return document->hrefs + document->links[linkIndex].hrefOffset;
+}
+
+void MMUDocumentPrepare(MMUDocument* document, const MMUOptions* options, size_t len) {
+    mmuDocumentClear(document);
+    document->outputFlags = options->outputFlags;
+
+    // Markup and entities only ever shrink, so the text almost always fits
+    // in the size of the input and is allocated once. UTF-16 never needs
+    // more code units than there are bytes.
+    if (document->outputFlags & MMU_OUTPUT_UTF16_TEXT) {
+        MMUDocumentReserve(document, (void**)&document->utf16Text, &document->utf16TextCapacity,
+                len + 1, sizeof(unsigned short), MMUDocumentInitialText);
+    } else {
+        MMUDocumentReserve(document, (void**)&document->text, &document->textCapacity,
+                len + 1, 1, MMUDocumentInitialText);
+    }
+}
+
+MMUStatus mmuParseHtmlDocument(const char* html, const MMUOptions* options,
+        MMUDocument* document) {
+    return mmuParseHtmlDocumentN(html, strlen(html), options, document);
+}
+
+MMUStatus mmuParseHtmlDocumentN(const char* html, size_t len, const MMUOptions* options,
+        MMUDocument* document) {
+    MMUDocumentPrepare(document, options, len);
+    return mmuParseHtmlN(html, len, &mmuDocumentCallbacks, options, document);
+}
@@ -0,0 +1,128 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "markmeup.h"
+
+#include "allocator.h"
+
+#include <string.h>
+
+enum {
+    MMUTextInitialText = 1024,
+    MMUTextInitialHrefs = 256
+};
+
+static void MMUTextReserve(MMUText* text, char** data, size_t* capacity, size_t needed,
+        size_t initialCapacity) {
+    size_t newCapacity;
+
+    if (needed <= *capacity) {
+        return;
+    }
+
+    newCapacity = *capacity ? *capacity : initialCapacity;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    *data = MMUReallocate(text->allocator, *data, newCapacity);
+    *capacity = newCapacity;
+}
+
+static void MMUTextAppendText(const char* run, size_t len,
+        const MMUContext* textContext, void* callbackContext) {
+    MMUText* text = (MMUText*)callbackContext;
+
+    // Keep room for the terminator written by finish
+    MMUTextReserve(text, &text->text, &text->textCapacity, text->textLen + len + 1,
+            MMUTextInitialText);
+    memcpy(text->text + text->textLen, run, len);
+    text->textLen += len;
+}
+
+static void MMUTextStartLink(const char* href, void* callbackContext) {
+    MMUText* text = (MMUText*)callbackContext;
+    size_t hrefLen = strlen(href);
+
+    MMUTextReserve(text, &text->hrefs, &text->hrefsCapacity, text->hrefsLen + hrefLen + 1,
+            MMUTextInitialHrefs);
+    memcpy(text->hrefs + text->hrefsLen, href, hrefLen + 1);
+    text->hrefsLen += hrefLen + 1;
+    ++text->hrefCount;
+}
+
+static void MMUTextEndLink(void* callbackContext) {
+}
+
+static void MMUTextStartListItem(int depth, unsigned int index, void* callbackContext) {
+}
+
+static void MMUTextEndListItem(void* callbackContext) {
+}
+
+static void MMUTextFinish(void* callbackContext) {
+    MMUText* text = (MMUText*)callbackContext;
+
+    MMUTextReserve(text, &text->text, &text->textCapacity, text->textLen + 1,
+            MMUTextInitialText);
+    text->text[text->textLen] = '\0';
+}
+
+const MMUCallbacks mmuTextCallbacks = {
+    MMUTextAppendText,
+    MMUTextStartLink,
+    MMUTextEndLink,
+    MMUTextStartListItem,
+    MMUTextEndListItem,
+    MMUTextFinish,
+    NULL
+};
+
+void mmuTextInit(MMUText* text) {
+    memset(text, 0, sizeof(MMUText));
+}
+
+void mmuTextDestroy(MMUText* text) {
+    const MMUAllocator* allocator = text->allocator;
+
+    MMUDeallocate(allocator, text->text);
+    MMUDeallocate(allocator, text->hrefs);
+    mmuTextInit(text);
+    text->allocator = allocator;
+}
+
+void mmuTextClear(MMUText* text) {
+    text->textLen = 0;
+    text->hrefsLen = 0;
+    text->hrefCount = 0;
+}
+
+MMUStatus mmuExtractText(const char* html, const MMUOptions* options, MMUText* text) {
+    MMUOptions plainOptions = *options;
+    size_t len = strlen(html);
+
+    plainOptions.outputFlags |= MMU_OUTPUT_PLAIN_TEXT;
+    mmuTextClear(text);
+    // As with documents the text nearly always fits in the size of the
+    // input, so it is allocated once
+    MMUTextReserve(text, &text->text, &text->textCapacity, len + 1, MMUTextInitialText);
+    return mmuParseHtmlN(html, len, &mmuTextCallbacks, &plainOptions, text);
+}
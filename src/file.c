@@ -0,0 +1,177 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "allocator.h"
+#include "html-parser.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum {
+    MMUFileReadSize = 64 * 1024
+};
+
+static int parseMapped(int fd, size_t size, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext, MMUStatus* status) {
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+    *status = mmuParseHtmlN((const char*)data, size, callbacks, options, callbackContext);
+    munmap(data, size);
+    return 1;
+}
+
+// Reads into buffer at offset, retrying interrupted reads
+static ssize_t readSome(int fd, char* buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = read(fd, buffer, size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+// libxml2 can take the input a piece at a time
+static MMUStatus parseStreamed(int fd, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    char* buffer = MMUAllocate(options->allocator, MMUFileReadSize);
+    MMUHtmlParser parser[1];
+    MMUStatus status;
+    ssize_t n;
+    int error;
+
+    MMUHtmlParserInit(parser, callbacks, options, callbackContext);
+    while (!parser->builder->status && (n = readSome(fd, buffer, MMUFileReadSize)) > 0) {
+        MMUHtmlParserFeed(parser, buffer, (size_t)n);
+    }
+    if (parser->builder->status) {
+        // Stopped by a limit, the rest of the input isn't needed
+        n = 0;
+    }
+    // A read error still finishes the document, with whatever arrived
+    // before it
+    error = errno;
+    status = MMUHtmlParserEnd(parser);
+    if (n < 0) {
+        status = MMU_STATUS_IO_ERROR;
+        errno = error;
+    }
+    MMUHtmlParserDestroy(parser);
+    MMUDeallocate(options->allocator, buffer);
+    return status;
+}
+
+// The native tokenizer needs the whole input
+static MMUStatus parseRead(int fd, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    size_t maxInputBytes = options->limits ? options->limits->maxInputBytes : 0;
+    size_t capacity = MMUFileReadSize;
+    size_t len = 0;
+    char* buffer = MMUAllocate(options->allocator, capacity);
+    MMUStatus status;
+    ssize_t n;
+    int error;
+
+    for (;;) {
+        if (len == capacity) {
+            capacity *= 2;
+            buffer = MMUReallocate(options->allocator, buffer, capacity);
+        }
+        n = readSome(fd, buffer + len, capacity - len);
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+        // Enough to know the input is too large, the parse reports it
+        if (maxInputBytes && len > maxInputBytes) {
+            n = 0;
+            break;
+        }
+    }
+
+    // As when streaming, a read error still parses what came before it
+    error = errno;
+    status = mmuParseHtmlN(buffer, len, callbacks, options, callbackContext);
+    if (n < 0) {
+        status = MMU_STATUS_IO_ERROR;
+        errno = error;
+    }
+    MMUDeallocate(options->allocator, buffer);
+    return status;
+}
+
+// For inputs which couldn't be opened at all, the callbacks still end with
+// finish like those of any other failed parse
+static MMUStatus finishUnread(const MMUCallbacks* callbacks, void* callbackContext) {
+    int error = errno;
+    callbacks->finish(callbackContext);
+    errno = error;
+    return MMU_STATUS_IO_ERROR;
+}
+
+MMUStatus mmuParseHtmlFd(int fd, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    struct stat info;
+    MMUStatus status;
+
+    if (fstat(fd, &info) != 0) {
+        return finishUnread(callbacks, callbackContext);
+    }
+    // Some special files claim to be empty, so they are read instead
+    if (S_ISREG(info.st_mode) && info.st_size > 0
+            && parseMapped(fd, (size_t)info.st_size, callbacks, options, callbackContext, &status)) {
+        return status;
+    }
+    if (MMUHtmlParserUsesNative(options)) {
+        return parseRead(fd, callbacks, options, callbackContext);
+    }
+    return parseStreamed(fd, callbacks, options, callbackContext);
+}
+
+MMUStatus mmuParseHtmlFile(const char* path, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    MMUStatus status;
+    int fd;
+
+    do {
+        fd = open(path, O_RDONLY);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return finishUnread(callbacks, callbackContext);
+    }
+    status = mmuParseHtmlFd(fd, callbacks, options, callbackContext);
+    if (status != MMU_STATUS_IO_ERROR) {
+        close(fd);
+    } else {
+        int error = errno;
+        close(fd);
+        errno = error;
+    }
+    return status;
+}
@@ -22,27 +22,71 @@
 
 #include "html-parser.h"
 
+#include "html-tokenizer.h"
+#include "stats.h"
+
 #include <libxml/HTMLparser.h>
+#include <libxml/encoding.h>
+#include <libxml/parserInternals.h>
 #include <libxml/tree.h>
 
+#include <limits.h>
+
 void MMUHtmlParserInit(MMUHtmlParser* parser, const MMUCallbacks* callbacks,
         const MMUOptions* options, void* callbackContext) {
     MMUBuilderInit(parser->builder, callbacks, options, callbackContext);
+    parser->pushContext = NULL;
+    parser->readContext = NULL;
+    parser->readContextUses = 0;
+    parser->document = NULL;
+    parser->walkNode = NULL;
+    parser->elementDepth = 0;
+    parser->maxDepth = MMUHtmlParserMaxDepth(options);
+    parser->inputBytes = 0;
+}
+
+enum {
+    MMUHtmlParserReadContextMaxUses = 1024
+};
+
+static void freePushContext(MMUHtmlParser* parser) {
+    if (parser->pushContext) {
+        htmlFreeParserCtxt((htmlParserCtxtPtr)parser->pushContext);
+        parser->pushContext = NULL;
+    }
+}
+
+static void freeDocument(MMUHtmlParser* parser) {
+    if (parser->document) {
+        xmlFreeDoc((xmlDocPtr)parser->document);
+        parser->document = NULL;
+    }
+    parser->walkNode = NULL;
 }
 
 void MMUHtmlParserDestroy(MMUHtmlParser* parser) {
+    freePushContext(parser);
+    freeDocument(parser);
+    if (parser->readContext) {
+        htmlFreeParserCtxt((htmlParserCtxtPtr)parser->readContext);
+    }
     MMUBuilderDestroy(parser->builder);
 }
 
-static void processNode(xmlNodePtr node, MMUBuilder* builder);
+void MMUHtmlParserReset(MMUHtmlParser* parser, void* callbackContext) {
+    freePushContext(parser);
+    freeDocument(parser);
+    parser->elementDepth = 0;
+    parser->inputBytes = 0;
+    MMUBuilderReset(parser->builder, callbackContext);
+}
 
-static void processLink(xmlElementPtr linkNode, MMUBuilder* builder) {
-    xmlAttributePtr attr = linkNode->attributes;
+static const char* findNodeAttribute(xmlElementPtr node, const char* name) {
+    xmlAttributePtr attr = node->attributes;
     while (attr) {
-        if (strcmp("href", (const char*)attr->name) == 0) {
+        if (strcmp(name, (const char*)attr->name) == 0) {
             if (attr->children && attr->children->type == XML_TEXT_NODE) {
-                MMUBuilderStartLink(builder, (const char*)attr->children->content);
-                return;
+                return (const char*)attr->children->content;
             }
         }
         if (attr->next && attr->next->type == XML_ATTRIBUTE_NODE) {
@@ -51,143 +95,515 @@ static void processLink(xmlElementPtr linkNode, MMUBuilder* builder) {
             attr = NULL;
         }
     }
-    MMUBuilderStartLink(builder, "");
-}
-
-static void processElementStart(xmlElementPtr elementNode, MMUBuilder* builder) {
-    const char* tagName = (const char*)elementNode->name;
-    if (strcmp("a", tagName) == 0) {
-        processLink(elementNode, builder);
-    } else if (strcmp("b", tagName) == 0) {
-        MMUBuilderPushBold(builder);
-    } else if (strcmp("br", tagName) == 0) {
-        MMUBuilderAppendLineSeparator(builder);
-    } else if (strcmp("em", tagName) == 0) {
-        MMUBuilderPushItalic(builder);
-    } else if (strcmp("h1", tagName) == 0) {
-        MMUBuilderPushHeading(builder, 1);
-    } else if (strcmp("h2", tagName) == 0) {
-        MMUBuilderPushHeading(builder, 2);
-    } else if (strcmp("h3", tagName) == 0) {
-        MMUBuilderPushHeading(builder, 3);
-    } else if (strcmp("h4", tagName) == 0) {
-        MMUBuilderPushHeading(builder, 4);
-    } else if (strcmp("h5", tagName) == 0) {
-        MMUBuilderPushHeading(builder, 5);
-    } else if (strcmp("h6", tagName) == 0) {
-        MMUBuilderPushHeading(builder, 6);
-    } else if (strcmp("i", tagName) == 0) {
-        MMUBuilderPushItalic(builder);
-    } else if (strcmp("li", tagName) == 0) {
-        // TODO
-    } else if (strcmp("ol", tagName) == 0) {
-        // TODO
-    } else if (strcmp("p", tagName) == 0) {
-        MMUBuilderStartParagraph(builder);
-    } else if (strcmp("strong", tagName) == 0) {
-        MMUBuilderPushBold(builder);
-    } else if (strcmp("u", tagName) == 0) {
-        MMUBuilderPushUnderline(builder);
-    } else if (strcmp("ul", tagName) == 0) {
-        // TODO
-    }
-}
-
-static void processElementEnd(xmlElementPtr elementNode, MMUBuilder* builder) {
-    const char* tagName = (const char*)elementNode->name;
-    if (strcmp("a", tagName) == 0) {
-        MMUBuilderEndLink(builder);
-    } else if (strcmp("b", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("br", tagName) == 0) {
-        // Do nothing
-    } else if (strcmp("em", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("h1", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("h2", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("h3", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("h4", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("h5", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("h6", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("i", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("li", tagName) == 0) {
-        // TODO
-    } else if (strcmp("ol", tagName) == 0) {
-        // TODO
-    } else if (strcmp("p", tagName) == 0) {
-        MMUBuilderEndParagraph(builder);
-    } else if (strcmp("strong", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("u", tagName) == 0) {
-        MMUBuilderPop(builder);
-    } else if (strcmp("ul", tagName) == 0) {
-        // TODO
-    }
-}
-
-static void processElementNode(xmlElementPtr elementNode, MMUBuilder* builder) {
-    processElementStart(elementNode, builder);
-
-    if (elementNode->children) {
-        processNode(elementNode->children, builder);
-    }
-
-    processElementEnd(elementNode, builder);
-}
-
-
-
-static void processTextNode(xmlNodePtr textNode, MMUBuilder* builder) {
-    const char* content = (const char*)textNode->content;
-    MMUBuilderAppendText(builder, content, strlen(content));
-}
-
-void processNode(xmlNodePtr node, MMUBuilder* builder) {
-    switch (node->type) {
-        case XML_ELEMENT_NODE:
-            processElementNode((xmlElementPtr)node, builder);
+    return "";
+}
+
+static const char* findAttribute(const xmlChar** attrs, const char* name) {
+    if (attrs) {
+        for (; attrs[0]; attrs += 2) {
+            if (strcmp(name, (const char*)attrs[0]) == 0 && attrs[1]) {
+                return (const char*)attrs[1];
+            }
+        }
+    }
+    return "";
+}
+
+int MMUHtmlParserResolveElement(const MMUOptions* options, MMUHtmlTag tag,
+        const char* name, size_t len) {
+    size_t i;
+
+    // Registered tags take precedence so that they can also restyle
+    // built-in ones
+    for (i = 0; i < options->extraTagCount; ++i) {
+        const char* extraName = options->extraTags[i].tagName;
+        size_t j;
+        for (j = 0; j < len && extraName[j]; ++j) {
+            char c = name[j];
+            if (c >= 'A' && c <= 'Z') {
+                c = c - 'A' + 'a';
+            }
+            if (c != extraName[j]) {
+                break;
+            }
+        }
+        if (j == len && extraName[j] == '\0') {
+            return MMU_HTML_TAG_COUNT + (int)i;
+        }
+    }
+    return tag;
+}
+
+const char* MMUHtmlParserAttribute(const MMUOptions* options, int element) {
+    switch (element) {
+        case MMU_HTML_TAG_A:
+            return options->outputFlags & MMU_OUTPUT_IGNORE_LINKS ? NULL : "href";
+        case MMU_HTML_TAG_OL:
+            return "start";
+        default:
+            return NULL;
+    }
+}
+
+// Reads an ordered list's start attribute, falling back to 1 for anything
+// but a number. Numbers too large for the builder are clamped.
+static unsigned int parseListStart(const char* value) {
+    unsigned int start = 0;
+
+    while (*value == ' ' || *value == '\t' || *value == '\n' || *value == '\f' || *value == '\r') {
+        ++value;
+    }
+    if (*value < '0' || *value > '9') {
+        return 1;
+    }
+    for (; *value >= '0' && *value <= '9'; ++value) {
+        unsigned int digit = (unsigned int)(*value - '0');
+        if (start > (UINT_MAX - digit) / 10) {
+            return UINT_MAX;
+        }
+        start = start * 10 + digit;
+    }
+    return start;
+}
+
+void MMUHtmlParserStartElement(MMUBuilder* builder, int element, const char* attribute) {
+    switch (element) {
+        case MMU_HTML_TAG_A:
+            if (builder->options->outputFlags & MMU_OUTPUT_IGNORE_LINKS) {
+                MMU_STATS_ADD(builder->options, elementsIgnored, 1);
+                return;
+            }
+            MMUBuilderStartLink(builder, attribute);
+            break;
+        case MMU_HTML_TAG_B:
+        case MMU_HTML_TAG_STRONG:
+            MMUBuilderPushBold(builder);
+            break;
+        case MMU_HTML_TAG_BR:
+            MMUBuilderAppendLineSeparator(builder);
+            break;
+        case MMU_HTML_TAG_EM:
+        case MMU_HTML_TAG_I:
+            MMUBuilderPushItalic(builder);
+            break;
+        case MMU_HTML_TAG_H1:
+        case MMU_HTML_TAG_H2:
+        case MMU_HTML_TAG_H3:
+        case MMU_HTML_TAG_H4:
+        case MMU_HTML_TAG_H5:
+        case MMU_HTML_TAG_H6:
+            MMUBuilderPushHeading(builder, element - MMU_HTML_TAG_H1 + 1);
+            break;
+        case MMU_HTML_TAG_LI:
+            // Items outside any list are ignored, and so are their ends,
+            // which come with the same lists open
+            if (builder->listDepth == 0) {
+                MMU_STATS_ADD(builder->options, elementsIgnored, 1);
+                return;
+            }
+            MMUBuilderStartListItem(builder);
+            break;
+        case MMU_HTML_TAG_OL:
+            MMUBuilderStartList(builder, 1, attribute ? parseListStart(attribute) : 1);
+            break;
+        case MMU_HTML_TAG_P:
+            MMUBuilderStartParagraph(builder);
+            break;
+        case MMU_HTML_TAG_PRE:
+            MMUBuilderStartPreformatted(builder);
             break;
-        case XML_TEXT_NODE:
-            processTextNode(node, builder);
+        case MMU_HTML_TAG_U:
+            MMUBuilderPushUnderline(builder);
+            break;
+        case MMU_HTML_TAG_UL:
+            MMUBuilderStartList(builder, 0, 0);
             break;
         default:
-            if (node->children) {
-                processNode(node->children, builder);
+            if (element < MMU_HTML_TAG_COUNT) {
+                MMU_STATS_ADD(builder->options, elementsIgnored, 1);
+                return;
+            }
+            MMUBuilderPushStyle(builder,
+                    builder->options->extraTags[element - MMU_HTML_TAG_COUNT].textStyle);
+            break;
+    }
+
+    MMU_STATS_ADD(builder->options, elementsRecognised, 1);
+}
+
+void MMUHtmlParserEndElement(MMUBuilder* builder, int element) {
+    switch (element) {
+        case MMU_HTML_TAG_A:
+            if (!(builder->options->outputFlags & MMU_OUTPUT_IGNORE_LINKS)) {
+                MMUBuilderEndLink(builder);
             }
             break;
+        case MMU_HTML_TAG_B:
+        case MMU_HTML_TAG_EM:
+        case MMU_HTML_TAG_H1:
+        case MMU_HTML_TAG_H2:
+        case MMU_HTML_TAG_H3:
+        case MMU_HTML_TAG_H4:
+        case MMU_HTML_TAG_H5:
+        case MMU_HTML_TAG_H6:
+        case MMU_HTML_TAG_I:
+        case MMU_HTML_TAG_STRONG:
+        case MMU_HTML_TAG_U:
+            MMUBuilderPop(builder);
+            break;
+        case MMU_HTML_TAG_LI:
+            if (builder->listDepth) {
+                MMUBuilderEndListItem(builder);
+            }
+            break;
+        case MMU_HTML_TAG_OL:
+        case MMU_HTML_TAG_UL:
+            MMUBuilderEndList(builder);
+            break;
+        case MMU_HTML_TAG_P:
+            MMUBuilderEndParagraph(builder);
+            break;
+        case MMU_HTML_TAG_PRE:
+            MMUBuilderEndPreformatted(builder);
+            break;
+        default:
+            if (element >= MMU_HTML_TAG_COUNT) {
+                MMUBuilderPop(builder);
+            }
+            break;
+    }
+}
+
+static int resolveElement(MMUBuilder* builder, const char* tagName) {
+    size_t len = strlen(tagName);
+    return MMUHtmlParserResolveElement(builder->options,
+            MMUHtmlTagLookup(tagName, len), tagName, len);
+}
+
+unsigned int MMUHtmlParserMaxDepth(const MMUOptions* options) {
+    if (options->maxDepth == 0 || options->maxDepth > MMUMaxElementDepth) {
+        return MMUMaxElementDepth;
+    }
+    return options->maxDepth;
+}
+
+// Called when the walk first reaches a node, returns whether its children
+// should be visited
+static int enterNode(xmlNodePtr node, MMUBuilder* builder, int* elementStack,
+        unsigned int* depth, unsigned int maxDepth) {
+    MMU_STATS_ADD(builder->options, nodesVisited, 1);
+
+    switch (node->type) {
+        case XML_ELEMENT_NODE:
+            MMUBuilderCountNode(builder);
+            MMUBuilderCheckDepth(builder, *depth + 1);
+            if (*depth < maxDepth) {
+                int element = resolveElement(builder, (const char*)node->name);
+                const char* attribute = MMUHtmlParserAttribute(builder->options, element);
+                elementStack[*depth] = element;
+                MMUHtmlParserStartElement(builder, element,
+                        attribute ? findNodeAttribute((xmlElementPtr)node, attribute) : NULL);
+            }
+            ++*depth;
+            return 1;
+        case XML_TEXT_NODE: {
+            // The tree outlives the builder's last flush, so text nodes
+            // can be passed on in place
+            const char* content = (const char*)node->content;
+            MMUBuilderCountNode(builder);
+            MMUBuilderAppendBorrowedText(builder, content, strlen(content));
+            return 0;
+        }
+        default:
+            return 1;
+    }
+}
+
+static void leaveNode(xmlNodePtr node, MMUBuilder* builder, int* elementStack,
+        unsigned int* depth, unsigned int maxDepth) {
+    if (node->type == XML_ELEMENT_NODE && --*depth < maxDepth) {
+        MMUHtmlParserEndElement(builder, elementStack[*depth]);
     }
+}
+
+// Pre-order walk of the tree. libxml2 nodes link to their parent and next
+// sibling, so only the resolved elements need a stack and the walk itself
+// runs in constant C stack space however deep or wide the document is. At
+// the top of the loop node is the next one to enter, which is all there is
+// to remember between calls. Once the builder stops the walk is simply
+// abandoned, the builder ignores the end events it would have needed.
+int MMUHtmlParserWalk(MMUHtmlParser* parser, size_t maxNodes) {
+    MMUBuilder* builder = parser->builder;
+    xmlNodePtr root = (xmlNodePtr)parser->document;
+    xmlNodePtr node = (xmlNodePtr)parser->walkNode;
 
-    if (node->next) {
-        processNode(node->next, builder);
+    for (; node && !builder->status && maxNodes > 0; --maxNodes) {
+        if (enterNode(node, builder, parser->elementStack, &parser->elementDepth, parser->maxDepth)
+                && node->children) {
+            node = node->children;
+            continue;
+        }
+
+        // Leave the node and any ancestors it was the last child of
+        for (;;) {
+            leaveNode(node, builder, parser->elementStack, &parser->elementDepth, parser->maxDepth);
+            if (node == root) {
+                node = NULL;
+                break;
+            }
+            if (node->next) {
+                node = node->next;
+                break;
+            }
+            node = node->parent;
+        }
     }
+
+    parser->walkNode = builder->status ? NULL : node;
+    return parser->walkNode != NULL;
+}
+
+static int isUtf8Encoding(const char* encoding) {
+    static const char* const names[] = { "utf-8", "utf8", "us-ascii", "ascii" };
+    size_t i;
+
+    if (!encoding) {
+        return 1;
+    }
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        const char* a = encoding;
+        const char* b = names[i];
+        while (*a && ((*a >= 'A' && *a <= 'Z') ? *a - 'A' + 'a' : *a) == *b) {
+            ++a;
+            ++b;
+        }
+        if (!*a && !*b) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int MMUHtmlParserUsesNative(const MMUOptions* options) {
+    return options->htmlBackend == MMU_HTML_BACKEND_NATIVE && isUtf8Encoding(options->encoding);
 }
 
-void MMUHtmlParserParse(MMUHtmlParser* parser, const char* html) {
-    // TODO
-    int rc;
+MMUStatus MMUHtmlParserParse(MMUHtmlParser* parser, const char* html, size_t len) {
+    const MMUOptions* options = parser->builder->options;
+
+    MMUBuilderCheckInputSize(parser->builder, len);
+    if (parser->builder->status) {
+        return MMUBuilderFinish(parser->builder);
+    }
+
+    if (!MMUHtmlParserUsesNative(options) && len > INT_MAX) {
+        // Too large for htmlCtxtReadMemory, but fine for the push parser
+        MMUHtmlParserFeed(parser, html, len);
+        return MMUHtmlParserEnd(parser);
+    }
+
+    MMU_STATS_TIMER_START(options, totalStart);
+
+    if (MMUHtmlParserUsesNative(options)) {
+        MMUHtmlTokenizer tokenizer[1];
+        MMU_STATS_TIMER_START(options, parseStart);
+        MMUHtmlTokenizerInit(tokenizer, parser->builder);
+        MMUHtmlTokenizerParse(tokenizer, html, len);
+        MMUHtmlTokenizerDestroy(tokenizer);
+        MMU_STATS_TIMER_END(options, parseNanoseconds, parseStart);
+        MMUBuilderFinish(parser->builder);
+        MMU_STATS_TIMER_END(options, totalNanoseconds, totalStart);
+        return parser->builder->status;
+    }
+
+    MMUHtmlParserLoad(parser, html, len);
+    {
+        MMU_STATS_TIMER_START(options, walkStart);
+        MMUHtmlParserWalk(parser, (size_t)-1);
+        MMU_STATS_TIMER_END(options, walkNanoseconds, walkStart);
+    }
+
+    MMUBuilderFinish(parser->builder);
+    freeDocument(parser);
+    MMU_STATS_TIMER_END(options, totalNanoseconds, totalStart);
+    return parser->builder->status;
+}
+
+void MMUHtmlParserLoad(MMUHtmlParser* parser, const char* html, size_t len) {
+    const MMUOptions* options = parser->builder->options;
     htmlDocPtr doc;
 
-    doc = htmlReadDoc((const unsigned char*)html, NULL, "UTF-8", XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+    freeDocument(parser);
+    parser->elementDepth = 0;
+
+    // The context's dictionary keeps every element and attribute name it
+    // has seen, so it is replaced now and then to bound its growth
+    if (parser->readContext && ++parser->readContextUses >= MMUHtmlParserReadContextMaxUses) {
+        htmlFreeParserCtxt((htmlParserCtxtPtr)parser->readContext);
+        parser->readContext = NULL;
+    }
+    if (!parser->readContext) {
+        parser->readContext = htmlNewParserCtxt();
+        parser->readContextUses = 0;
+    }
+
+    {
+        MMU_STATS_TIMER_START(options, parseStart);
+        // Reusing the context keeps its buffers and dictionary warm
+        doc = parser->readContext
+            ? htmlCtxtReadMemory((htmlParserCtxtPtr)parser->readContext, html, (int)len, NULL,
+                    options->encoding ? options->encoding : "UTF-8",
+                    HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING)
+            : NULL;
+        MMU_STATS_TIMER_END(options, parseNanoseconds, parseStart);
+    }
 
+    parser->document = doc;
     if (doc && doc->type == XML_HTML_DOCUMENT_NODE) {
-        processNode((xmlNodePtr)doc, parser->builder);
-        xmlFreeDoc(doc);
+        parser->walkNode = doc;
+    }
+}
+
+static void onSaxStartElement(void* ctx, const xmlChar* name, const xmlChar** attrs) {
+    MMUHtmlParser* parser = (MMUHtmlParser*)((htmlParserCtxtPtr)ctx)->_private;
+    int element;
+    const char* attribute;
+
+    MMU_STATS_ADD(parser->builder->options, nodesVisited, 1);
+    MMUBuilderCountNode(parser->builder);
+    MMUBuilderCheckDepth(parser->builder, parser->elementDepth + 1);
+    if (parser->builder->status) {
+        // No more events, the rest of the input is ignored
+        xmlStopParser((xmlParserCtxtPtr)ctx);
+        return;
+    }
+    if (parser->elementDepth++ >= parser->maxDepth) {
+        return;
     }
 
+    // The end handler pops the resolved element instead of looking the name
+    // up again. End events match start events in order, but input which
+    // ends inside elements gets none, which MMUBuilderFinish makes up for.
+    element = resolveElement(parser->builder, (const char*)name);
+    parser->elementStack[parser->elementDepth - 1] = element;
+
+    attribute = MMUHtmlParserAttribute(parser->builder->options, element);
+    MMUHtmlParserStartElement(parser->builder, element,
+            attribute ? findAttribute(attrs, attribute) : NULL);
+}
+
+static void onSaxEndElement(void* ctx, const xmlChar* name) {
+    MMUHtmlParser* parser = (MMUHtmlParser*)((htmlParserCtxtPtr)ctx)->_private;
+
+    if (parser->elementDepth > 0 && --parser->elementDepth < parser->maxDepth) {
+        MMUHtmlParserEndElement(parser->builder, parser->elementStack[parser->elementDepth]);
+    }
+}
+
+static void onSaxCharacters(void* ctx, const xmlChar* ch, int len) {
+    MMUBuilder* builder = ((MMUHtmlParser*)((htmlParserCtxtPtr)ctx)->_private)->builder;
+    MMU_STATS_ADD(builder->options, nodesVisited, 1);
+    MMUBuilderCountNode(builder);
+    MMUBuilderAppendText(builder, (const char*)ch, (size_t)len);
+    if (builder->status) {
+        xmlStopParser((xmlParserCtxtPtr)ctx);
+    }
+}
+
+static void onSaxIgnored(void* ctx, const xmlChar* ch, int len) {
+    // Blanks and script/style content never become text nodes in the
+    // tree built by htmlReadDoc, so they are dropped here as well
+}
+
+// Shared by every push parser on every thread, so it is never written to
+static const htmlSAXHandler saxHandler = {
+    .startElement = onSaxStartElement,
+    .endElement = onSaxEndElement,
+    .characters = onSaxCharacters,
+    .ignorableWhitespace = onSaxIgnored,
+    .cdataBlock = onSaxIgnored,
+    .initialized = 1
+};
+
+static htmlParserCtxtPtr createPushContext(MMUHtmlParser* parser) {
+    htmlParserCtxtPtr ctxt;
+
+    // libxml2 copies the handler into the context, it only lacks the const
+    ctxt = htmlCreatePushParserCtxt((htmlSAXHandlerPtr)&saxHandler, NULL, NULL, 0, NULL,
+            XML_CHAR_ENCODING_UTF8);
+    if (ctxt) {
+        const char* encoding = parser->builder->options->encoding;
+        xmlCharEncodingHandlerPtr handler;
+
+        if (encoding && (handler = xmlFindCharEncodingHandler(encoding)) != NULL) {
+            xmlSwitchToEncoding(ctxt, handler);
+        }
+        htmlCtxtUseOptions(ctxt, HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+        // The SAX callbacks receive the parser context, so keep ours in the
+        // slot libxml2 reserves for applications
+        ctxt->_private = parser;
+    }
+    return ctxt;
+}
+
+void MMUHtmlParserFeed(MMUHtmlParser* parser, const char* chunk, size_t len) {
+    MMU_STATS_TIMER_START(parser->builder->options, parseStart);
+
+    parser->inputBytes += len;
+    MMUBuilderCheckInputSize(parser->builder, parser->inputBytes);
+    if (parser->builder->status) {
+        return;
+    }
+
+    if (!parser->pushContext) {
+        parser->pushContext = createPushContext(parser);
+        if (!parser->pushContext) {
+            return;
+        }
+    }
+
+    while (len > 0) {
+        // htmlParseChunk takes an int size
+        int size = len > INT_MAX ? INT_MAX : (int)len;
+        htmlParseChunk((htmlParserCtxtPtr)parser->pushContext, chunk, size, 0);
+        if (parser->builder->status) {
+            break;
+        }
+        chunk += size;
+        len -= size;
+    }
+
+    MMU_STATS_TIMER_END(parser->builder->options, parseNanoseconds, parseStart);
+    MMU_STATS_TIMER_END(parser->builder->options, totalNanoseconds, parseStart);
+}
+
+MMUStatus MMUHtmlParserEnd(MMUHtmlParser* parser) {
+    MMU_STATS_TIMER_START(parser->builder->options, totalStart);
+
+    if (parser->pushContext && !parser->builder->status) {
+        MMU_STATS_TIMER_START(parser->builder->options, parseStart);
+        htmlParseChunk((htmlParserCtxtPtr)parser->pushContext, NULL, 0, 1);
+        MMU_STATS_TIMER_END(parser->builder->options, parseNanoseconds, parseStart);
+    }
+    freePushContext(parser);
+
     MMUBuilderFinish(parser->builder);
+    MMU_STATS_TIMER_END(parser->builder->options, totalNanoseconds, totalStart);
+    return parser->builder->status;
 }
 
-void mmuParseHtml(const char* html, const MMUCallbacks* callbacks,
+MMUStatus mmuParseHtml(const char* html, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    return mmuParseHtmlN(html, strlen(html), callbacks, options, callbackContext);
+}
+
+MMUStatus mmuParseHtmlN(const char* html, size_t len, const MMUCallbacks* callbacks,
         const MMUOptions* options, void* callbackContext) {
     MMUHtmlParser parser[1];
+    MMUStatus status;
+
     MMUHtmlParserInit(parser, callbacks, options, callbackContext);
-    MMUHtmlParserParse(parser, html);
+    status = MMUHtmlParserParse(parser, html, len);
     MMUHtmlParserDestroy(parser);
+    return status;
 }
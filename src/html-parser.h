@@ -24,14 +24,74 @@
 #define MMU_HTML_PARSER_H_
 
 #include "builder.h"
+#include "html-tags.h"
 
 typedef struct MMUHtmlParser {
     MMUBuilder builder[1];
+    // libxml2 push parser context, created by the first MMUHtmlParserFeed
+    void* pushContext;
+    // libxml2 context for whole documents, kept for reuse across
+    // MMUHtmlParserReset
+    void* readContext;
+    unsigned int readContextUses;
+    // libxml2 tree loaded by MMUHtmlParserLoad, and the next of its nodes
+    // MMUHtmlParserWalk enters, NULL once the walk is over
+    void* document;
+    void* walkNode;
+    // Elements resolved by the SAX start handler or the walk, popped by the
+    // end handler or on leaving them. elementDepth keeps counting past
+    // maxDepth so that the end events of elements too deep to be styled can
+    // be matched up and ignored.
+    int elementStack[MMUMaxElementDepth];
+    unsigned int elementDepth;
+    unsigned int maxDepth;
+    // Streamed so far, for MMULimits.maxInputBytes
+    size_t inputBytes;
 } MMUHtmlParser;
 
 void MMUHtmlParserInit(MMUHtmlParser* parser, const MMUCallbacks* callbacks,
         const MMUOptions* options, void* callbackContext);
 void MMUHtmlParserDestroy(MMUHtmlParser* parser);
-void MMUHtmlParserParse(MMUHtmlParser* parser, const char* html);
+// Makes the parser ready for the next document (abandoning any streamed
+// one), keeping the memory it has grown so far
+void MMUHtmlParserReset(MMUHtmlParser* parser, void* callbackContext);
+// Returns the status of the builder
+MMUStatus MMUHtmlParserParse(MMUHtmlParser* parser, const char* html, size_t len);
+
+// MMUHtmlParserParse's libxml2 path a step at a time: MMUHtmlParserLoad
+// builds the tree of a document of at most INT_MAX bytes, and each
+// MMUHtmlParserWalk takes the builder through up to maxNodes more of its
+// nodes, returning whether any are left. Finishing the builder is up to the
+// caller. The tree, and with it any borrowed text, lives until the parser
+// is reset or destroyed.
+void MMUHtmlParserLoad(MMUHtmlParser* parser, const char* html, size_t len);
+int MMUHtmlParserWalk(MMUHtmlParser* parser, size_t maxNodes);
+
+// Element handling shared by the libxml2 and native front-ends. Each element
+// is resolved once: built-in tags map to their MMUHtmlTag, tags registered
+// through MMUOptions.extraTags to MMU_HTML_TAG_COUNT plus their index.
+// attribute is the value of the one attribute the element uses, a link's
+// href or an ordered list's start, and is NULL or "" when it has none.
+int MMUHtmlParserResolveElement(const MMUOptions* options, MMUHtmlTag tag,
+        const char* name, size_t len);
+void MMUHtmlParserStartElement(MMUBuilder* builder, int element, const char* attribute);
+// Name of the attribute element uses, which the front-ends look for before
+// starting it, or NULL if it needs none
+const char* MMUHtmlParserAttribute(const MMUOptions* options, int element);
+void MMUHtmlParserEndElement(MMUBuilder* builder, int element);
+// Effective nesting limit for MMUOptions.maxDepth
+unsigned int MMUHtmlParserMaxDepth(const MMUOptions* options);
+// Whether the native tokenizer handles the input, which takes both the
+// back-end and an encoding it can read
+int MMUHtmlParserUsesNative(const MMUOptions* options);
+
+// Streaming mode: the document is fed in chunks of any size and the builder
+// is driven from SAX events as they arrive, so no tree is ever built.
+// MMUHtmlParserEnd flushes any remaining input and calls finish. This is
+// always libxml2's push parser, whose output matches MMUHtmlParserParse for
+// well-formed markup only: it recovers from tag soup differently from the
+// tree builder (after "</em><p>x" it drops everything, for one).
+void MMUHtmlParserFeed(MMUHtmlParser* parser, const char* chunk, size_t len);
+MMUStatus MMUHtmlParserEnd(MMUHtmlParser* parser);
     
 #endif
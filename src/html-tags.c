@@ -0,0 +1,467 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "html-tags.h"
+
+#include <string.h>
+
+// The auto-close table was derived from libxml2's HTML parser so that the
+// native tokenizer builds the same element structure from tag soup.
+static const MMUHtmlTag closedByA[] = {
+    MMU_HTML_TAG_A, MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_TABLE,
+    MMU_HTML_TAG_TD, MMU_HTML_TAG_TH, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByAddress[] = {
+    MMU_HTML_TAG_DD, MMU_HTML_TAG_DL, MMU_HTML_TAG_DT,
+    MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI, MMU_HTML_TAG_UL,
+    MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByB[] = {
+    MMU_HTML_TAG_CENTER, MMU_HTML_TAG_P, MMU_HTML_TAG_TD,
+    MMU_HTML_TAG_TH, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByBig[] = {
+    MMU_HTML_TAG_P, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByCaption[] = {
+    MMU_HTML_TAG_COL, MMU_HTML_TAG_COLGROUP, MMU_HTML_TAG_TBODY,
+    MMU_HTML_TAG_TFOOT, MMU_HTML_TAG_THEAD, MMU_HTML_TAG_TR,
+    MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByColgroup[] = {
+    MMU_HTML_TAG_COLGROUP, MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TFOOT,
+    MMU_HTML_TAG_THEAD, MMU_HTML_TAG_TR, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByDd[] = {
+    MMU_HTML_TAG_DT, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByDir[] = {
+    MMU_HTML_TAG_DD, MMU_HTML_TAG_DL, MMU_HTML_TAG_DT,
+    MMU_HTML_TAG_FORM, MMU_HTML_TAG_UL, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByDl[] = {
+    MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByDt[] = {
+    MMU_HTML_TAG_DD, MMU_HTML_TAG_DL, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByFont[] = {
+    MMU_HTML_TAG_CENTER, MMU_HTML_TAG_TD, MMU_HTML_TAG_TH,
+    MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByForm[] = {
+    MMU_HTML_TAG_FORM, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByH1[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByH2[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByH3[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByH4[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByH5[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByH6[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByI[] = {
+    MMU_HTML_TAG_CENTER, MMU_HTML_TAG_P, MMU_HTML_TAG_TD,
+    MMU_HTML_TAG_TH, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByLegend[] = {
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByLi[] = {
+    MMU_HTML_TAG_LI, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByMenu[] = {
+    MMU_HTML_TAG_DD, MMU_HTML_TAG_DL, MMU_HTML_TAG_DT,
+    MMU_HTML_TAG_FORM, MMU_HTML_TAG_UL, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByOl[] = {
+    MMU_HTML_TAG_FORM, MMU_HTML_TAG_UL, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByOption[] = {
+    MMU_HTML_TAG_OPTGROUP, MMU_HTML_TAG_OPTION, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByP[] = {
+    MMU_HTML_TAG_TITLE, MMU_HTML_TAG_ADDRESS, MMU_HTML_TAG_BLOCKQUOTE,
+    MMU_HTML_TAG_CAPTION, MMU_HTML_TAG_CENTER, MMU_HTML_TAG_COL,
+    MMU_HTML_TAG_COLGROUP, MMU_HTML_TAG_DD, MMU_HTML_TAG_DIR,
+    MMU_HTML_TAG_DIV, MMU_HTML_TAG_DL, MMU_HTML_TAG_DT,
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_H1,
+    MMU_HTML_TAG_H2, MMU_HTML_TAG_H3, MMU_HTML_TAG_H4,
+    MMU_HTML_TAG_H5, MMU_HTML_TAG_H6, MMU_HTML_TAG_HR,
+    MMU_HTML_TAG_LI, MMU_HTML_TAG_MENU, MMU_HTML_TAG_OL,
+    MMU_HTML_TAG_P, MMU_HTML_TAG_PRE, MMU_HTML_TAG_TABLE,
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TD, MMU_HTML_TAG_TFOOT,
+    MMU_HTML_TAG_TH, MMU_HTML_TAG_TR, MMU_HTML_TAG_UL,
+    MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByPre[] = {
+    MMU_HTML_TAG_DD, MMU_HTML_TAG_DL, MMU_HTML_TAG_DT,
+    MMU_HTML_TAG_FIELDSET, MMU_HTML_TAG_FORM, MMU_HTML_TAG_LI,
+    MMU_HTML_TAG_TABLE, MMU_HTML_TAG_UL, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByS[] = {
+    MMU_HTML_TAG_P, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByScript[] = {
+    MMU_HTML_TAG_NOSCRIPT, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedBySmall[] = {
+    MMU_HTML_TAG_P, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedBySpan[] = {
+    MMU_HTML_TAG_TD, MMU_HTML_TAG_TH, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByStrike[] = {
+    MMU_HTML_TAG_P, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByTbody[] = {
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TFOOT, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByTd[] = {
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TD, MMU_HTML_TAG_TFOOT,
+    MMU_HTML_TAG_TH, MMU_HTML_TAG_TR, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByTfoot[] = {
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByTh[] = {
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TD, MMU_HTML_TAG_TFOOT,
+    MMU_HTML_TAG_TH, MMU_HTML_TAG_TR, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByThead[] = {
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TFOOT, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByTr[] = {
+    MMU_HTML_TAG_TBODY, MMU_HTML_TAG_TFOOT, MMU_HTML_TAG_TR,
+    MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByTt[] = {
+    MMU_HTML_TAG_P, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByU[] = {
+    MMU_HTML_TAG_P, MMU_HTML_TAG_TD, MMU_HTML_TAG_TH,
+    MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTag closedByUl[] = {
+    MMU_HTML_TAG_ADDRESS, MMU_HTML_TAG_FORM, MMU_HTML_TAG_MENU,
+    MMU_HTML_TAG_OL, MMU_HTML_TAG_PRE, MMU_HTML_TAG_UNKNOWN
+};
+
+static const MMUHtmlTagInfo tagInfo[MMU_HTML_TAG_COUNT] = {
+    { "", 0, 100, NULL },
+    { "a", 0, 100, closedByA },
+    { "abbr", 0, 100, NULL },
+    { "address", 0, 100, closedByAddress },
+    { "area", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "b", 0, 100, closedByB },
+    { "base", MMU_HTML_TAG_FLAG_VOID | MMU_HTML_TAG_FLAG_HEAD, 100, NULL },
+    { "basefont", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "big", 0, 100, closedByBig },
+    { "blockquote", 0, 100, NULL },
+    { "body", 0, 200, NULL },
+    { "br", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "caption", 0, 100, closedByCaption },
+    { "center", 0, 100, NULL },
+    { "cite", 0, 100, NULL },
+    { "code", 0, 100, NULL },
+    { "col", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "colgroup", 0, 100, closedByColgroup },
+    { "dd", 0, 100, closedByDd },
+    { "del", 0, 100, NULL },
+    { "dfn", 0, 100, NULL },
+    { "dir", 0, 100, closedByDir },
+    { "div", 0, 150, NULL },
+    { "dl", 0, 100, closedByDl },
+    { "dt", 0, 100, closedByDt },
+    { "em", 0, 100, NULL },
+    { "fieldset", 0, 100, NULL },
+    { "font", 0, 100, closedByFont },
+    { "form", 0, 100, closedByForm },
+    { "frame", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "h1", 0, 100, closedByH1 },
+    { "h2", 0, 100, closedByH2 },
+    { "h3", 0, 100, closedByH3 },
+    { "h4", 0, 100, closedByH4 },
+    { "h5", 0, 100, closedByH5 },
+    { "h6", 0, 100, closedByH6 },
+    { "head", 0, 200, NULL },
+    { "hr", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "html", 0, 220, NULL },
+    { "i", 0, 100, closedByI },
+    { "img", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "input", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "ins", 0, 100, NULL },
+    { "isindex", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "kbd", 0, 100, NULL },
+    { "label", 0, 100, NULL },
+    { "legend", 0, 100, closedByLegend },
+    { "li", 0, 100, closedByLi },
+    { "link", MMU_HTML_TAG_FLAG_VOID | MMU_HTML_TAG_FLAG_HEAD, 100, NULL },
+    { "map", 0, 100, NULL },
+    { "menu", 0, 100, closedByMenu },
+    { "meta", MMU_HTML_TAG_FLAG_VOID | MMU_HTML_TAG_FLAG_HEAD, 100, NULL },
+    { "noscript", 0, 100, NULL },
+    { "object", 0, 100, NULL },
+    { "ol", 0, 100, closedByOl },
+    { "optgroup", 0, 100, NULL },
+    { "option", 0, 100, closedByOption },
+    { "p", 0, 100, closedByP },
+    { "param", MMU_HTML_TAG_FLAG_VOID, 100, NULL },
+    { "pre", 0, 100, closedByPre },
+    { "q", 0, 100, NULL },
+    { "s", 0, 100, closedByS },
+    { "samp", 0, 100, NULL },
+    { "script", MMU_HTML_TAG_FLAG_RAW_TEXT | MMU_HTML_TAG_FLAG_HEAD, 100, closedByScript },
+    { "select", 0, 100, NULL },
+    { "small", 0, 100, closedBySmall },
+    { "span", 0, 100, closedBySpan },
+    { "strike", 0, 100, closedByStrike },
+    { "strong", 0, 100, NULL },
+    { "style", MMU_HTML_TAG_FLAG_RAW_TEXT | MMU_HTML_TAG_FLAG_HEAD, 100, NULL },
+    { "sub", 0, 100, NULL },
+    { "sup", 0, 100, NULL },
+    { "table", 0, 190, NULL },
+    { "tbody", 0, 180, closedByTbody },
+    { "td", 0, 160, closedByTd },
+    { "tfoot", 0, 180, closedByTfoot },
+    { "th", 0, 160, closedByTh },
+    { "thead", 0, 180, closedByThead },
+    { "title", MMU_HTML_TAG_FLAG_HEAD, 100, NULL },
+    { "tr", 0, 170, closedByTr },
+    { "tt", 0, 100, closedByTt },
+    { "u", 0, 100, closedByU },
+    { "ul", 0, 100, closedByUl },
+    { "var", 0, 100, NULL }
+};
+
+// One line per tag, grouped by first character. The length is checked
+// first, so only tags of the same length get compared.
+#define MMU_HTML_TAG_NAME(literal, tag) \
+    if (len == sizeof(literal) - 1 && memcmp(name, literal, sizeof(literal) - 1) == 0) { \
+        return MMU_HTML_TAG_##tag; \
+    }
+
+MMUHtmlTag MMUHtmlTagLookup(const char* name, size_t len) {
+    // Kept in step with the tag table by hand, make check compares the two
+    if (len == 0) {
+        return MMU_HTML_TAG_UNKNOWN;
+    }
+    switch (name[0]) {
+        case 'a':
+            MMU_HTML_TAG_NAME("a", A)
+            MMU_HTML_TAG_NAME("abbr", ABBR)
+            MMU_HTML_TAG_NAME("address", ADDRESS)
+            MMU_HTML_TAG_NAME("area", AREA)
+            break;
+        case 'b':
+            MMU_HTML_TAG_NAME("b", B)
+            MMU_HTML_TAG_NAME("base", BASE)
+            MMU_HTML_TAG_NAME("basefont", BASEFONT)
+            MMU_HTML_TAG_NAME("big", BIG)
+            MMU_HTML_TAG_NAME("blockquote", BLOCKQUOTE)
+            MMU_HTML_TAG_NAME("body", BODY)
+            MMU_HTML_TAG_NAME("br", BR)
+            break;
+        case 'c':
+            MMU_HTML_TAG_NAME("caption", CAPTION)
+            MMU_HTML_TAG_NAME("center", CENTER)
+            MMU_HTML_TAG_NAME("cite", CITE)
+            MMU_HTML_TAG_NAME("code", CODE)
+            MMU_HTML_TAG_NAME("col", COL)
+            MMU_HTML_TAG_NAME("colgroup", COLGROUP)
+            break;
+        case 'd':
+            MMU_HTML_TAG_NAME("dd", DD)
+            MMU_HTML_TAG_NAME("del", DEL)
+            MMU_HTML_TAG_NAME("dfn", DFN)
+            MMU_HTML_TAG_NAME("dir", DIR)
+            MMU_HTML_TAG_NAME("div", DIV)
+            MMU_HTML_TAG_NAME("dl", DL)
+            MMU_HTML_TAG_NAME("dt", DT)
+            break;
+        case 'e':
+            MMU_HTML_TAG_NAME("em", EM)
+            break;
+        case 'f':
+            MMU_HTML_TAG_NAME("fieldset", FIELDSET)
+            MMU_HTML_TAG_NAME("font", FONT)
+            MMU_HTML_TAG_NAME("form", FORM)
+            MMU_HTML_TAG_NAME("frame", FRAME)
+            break;
+        case 'h':
+            MMU_HTML_TAG_NAME("h1", H1)
+            MMU_HTML_TAG_NAME("h2", H2)
+            MMU_HTML_TAG_NAME("h3", H3)
+            MMU_HTML_TAG_NAME("h4", H4)
+            MMU_HTML_TAG_NAME("h5", H5)
+            MMU_HTML_TAG_NAME("h6", H6)
+            MMU_HTML_TAG_NAME("head", HEAD)
+            MMU_HTML_TAG_NAME("hr", HR)
+            MMU_HTML_TAG_NAME("html", HTML)
+            break;
+        case 'i':
+            MMU_HTML_TAG_NAME("i", I)
+            MMU_HTML_TAG_NAME("img", IMG)
+            MMU_HTML_TAG_NAME("input", INPUT)
+            MMU_HTML_TAG_NAME("ins", INS)
+            MMU_HTML_TAG_NAME("isindex", ISINDEX)
+            break;
+        case 'k':
+            MMU_HTML_TAG_NAME("kbd", KBD)
+            break;
+        case 'l':
+            MMU_HTML_TAG_NAME("label", LABEL)
+            MMU_HTML_TAG_NAME("legend", LEGEND)
+            MMU_HTML_TAG_NAME("li", LI)
+            MMU_HTML_TAG_NAME("link", LINK)
+            break;
+        case 'm':
+            MMU_HTML_TAG_NAME("map", MAP)
+            MMU_HTML_TAG_NAME("menu", MENU)
+            MMU_HTML_TAG_NAME("meta", META)
+            break;
+        case 'n':
+            MMU_HTML_TAG_NAME("noscript", NOSCRIPT)
+            break;
+        case 'o':
+            MMU_HTML_TAG_NAME("object", OBJECT)
+            MMU_HTML_TAG_NAME("ol", OL)
+            MMU_HTML_TAG_NAME("optgroup", OPTGROUP)
+            MMU_HTML_TAG_NAME("option", OPTION)
+            break;
+        case 'p':
+            MMU_HTML_TAG_NAME("p", P)
+            MMU_HTML_TAG_NAME("param", PARAM)
+            MMU_HTML_TAG_NAME("pre", PRE)
+            break;
+        case 'q':
+            MMU_HTML_TAG_NAME("q", Q)
+            break;
+        case 's':
+            MMU_HTML_TAG_NAME("s", S)
+            MMU_HTML_TAG_NAME("samp", SAMP)
+            MMU_HTML_TAG_NAME("script", SCRIPT)
+            MMU_HTML_TAG_NAME("select", SELECT)
+            MMU_HTML_TAG_NAME("small", SMALL)
+            MMU_HTML_TAG_NAME("span", SPAN)
+            MMU_HTML_TAG_NAME("strike", STRIKE)
+            MMU_HTML_TAG_NAME("strong", STRONG)
+            MMU_HTML_TAG_NAME("style", STYLE)
+            MMU_HTML_TAG_NAME("sub", SUB)
+            MMU_HTML_TAG_NAME("sup", SUP)
+            break;
+        case 't':
+            MMU_HTML_TAG_NAME("table", TABLE)
+            MMU_HTML_TAG_NAME("tbody", TBODY)
+            MMU_HTML_TAG_NAME("td", TD)
+            MMU_HTML_TAG_NAME("tfoot", TFOOT)
+            MMU_HTML_TAG_NAME("th", TH)
+            MMU_HTML_TAG_NAME("thead", THEAD)
+            MMU_HTML_TAG_NAME("title", TITLE)
+            MMU_HTML_TAG_NAME("tr", TR)
+            MMU_HTML_TAG_NAME("tt", TT)
+            break;
+        case 'u':
+            MMU_HTML_TAG_NAME("u", U)
+            MMU_HTML_TAG_NAME("ul", UL)
+            break;
+        case 'v':
+            MMU_HTML_TAG_NAME("var", VAR)
+            break;
+    }
+    return MMU_HTML_TAG_UNKNOWN;
+}
+
+#undef MMU_HTML_TAG_NAME
+
+const MMUHtmlTagInfo* MMUHtmlTagGetInfo(MMUHtmlTag tag) {
+    return tagInfo + tag;
+}
+
+int MMUHtmlTagCloses(MMUHtmlTag newTag, MMUHtmlTag openTag) {
+    const MMUHtmlTag* closedBy = tagInfo[openTag].closedBy;
+
+    if (newTag == MMU_HTML_TAG_UNKNOWN || !closedBy) {
+        return 0;
+    }
+    for (; *closedBy != MMU_HTML_TAG_UNKNOWN; ++closedBy) {
+        if (*closedBy == newTag) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef MMU_HTML_TAGS_H_
+#define MMU_HTML_TAGS_H_
+
+#include <stdlib.h>
+
+// Every element name known to the native tokenizer. The order matches
+// the alphabetical order of the names in html-tags.c.
+typedef enum MMUHtmlTag {
+    MMU_HTML_TAG_UNKNOWN = 0
+  , MMU_HTML_TAG_A
+  , MMU_HTML_TAG_ABBR
+  , MMU_HTML_TAG_ADDRESS
+  , MMU_HTML_TAG_AREA
+  , MMU_HTML_TAG_B
+  , MMU_HTML_TAG_BASE
+  , MMU_HTML_TAG_BASEFONT
+  , MMU_HTML_TAG_BIG
+  , MMU_HTML_TAG_BLOCKQUOTE
+  , MMU_HTML_TAG_BODY
+  , MMU_HTML_TAG_BR
+  , MMU_HTML_TAG_CAPTION
+  , MMU_HTML_TAG_CENTER
+  , MMU_HTML_TAG_CITE
+  , MMU_HTML_TAG_CODE
+  , MMU_HTML_TAG_COL
+  , MMU_HTML_TAG_COLGROUP
+  , MMU_HTML_TAG_DD
+  , MMU_HTML_TAG_DEL
+  , MMU_HTML_TAG_DFN
+  , MMU_HTML_TAG_DIR
+  , MMU_HTML_TAG_DIV
+  , MMU_HTML_TAG_DL
+  , MMU_HTML_TAG_DT
+  , MMU_HTML_TAG_EM
+  , MMU_HTML_TAG_FIELDSET
+  , MMU_HTML_TAG_FONT
+  , MMU_HTML_TAG_FORM
+  , MMU_HTML_TAG_FRAME
+  , MMU_HTML_TAG_H1
+  , MMU_HTML_TAG_H2
+  , MMU_HTML_TAG_H3
+  , MMU_HTML_TAG_H4
+  , MMU_HTML_TAG_H5
+  , MMU_HTML_TAG_H6
+  , MMU_HTML_TAG_HEAD
+  , MMU_HTML_TAG_HR
+  , MMU_HTML_TAG_HTML
+  , MMU_HTML_TAG_I
+  , MMU_HTML_TAG_IMG
+  , MMU_HTML_TAG_INPUT
+  , MMU_HTML_TAG_INS
+  , MMU_HTML_TAG_ISINDEX
+  , MMU_HTML_TAG_KBD
+  , MMU_HTML_TAG_LABEL
+  , MMU_HTML_TAG_LEGEND
+  , MMU_HTML_TAG_LI
+  , MMU_HTML_TAG_LINK
+  , MMU_HTML_TAG_MAP
+  , MMU_HTML_TAG_MENU
+  , MMU_HTML_TAG_META
+  , MMU_HTML_TAG_NOSCRIPT
+  , MMU_HTML_TAG_OBJECT
+  , MMU_HTML_TAG_OL
+  , MMU_HTML_TAG_OPTGROUP
+  , MMU_HTML_TAG_OPTION
+  , MMU_HTML_TAG_P
+  , MMU_HTML_TAG_PARAM
+  , MMU_HTML_TAG_PRE
+  , MMU_HTML_TAG_Q
+  , MMU_HTML_TAG_S
+  , MMU_HTML_TAG_SAMP
+  , MMU_HTML_TAG_SCRIPT
+  , MMU_HTML_TAG_SELECT
+  , MMU_HTML_TAG_SMALL
+  , MMU_HTML_TAG_SPAN
+  , MMU_HTML_TAG_STRIKE
+  , MMU_HTML_TAG_STRONG
+  , MMU_HTML_TAG_STYLE
+  , MMU_HTML_TAG_SUB
+  , MMU_HTML_TAG_SUP
+  , MMU_HTML_TAG_TABLE
+  , MMU_HTML_TAG_TBODY
+  , MMU_HTML_TAG_TD
+  , MMU_HTML_TAG_TFOOT
+  , MMU_HTML_TAG_TH
+  , MMU_HTML_TAG_THEAD
+  , MMU_HTML_TAG_TITLE
+  , MMU_HTML_TAG_TR
+  , MMU_HTML_TAG_TT
+  , MMU_HTML_TAG_U
+  , MMU_HTML_TAG_UL
+  , MMU_HTML_TAG_VAR
+  , MMU_HTML_TAG_COUNT
+} MMUHtmlTag;
+
+enum MMUHtmlTagFlags {
+    MMU_HTML_TAG_FLAG_VOID = 1 << 0
+  , MMU_HTML_TAG_FLAG_RAW_TEXT = 1 << 1
+  , MMU_HTML_TAG_FLAG_HEAD = 1 << 2
+};
+
+typedef struct MMUHtmlTagInfo {
+    const char* name;
+    unsigned char flags;
+    // Priority used when an end tag closes the elements above its match,
+    // the same values libxml2 uses
+    unsigned char endPriority;
+    // Start tags which implicitly close this element, terminated by
+    // MMU_HTML_TAG_UNKNOWN
+    const MMUHtmlTag* closedBy;
+} MMUHtmlTagInfo;
+
+// name must already be lower case
+MMUHtmlTag MMUHtmlTagLookup(const char* name, size_t len);
+const MMUHtmlTagInfo* MMUHtmlTagGetInfo(MMUHtmlTag tag);
+
+// Returns non-zero if a start tag newTag implicitly closes an open element
+// openTag, mirroring libxml2's HTML auto-close rules
+int MMUHtmlTagCloses(MMUHtmlTag newTag, MMUHtmlTag openTag);
+
+#endif
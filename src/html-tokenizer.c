@@ -0,0 +1,988 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "html-tokenizer.h"
+
+#include "allocator.h"
+#include "html-entities.h"
+#include "html-parser.h"
+#include "simd.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Where we are in the implied html/head/body structure. libxml2 never puts
+// these elements on our stack, but they decide whether blank text is kept
+// and whether text implies a paragraph.
+enum MMUHtmlDocumentState {
+    MMU_HTML_STATE_PROLOG = 0
+  , MMU_HTML_STATE_HTML
+  , MMU_HTML_STATE_HEAD
+  , MMU_HTML_STATE_BODY
+  , MMU_HTML_STATE_EPILOG
+};
+
+enum MMUHtmlTokenizerDefaults {
+    // Longer names can't be known tags
+    MMUHtmlMaxLookupNameLength = 16
+};
+
+static int isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int isAsciiLetter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static int isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int isHexDigit(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int isNameStart(char c) {
+    return isAsciiLetter(c) || c == '_' || c == ':';
+}
+
+static int isNameChar(char c) {
+    return isNameStart(c) || isDigit(c) || c == '.' || c == '-';
+}
+
+static int isValidChar(unsigned int c) {
+    return c == 0x9 || c == 0xA || c == 0xD
+        || (c >= 0x20 && c <= 0xD7FF)
+        || (c >= 0xE000 && c <= 0xFFFD)
+        || (c >= 0x10000 && c <= 0x10FFFF);
+}
+
+static char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static int equalsIgnoreCase(const char* a, const char* b, size_t len) {
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        if (toLower(a[i]) != toLower(b[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Finds needle in [p, end), returning end if it is absent
+static const char* findString(const char* p, const char* end, const char* needle, size_t needleLen) {
+    while ((size_t)(end - p) >= needleLen) {
+        p = memchr(p, needle[0], (end - p) - needleLen + 1);
+        if (!p) {
+            return end;
+        }
+        if (memcmp(p, needle, needleLen) == 0) {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+void MMUHtmlEventLogInit(MMUHtmlEventLog* log, const MMUOptions* options) {
+    log->options = options;
+    log->events = NULL;
+    log->count = 0;
+    log->capacity = 0;
+    log->strings = NULL;
+    log->stringsLen = 0;
+    log->stringsCapacity = 0;
+}
+
+void MMUHtmlEventLogDestroy(MMUHtmlEventLog* log) {
+    MMUDeallocate(log->options->allocator, log->events);
+    MMUDeallocate(log->options->allocator, log->strings);
+}
+
+static MMUHtmlEvent* addEvent(MMUHtmlEventLog* log, int type) {
+    MMUHtmlEvent* event;
+
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 256;
+        log->events = MMUReallocate(log->options->allocator, log->events,
+                log->capacity * sizeof(MMUHtmlEvent));
+    }
+    event = log->events + log->count++;
+    event->type = type;
+    event->element = 0;
+    event->text = NULL;
+    event->offset = (size_t)MMUHtmlEventNoString;
+    event->len = 0;
+    return event;
+}
+
+static size_t addString(MMUHtmlEventLog* log, const char* text, size_t len) {
+    size_t offset = log->stringsLen;
+
+    if (log->stringsCapacity - log->stringsLen < len + 1) {
+        size_t capacity = log->stringsCapacity ? log->stringsCapacity : 256;
+        while (capacity - log->stringsLen < len + 1) {
+            capacity *= 2;
+        }
+        log->strings = MMUReallocate(log->options->allocator, log->strings, capacity);
+        log->stringsCapacity = capacity;
+    }
+    memcpy(log->strings + offset, text, len);
+    log->strings[offset + len] = '\0';
+    log->stringsLen += len + 1;
+    return offset;
+}
+
+void MMUHtmlEventLogReplay(const MMUHtmlEventLog* log, MMUBuilder* builder) {
+    const MMUHtmlEvent* event = log->events;
+    const MMUHtmlEvent* end = event + log->count;
+
+    for (; event < end; ++event) {
+        switch (event->type) {
+            case MMU_HTML_EVENT_START_ELEMENT:
+                MMUHtmlParserStartElement(builder, event->element,
+                        event->offset == (size_t)MMUHtmlEventNoString ? NULL : log->strings + event->offset);
+                break;
+            case MMU_HTML_EVENT_END_ELEMENT:
+                MMUHtmlParserEndElement(builder, event->element);
+                break;
+            case MMU_HTML_EVENT_TEXT:
+                MMUBuilderAppendText(builder, log->strings + event->offset, event->len);
+                break;
+            case MMU_HTML_EVENT_BORROWED_TEXT:
+                MMUBuilderAppendBorrowedText(builder, event->text, event->len);
+                break;
+        }
+    }
+}
+
+// The builder calls made by the tokenizer, which are either made straight
+// away or recorded
+
+static void emitStartElement(MMUHtmlTokenizer* tokenizer, int element, const char* attribute) {
+    MMUHtmlEvent* event;
+
+    if (tokenizer->builder) {
+        MMUHtmlParserStartElement(tokenizer->builder, element, attribute);
+        return;
+    }
+    event = addEvent(tokenizer->events, MMU_HTML_EVENT_START_ELEMENT);
+    event->element = element;
+    if (attribute) {
+        event->offset = addString(tokenizer->events, attribute, strlen(attribute));
+    }
+}
+
+static void emitEndElement(MMUHtmlTokenizer* tokenizer, int element) {
+    if (tokenizer->builder) {
+        MMUHtmlParserEndElement(tokenizer->builder, element);
+        return;
+    }
+    addEvent(tokenizer->events, MMU_HTML_EVENT_END_ELEMENT)->element = element;
+}
+
+static void emitText(MMUHtmlTokenizer* tokenizer, const char* text, size_t len) {
+    MMUHtmlEventLog* log = tokenizer->events;
+    MMUHtmlEvent* event;
+
+    if (tokenizer->builder) {
+        MMUBuilderAppendText(tokenizer->builder, text, len);
+        return;
+    }
+    // Runs of references are joined into one event, dropping the NUL of
+    // the previous string
+    if (log->count && log->events[log->count - 1].type == MMU_HTML_EVENT_TEXT) {
+        event = log->events + log->count - 1;
+        --log->stringsLen;
+        addString(log, text, len);
+        event->len += len;
+        return;
+    }
+    event = addEvent(log, MMU_HTML_EVENT_TEXT);
+    event->offset = addString(log, text, len);
+    event->len = len;
+}
+
+static void emitBorrowedText(MMUHtmlTokenizer* tokenizer, const char* text, size_t len) {
+    MMUHtmlEvent* event;
+
+    if (tokenizer->builder) {
+        MMUBuilderAppendBorrowedText(tokenizer->builder, text, len);
+        return;
+    }
+    event = addEvent(tokenizer->events, MMU_HTML_EVENT_BORROWED_TEXT);
+    event->text = text;
+    event->len = len;
+}
+
+static void resetTokenizer(MMUHtmlTokenizer* tokenizer) {
+    tokenizer->cur = NULL;
+    tokenizer->end = NULL;
+    tokenizer->documentState = MMU_HTML_STATE_PROLOG;
+    tokenizer->contentSeen = 0;
+    tokenizer->headSeen = 0;
+    tokenizer->bodySeen = 0;
+    tokenizer->depth = 0;
+    tokenizer->maxDepth = MMUHtmlParserMaxDepth(tokenizer->options);
+    tokenizer->scratch = NULL;
+    tokenizer->scratchLen = 0;
+    tokenizer->scratchCapacity = 0;
+    tokenizer->deepest = 0;
+    memset(tokenizer->startTagsAtBase, 0, sizeof(tokenizer->startTagsAtBase));
+    memset(tokenizer->endTagsAtBase, 0, sizeof(tokenizer->endTagsAtBase));
+    tokenizer->baseClosed = 0;
+}
+
+void MMUHtmlTokenizerInit(MMUHtmlTokenizer* tokenizer, MMUBuilder* builder) {
+    tokenizer->builder = builder;
+    tokenizer->events = NULL;
+    tokenizer->options = builder->options;
+    resetTokenizer(tokenizer);
+}
+
+void MMUHtmlTokenizerInitRecording(MMUHtmlTokenizer* tokenizer, const MMUOptions* options,
+        MMUHtmlEventLog* events) {
+    tokenizer->builder = NULL;
+    tokenizer->events = events;
+    tokenizer->options = options;
+    resetTokenizer(tokenizer);
+}
+
+void MMUHtmlTokenizerDestroy(MMUHtmlTokenizer* tokenizer) {
+    MMUDeallocate(tokenizer->options->allocator, tokenizer->scratch);
+}
+
+static void scratchAppend(MMUHtmlTokenizer* tokenizer, const char* text, size_t len) {
+    if (tokenizer->scratchCapacity - tokenizer->scratchLen < len + 1) {
+        size_t capacity = tokenizer->scratchCapacity ? tokenizer->scratchCapacity : 64;
+        while (capacity - tokenizer->scratchLen < len + 1) {
+            capacity *= 2;
+        }
+        tokenizer->scratch = MMUReallocate(tokenizer->options->allocator,
+                tokenizer->scratch, capacity);
+        tokenizer->scratchCapacity = capacity;
+    }
+    memcpy(tokenizer->scratch + tokenizer->scratchLen, text, len);
+    tokenizer->scratchLen += len;
+    tokenizer->scratch[tokenizer->scratchLen] = '\0';
+}
+
+// Text outside of any element (before <html> or after </html>) has no
+// node to attach to in libxml2, so it never reaches the output
+static int hasTextParent(MMUHtmlTokenizer* tokenizer) {
+    return tokenizer->depth > 0
+        || (tokenizer->documentState != MMU_HTML_STATE_PROLOG
+                && tokenizer->documentState != MMU_HTML_STATE_EPILOG);
+}
+
+// Depth of the implied html/head/body elements libxml2 would have open,
+// so that maxDepth counts the same levels as it does in the tree
+static unsigned int impliedDepth(const MMUHtmlTokenizer* tokenizer) {
+    switch (tokenizer->documentState) {
+        case MMU_HTML_STATE_HTML:
+            return 1;
+        case MMU_HTML_STATE_HEAD:
+        case MMU_HTML_STATE_BODY:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Limits are enforced by the builder, so a recording tokenizer has none
+static void countNode(MMUHtmlTokenizer* tokenizer) {
+    if (tokenizer->builder) {
+        MMUBuilderCountNode(tokenizer->builder);
+    }
+}
+
+static int isStopped(const MMUHtmlTokenizer* tokenizer) {
+    return tokenizer->builder && tokenizer->builder->status;
+}
+
+// Called for every element about to be opened
+static int withinMaxDepth(MMUHtmlTokenizer* tokenizer) {
+    if (tokenizer->depth > tokenizer->deepest) {
+        tokenizer->deepest = tokenizer->depth;
+    }
+    if (tokenizer->builder) {
+        MMUBuilderCheckDepth(tokenizer->builder, impliedDepth(tokenizer) + tokenizer->depth + 1);
+    }
+    return impliedDepth(tokenizer) + tokenizer->depth < tokenizer->maxDepth;
+}
+
+static int pushElement(MMUHtmlTokenizer* tokenizer, MMUHtmlTag tag, int element,
+        const char* name, size_t nameLen, const char* attribute) {
+    MMUHtmlOpenElement* open;
+
+    if (tokenizer->depth >= MMUHtmlMaxOpenElements) {
+        // Too deep, the element is dropped but its content is kept
+        return 0;
+    }
+
+    open = tokenizer->stack + tokenizer->depth;
+    open->tag = tag;
+    open->element = element;
+    open->name = name;
+    open->nameLen = nameLen;
+    open->dispatched = withinMaxDepth(tokenizer);
+    ++tokenizer->depth;
+    if (open->dispatched) {
+        emitStartElement(tokenizer, element, attribute);
+    }
+    return 1;
+}
+
+static void popElement(MMUHtmlTokenizer* tokenizer) {
+    const MMUHtmlOpenElement* open = tokenizer->stack + --tokenizer->depth;
+    if (open->dispatched) {
+        emitEndElement(tokenizer, open->element);
+    }
+}
+
+static void markTag(unsigned char* tags, MMUHtmlTag tag) {
+    tags[tag / 8] |= (unsigned char)(1 << (tag % 8));
+}
+
+static int isTagMarked(const unsigned char* tags, MMUHtmlTag tag) {
+    return (tags[tag / 8] >> (tag % 8)) & 1;
+}
+
+static void popAllElements(MMUHtmlTokenizer* tokenizer) {
+    tokenizer->baseClosed = 1;
+    while (tokenizer->depth > 0) {
+        popElement(tokenizer);
+    }
+}
+
+// Called before non-blank text. Like libxml2, text which would otherwise
+// end up directly in <html> or <head> (or outside the document) is wrapped
+// in an implied paragraph.
+static void checkParagraph(MMUHtmlTokenizer* tokenizer) {
+    if (tokenizer->depth > 0 || tokenizer->documentState == MMU_HTML_STATE_BODY) {
+        return;
+    }
+
+    if (!tokenizer->bodySeen) {
+        tokenizer->documentState = MMU_HTML_STATE_BODY;
+        tokenizer->bodySeen = 1;
+    } else {
+        tokenizer->documentState = MMU_HTML_STATE_HTML;
+    }
+    pushElement(tokenizer, MMU_HTML_TAG_P,
+            MMUHtmlParserResolveElement(tokenizer->options, MMU_HTML_TAG_P, "p", 1),
+            "p", 1, NULL);
+}
+
+// Handles a run of character data without any references or markup
+static void processCharData(MMUHtmlTokenizer* tokenizer, const char* text, const char* end) {
+    // Blanks before a reference count as content, just as in libxml2
+    if (MMUSkipBlanks(text, end) == end && (end == tokenizer->end || *end == '<')) {
+        if (!hasTextParent(tokenizer)) {
+            return;
+        }
+    } else {
+        checkParagraph(tokenizer);
+    }
+    emitBorrowedText(tokenizer, text, end - text);
+}
+
+// Decodes the reference at tokenizer->cur (which points at '&') into out,
+// returning the number of bytes written. Unknown references are copied
+// through unchanged, invalid numeric references produce nothing.
+static size_t decodeReference(const char** cursor, const char* end, char* out) {
+    const char* p = *cursor + 1;
+
+    if (p < end && *p == '#') {
+        unsigned int value = 0;
+        int valid = 1;
+
+        ++p;
+        if (p < end && (*p == 'x' || *p == 'X')) {
+            for (++p; p < end && isHexDigit(*p); ++p) {
+                unsigned int digit = isDigit(*p) ? *p - '0' : toLower(*p) - 'a' + 10;
+                value = value * 16 + digit;
+                if (value > 0x10FFFF) {
+                    valid = 0;
+                    value = 0x110000;
+                }
+            }
+        } else {
+            for (; p < end && isDigit(*p); ++p) {
+                value = value * 10 + (*p - '0');
+                if (value > 0x10FFFF) {
+                    valid = 0;
+                    value = 0x110000;
+                }
+            }
+        }
+        if (p < end && *p == ';') {
+            ++p;
+        }
+        *cursor = p;
+
+        if (!valid || !isValidChar(value)) {
+            return 0;
+        }
+        return MMUEncodeUtf8(value, out);
+    }
+
+    if (p < end && isNameStart(*p)) {
+        const char* name = p;
+        unsigned int codePoint;
+
+        while (p < end && isNameChar(*p)) {
+            ++p;
+        }
+        if (p < end && *p == ';'
+                && (codePoint = MMUHtmlEntityLookup(name, p - name)) != 0) {
+            *cursor = p + 1;
+            return MMUEncodeUtf8(codePoint, out);
+        }
+    }
+
+    // Not a reference, only the '&' is consumed
+    *cursor = *cursor + 1;
+    out[0] = '&';
+    return 1;
+}
+
+static void processReference(MMUHtmlTokenizer* tokenizer) {
+    char decoded[4];
+    size_t len = decodeReference(&tokenizer->cur, tokenizer->end, decoded);
+
+    if (len > 0) {
+        checkParagraph(tokenizer);
+        emitText(tokenizer, decoded, len);
+    }
+}
+
+static void processText(MMUHtmlTokenizer* tokenizer) {
+    const char* start = tokenizer->cur;
+    const char* p = MMUFindAny2(start, tokenizer->end, '<', '&');
+
+    MMU_STATS_ADD(tokenizer->options, nodesVisited, 1);
+    countNode(tokenizer);
+    if (p > start) {
+        processCharData(tokenizer, start, p);
+    }
+    tokenizer->cur = p;
+}
+
+// Appends an attribute value to the scratch buffer, decoding references
+static void decodeAttributeValue(MMUHtmlTokenizer* tokenizer, const char* value, const char* end) {
+    tokenizer->scratchLen = 0;
+    scratchAppend(tokenizer, "", 0);
+
+    while (value < end) {
+        const char* ampersand = memchr(value, '&', end - value);
+        char decoded[4];
+        size_t len;
+
+        if (!ampersand) {
+            scratchAppend(tokenizer, value, end - value);
+            break;
+        }
+        if (ampersand > value) {
+            scratchAppend(tokenizer, value, ampersand - value);
+        }
+        value = ampersand;
+        len = decodeReference(&value, end, decoded);
+        scratchAppend(tokenizer, decoded, len);
+    }
+}
+
+static void skipBlanks(MMUHtmlTokenizer* tokenizer) {
+    tokenizer->cur = MMUSkipBlanks(tokenizer->cur, tokenizer->end);
+}
+
+// Parses the attributes of a start tag up to and including the closing
+// '>'. Returns whether the tag was self-closing, and stores the decoded
+// value of the wanted attribute, if any, in the scratch buffer.
+static int parseAttributes(MMUHtmlTokenizer* tokenizer, const char* wanted, int* hasWanted) {
+    const char* end = tokenizer->end;
+    size_t wantedLen = wanted ? strlen(wanted) : 0;
+
+    *hasWanted = 0;
+    for (;;) {
+        const char* name;
+        const char* nameEnd;
+        const char* value = NULL;
+        const char* valueEnd = NULL;
+
+        skipBlanks(tokenizer);
+        if (tokenizer->cur >= end) {
+            return 0;
+        }
+        if (*tokenizer->cur == '>') {
+            ++tokenizer->cur;
+            return 0;
+        }
+        if (*tokenizer->cur == '/') {
+            ++tokenizer->cur;
+            if (tokenizer->cur < end && *tokenizer->cur == '>') {
+                ++tokenizer->cur;
+                return 1;
+            }
+            continue;
+        }
+
+        name = tokenizer->cur;
+        while (tokenizer->cur < end && !isBlank(*tokenizer->cur)
+                && *tokenizer->cur != '=' && *tokenizer->cur != '>' && *tokenizer->cur != '/') {
+            ++tokenizer->cur;
+        }
+        nameEnd = tokenizer->cur;
+        if (name == nameEnd) {
+            // Can only be a stray '='
+            ++tokenizer->cur;
+            continue;
+        }
+
+        skipBlanks(tokenizer);
+        if (tokenizer->cur < end && *tokenizer->cur == '=') {
+            ++tokenizer->cur;
+            skipBlanks(tokenizer);
+            if (tokenizer->cur < end && (*tokenizer->cur == '"' || *tokenizer->cur == '\'')) {
+                const char* close;
+                value = tokenizer->cur + 1;
+                close = memchr(value, *tokenizer->cur, end - value);
+                valueEnd = close ? close : end;
+                tokenizer->cur = close ? close + 1 : end;
+            } else {
+                value = tokenizer->cur;
+                while (tokenizer->cur < end && !isBlank(*tokenizer->cur) && *tokenizer->cur != '>') {
+                    ++tokenizer->cur;
+                }
+                valueEnd = tokenizer->cur;
+            }
+        }
+
+        // The first one wins, later duplicates are dropped like libxml2 does
+        if (wanted && !*hasWanted && (size_t)(nameEnd - name) == wantedLen
+                && equalsIgnoreCase(name, wanted, wantedLen)) {
+            *hasWanted = 1;
+            decodeAttributeValue(tokenizer, value ? value : "", value ? valueEnd : "");
+        }
+    }
+}
+
+static void processStartTag(MMUHtmlTokenizer* tokenizer) {
+    const char* name = tokenizer->cur + 1;
+    const char* nameEnd = name;
+    char lowerName[MMUHtmlMaxLookupNameLength];
+    MMUHtmlTag tag = MMU_HTML_TAG_UNKNOWN;
+    const MMUHtmlTagInfo* info;
+    int element;
+    int selfClosing;
+    int hasAttribute;
+
+    while (nameEnd < tokenizer->end && isNameChar(*nameEnd)) {
+        ++nameEnd;
+    }
+    if ((size_t)(nameEnd - name) < sizeof(lowerName)) {
+        size_t i;
+        for (i = 0; i < (size_t)(nameEnd - name); ++i) {
+            lowerName[i] = toLower(name[i]);
+        }
+        tag = MMUHtmlTagLookup(lowerName, nameEnd - name);
+    }
+    info = MMUHtmlTagGetInfo(tag);
+    element = MMUHtmlParserResolveElement(tokenizer->options, tag, name, nameEnd - name);
+
+    MMU_STATS_ADD(tokenizer->options, nodesVisited, 1);
+    countNode(tokenizer);
+    tokenizer->cur = nameEnd;
+    selfClosing = parseAttributes(tokenizer,
+            MMUHtmlParserAttribute(tokenizer->options, element), &hasAttribute);
+
+    switch (tag) {
+        case MMU_HTML_TAG_HTML:
+            if (tokenizer->documentState == MMU_HTML_STATE_PROLOG
+                    || tokenizer->documentState == MMU_HTML_STATE_EPILOG) {
+                tokenizer->documentState = MMU_HTML_STATE_HTML;
+            }
+            return;
+        case MMU_HTML_TAG_HEAD:
+            if (!tokenizer->headSeen && !tokenizer->bodySeen
+                    && (tokenizer->documentState == MMU_HTML_STATE_PROLOG
+                        || tokenizer->documentState == MMU_HTML_STATE_HTML)) {
+                tokenizer->documentState = MMU_HTML_STATE_HEAD;
+                tokenizer->headSeen = 1;
+            }
+            return;
+        case MMU_HTML_TAG_BODY:
+            if (!tokenizer->bodySeen) {
+                tokenizer->documentState = MMU_HTML_STATE_BODY;
+                tokenizer->bodySeen = 1;
+            }
+            return;
+        default:
+            break;
+    }
+
+    // Work out which of the implied html/head/body elements this belongs to
+    if (tokenizer->documentState == MMU_HTML_STATE_EPILOG) {
+        tokenizer->documentState = MMU_HTML_STATE_HTML;
+    } else if (!tokenizer->bodySeen && tokenizer->documentState != MMU_HTML_STATE_BODY) {
+        if (info->flags & MMU_HTML_TAG_FLAG_HEAD) {
+            if (!tokenizer->headSeen) {
+                tokenizer->documentState = MMU_HTML_STATE_HEAD;
+                tokenizer->headSeen = 1;
+            }
+        } else if (tokenizer->depth == 0) {
+            tokenizer->documentState = MMU_HTML_STATE_BODY;
+            tokenizer->bodySeen = 1;
+        }
+    }
+
+    while (tokenizer->depth > 0
+            && MMUHtmlTagCloses(tag, tokenizer->stack[tokenizer->depth - 1].tag)) {
+        popElement(tokenizer);
+    }
+    if (tokenizer->depth == 0) {
+        markTag(tokenizer->startTagsAtBase, tag);
+    }
+
+    if (info->flags & MMU_HTML_TAG_FLAG_VOID) {
+        if (withinMaxDepth(tokenizer)) {
+            emitStartElement(tokenizer, element, NULL);
+            emitEndElement(tokenizer, element);
+        }
+        return;
+    }
+
+    if (!pushElement(tokenizer, tag, element, name, nameEnd - name,
+                hasAttribute ? tokenizer->scratch : "")) {
+        return;
+    }
+
+    if (selfClosing) {
+        popElement(tokenizer);
+    }
+}
+
+static int elementMatches(const MMUHtmlOpenElement* element, MMUHtmlTag tag,
+        const char* name, size_t nameLen) {
+    if (element->tag != tag) {
+        return 0;
+    }
+    return tag != MMU_HTML_TAG_UNKNOWN
+        || (element->nameLen == nameLen && equalsIgnoreCase(element->name, name, nameLen));
+}
+
+static void processEndTag(MMUHtmlTokenizer* tokenizer) {
+    const char* name = tokenizer->cur + 2;
+    const char* nameEnd = name;
+    char lowerName[MMUHtmlMaxLookupNameLength];
+    MMUHtmlTag tag = MMU_HTML_TAG_UNKNOWN;
+    unsigned int priority;
+    unsigned int i;
+    const char* close;
+
+    while (nameEnd < tokenizer->end && isNameChar(*nameEnd)) {
+        ++nameEnd;
+    }
+    if ((size_t)(nameEnd - name) < sizeof(lowerName)) {
+        size_t j;
+        for (j = 0; j < (size_t)(nameEnd - name); ++j) {
+            lowerName[j] = toLower(name[j]);
+        }
+        tag = MMUHtmlTagLookup(lowerName, nameEnd - name);
+    }
+
+    close = memchr(nameEnd, '>', tokenizer->end - nameEnd);
+    tokenizer->cur = close ? close + 1 : tokenizer->end;
+
+    switch (tag) {
+        case MMU_HTML_TAG_HTML:
+            popAllElements(tokenizer);
+            tokenizer->documentState = MMU_HTML_STATE_EPILOG;
+            return;
+        case MMU_HTML_TAG_BODY:
+            if (tokenizer->documentState == MMU_HTML_STATE_BODY) {
+                popAllElements(tokenizer);
+                tokenizer->documentState = MMU_HTML_STATE_HTML;
+            }
+            return;
+        case MMU_HTML_TAG_HEAD:
+            if (tokenizer->documentState == MMU_HTML_STATE_HEAD) {
+                popAllElements(tokenizer);
+                tokenizer->documentState = MMU_HTML_STATE_HTML;
+            }
+            return;
+        default:
+            break;
+    }
+
+    // Close everything above the matching element, unless something more
+    // important than the element being closed is in the way
+    priority = MMUHtmlTagGetInfo(tag)->endPriority;
+    for (i = tokenizer->depth; i > 0; --i) {
+        const MMUHtmlOpenElement* element = tokenizer->stack + i - 1;
+        if (elementMatches(element, tag, name, nameEnd - name)) {
+            break;
+        }
+        if (MMUHtmlTagGetInfo(element->tag)->endPriority > priority) {
+            return;
+        }
+    }
+    if (i == 0) {
+        markTag(tokenizer->endTagsAtBase, tag);
+        return;
+    }
+    while (tokenizer->depth >= i) {
+        popElement(tokenizer);
+    }
+}
+
+static int inRawText(MMUHtmlTokenizer* tokenizer) {
+    return tokenizer->depth > 0
+        && (MMUHtmlTagGetInfo(tokenizer->stack[tokenizer->depth - 1].tag)->flags & MMU_HTML_TAG_FLAG_RAW_TEXT);
+}
+
+// Script and style content is dropped. As in libxml2 it runs up to the next
+// end tag, and carries on if that end tag doesn't close the element.
+static void skipRawText(MMUHtmlTokenizer* tokenizer) {
+    const char* p = tokenizer->cur;
+
+    for (;;) {
+        p = findString(p, tokenizer->end, "</", 2);
+        if (p == tokenizer->end || (p + 2 < tokenizer->end && isAsciiLetter(p[2]))) {
+            break;
+        }
+        p += 2;
+    }
+
+    tokenizer->cur = p;
+    if (p < tokenizer->end) {
+        processEndTag(tokenizer);
+    }
+}
+
+static int isPrologMarkup(const char* p, const char* end) {
+    size_t remaining = end - p;
+    return remaining >= 2 && p[0] == '<' && (p[1] == '!' || p[1] == '?');
+}
+
+static void processMarkup(MMUHtmlTokenizer* tokenizer) {
+    const char* p = tokenizer->cur;
+    const char* end = tokenizer->end;
+    size_t remaining = end - p;
+
+    if (remaining >= 2 && isAsciiLetter(p[1])) {
+        processStartTag(tokenizer);
+    } else if (remaining >= 2 && p[1] == '/') {
+        if (remaining >= 3 && isAsciiLetter(p[2])) {
+            processEndTag(tokenizer);
+        } else {
+            // libxml2 drops a stray "</" and carries on with the text
+            tokenizer->cur = p + 2;
+        }
+    } else if (remaining >= 4 && memcmp(p, "<!--", 4) == 0) {
+        const char* close = findString(p + 4, end, "-->", 3);
+        tokenizer->cur = close == end ? end : close + 3;
+    } else if (remaining >= 9 && p[1] == '!' && equalsIgnoreCase(p + 2, "doctype", 7)) {
+        const char* close = memchr(p, '>', remaining);
+        tokenizer->cur = close ? close + 1 : end;
+    } else if (remaining >= 2 && p[1] == '?') {
+        const char* close = memchr(p, '>', remaining);
+        tokenizer->cur = close ? close + 1 : end;
+    } else {
+        // A literal '<'
+        if (hasTextParent(tokenizer)) {
+            emitText(tokenizer, "<", 1);
+        }
+        tokenizer->cur = p + 1;
+    }
+}
+
+void MMUHtmlTokenizerParse(MMUHtmlTokenizer* tokenizer, const char* html, size_t len) {
+    MMUHtmlTokenizerStart(tokenizer, html, len);
+    MMUHtmlTokenizerParseUntil(tokenizer, tokenizer->end);
+    MMUHtmlTokenizerFinish(tokenizer);
+}
+
+void MMUHtmlTokenizerStart(MMUHtmlTokenizer* tokenizer, const char* html, size_t len) {
+    tokenizer->cur = html;
+    tokenizer->end = html + len;
+}
+
+void MMUHtmlTokenizerParseUntil(MMUHtmlTokenizer* tokenizer, const char* stop) {
+    // Once the builder stops, the rest of the input is left alone
+    while (tokenizer->cur < stop && !isStopped(tokenizer)) {
+        if (!tokenizer->contentSeen) {
+            // Blanks are skipped around the doctype and any comments or
+            // processing instructions before the content starts
+            skipBlanks(tokenizer);
+            if (tokenizer->cur >= tokenizer->end) {
+                break;
+            }
+            tokenizer->contentSeen = !isPrologMarkup(tokenizer->cur, tokenizer->end);
+        }
+
+        if (inRawText(tokenizer)) {
+            skipRawText(tokenizer);
+            continue;
+        }
+
+        switch (*tokenizer->cur) {
+            case '<':
+                processMarkup(tokenizer);
+                break;
+            case '&':
+                processReference(tokenizer);
+                break;
+            default:
+                processText(tokenizer);
+                break;
+        }
+    }
+}
+
+void MMUHtmlTokenizerFinish(MMUHtmlTokenizer* tokenizer) {
+    popAllElements(tokenizer);
+}
+
+static int isBlockTag(MMUHtmlTag tag, int listItems) {
+    switch (tag) {
+        case MMU_HTML_TAG_ADDRESS:
+        case MMU_HTML_TAG_BLOCKQUOTE:
+        case MMU_HTML_TAG_CENTER:
+        case MMU_HTML_TAG_DIV:
+        case MMU_HTML_TAG_DL:
+        case MMU_HTML_TAG_FORM:
+        case MMU_HTML_TAG_H1:
+        case MMU_HTML_TAG_H2:
+        case MMU_HTML_TAG_H3:
+        case MMU_HTML_TAG_H4:
+        case MMU_HTML_TAG_H5:
+        case MMU_HTML_TAG_H6:
+        case MMU_HTML_TAG_HR:
+        case MMU_HTML_TAG_OL:
+        case MMU_HTML_TAG_P:
+        case MMU_HTML_TAG_PRE:
+        case MMU_HTML_TAG_TABLE:
+        case MMU_HTML_TAG_UL:
+            return 1;
+        case MMU_HTML_TAG_LI:
+            return listItems;
+        default:
+            return 0;
+    }
+}
+
+const char* MMUHtmlFindBlockStart(const char* p, const char* end, int listItems) {
+    while ((p = memchr(p, '<', end - p)) != NULL) {
+        char name[8];
+        size_t len = 0;
+        const char* q = p + 1;
+
+        while (q < end && len < sizeof(name)
+                && ((*q >= 'a' && *q <= 'z') || (*q >= 'A' && *q <= 'Z') || (*q >= '1' && *q <= '6'))) {
+            name[len++] = (*q >= 'A' && *q <= 'Z') ? (char)(*q - 'A' + 'a') : *q;
+            ++q;
+        }
+        if (len > 0 && len < sizeof(name) && q < end
+                && (*q == '>' || *q == '/' || *q == ' ' || *q == '\t' || *q == '\n' || *q == '\r')
+                && isBlockTag(MMUHtmlTagLookup(name, len), listItems)) {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+void MMUHtmlTokenizerSpeculate(MMUHtmlTokenizer* tokenizer, const char* start) {
+    tokenizer->cur = start;
+    tokenizer->documentState = MMU_HTML_STATE_BODY;
+    tokenizer->contentSeen = 1;
+    tokenizer->bodySeen = 1;
+}
+
+// Whether an end tag which found nothing to close on a speculative stack
+// would have closed one of the elements below it
+static int endTagClosesBase(const MMUHtmlTokenizer* tokenizer, MMUHtmlTag tag) {
+    unsigned int priority = MMUHtmlTagGetInfo(tag)->endPriority;
+    unsigned int i;
+
+    for (i = tokenizer->depth; i > 0; --i) {
+        const MMUHtmlOpenElement* element = tokenizer->stack + i - 1;
+        // Unknown elements would need their names compared, assume the worst
+        if (element->tag == tag) {
+            return 1;
+        }
+        if (MMUHtmlTagGetInfo(element->tag)->endPriority > priority) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int MMUHtmlTokenizerCanContinue(const MMUHtmlTokenizer* tokenizer, const MMUHtmlTokenizer* chunk,
+        const char* start) {
+    const MMUHtmlOpenElement* top;
+    unsigned int tag;
+
+    if (tokenizer->cur != start
+            || tokenizer->documentState != MMU_HTML_STATE_BODY
+            || !tokenizer->contentSeen || !tokenizer->bodySeen) {
+        return 0;
+    }
+    if (tokenizer->depth == 0) {
+        // Exactly the state chunk assumed
+        return 1;
+    }
+
+    top = tokenizer->stack + tokenizer->depth - 1;
+    if (chunk->baseClosed
+            || (MMUHtmlTagGetInfo(top->tag)->flags & MMU_HTML_TAG_FLAG_RAW_TEXT)
+            || impliedDepth(tokenizer) + tokenizer->depth + chunk->deepest
+                >= tokenizer->maxDepth) {
+        return 0;
+    }
+    for (tag = 0; tag < MMU_HTML_TAG_COUNT; ++tag) {
+        if (isTagMarked(chunk->startTagsAtBase, (MMUHtmlTag)tag)
+                && MMUHtmlTagCloses((MMUHtmlTag)tag, top->tag)) {
+            return 0;
+        }
+        if (isTagMarked(chunk->endTagsAtBase, (MMUHtmlTag)tag)
+                && endTagClosesBase(tokenizer, (MMUHtmlTag)tag)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void MMUHtmlTokenizerContinue(MMUHtmlTokenizer* tokenizer, const MMUHtmlTokenizer* chunk) {
+    memcpy(tokenizer->stack + tokenizer->depth, chunk->stack, chunk->depth * sizeof(MMUHtmlOpenElement));
+    tokenizer->depth += chunk->depth;
+    tokenizer->cur = chunk->cur;
+    tokenizer->documentState = chunk->documentState;
+    tokenizer->contentSeen |= chunk->contentSeen;
+    tokenizer->headSeen |= chunk->headSeen;
+    tokenizer->bodySeen |= chunk->bodySeen;
+}
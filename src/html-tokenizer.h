@@ -0,0 +1,156 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef MMU_HTML_TOKENIZER_H_
+#define MMU_HTML_TOKENIZER_H_
+
+#include "builder.h"
+#include "html-tags.h"
+
+// A dependency-free parser for the subset of html markmeup understands. It
+// drives the builder directly while scanning the input and emulates the
+// parts of libxml2's error recovery (implied elements, auto-closing and
+// end tag priorities) which affect the output, so that both back-ends
+// produce the same result.
+
+enum {
+    // libxml2 refuses to nest deeper than this, so neither do we
+    MMUHtmlMaxOpenElements = 256
+};
+
+typedef struct MMUHtmlOpenElement {
+    MMUHtmlTag tag;
+    // What the element does, see MMUHtmlParserResolveElement
+    int element;
+    // Points into the input, used to match end tags of unknown elements
+    const char* name;
+    size_t nameLen;
+    // Whether the builder saw the element, i.e. it was within maxDepth
+    char dispatched;
+} MMUHtmlOpenElement;
+
+// Builder calls recorded by a speculative tokenizer, to be replayed once
+// it is known that they are what a sequential parse would have made
+enum MMUHtmlEventType {
+    MMU_HTML_EVENT_START_ELEMENT = 0
+  , MMU_HTML_EVENT_END_ELEMENT
+  , MMU_HTML_EVENT_TEXT
+  , MMU_HTML_EVENT_BORROWED_TEXT
+};
+
+enum {
+    // MMUHtmlEvent.offset of a start element without an attribute
+    MMUHtmlEventNoString = -1
+};
+
+typedef struct MMUHtmlEvent {
+    int type;
+    int element;
+    // Borrowed text points into the input, everything else (decoded text
+    // and attributes) is copied into the log's strings
+    const char* text;
+    size_t offset;
+    size_t len;
+} MMUHtmlEvent;
+
+typedef struct MMUHtmlEventLog {
+    const MMUOptions* options;
+    MMUHtmlEvent* events;
+    size_t count;
+    size_t capacity;
+    char* strings;
+    size_t stringsLen;
+    size_t stringsCapacity;
+} MMUHtmlEventLog;
+
+void MMUHtmlEventLogInit(MMUHtmlEventLog* log, const MMUOptions* options);
+void MMUHtmlEventLogDestroy(MMUHtmlEventLog* log);
+void MMUHtmlEventLogReplay(const MMUHtmlEventLog* log, MMUBuilder* builder);
+
+typedef struct MMUHtmlTokenizer {
+    // NULL when recording into events instead
+    MMUBuilder* builder;
+    MMUHtmlEventLog* events;
+    const MMUOptions* options;
+
+    const char* cur;
+    const char* end;
+
+    int documentState;
+    char contentSeen;
+    char headSeen;
+    char bodySeen;
+
+    // Elements beyond maxDepth are still tracked so that end tags and
+    // auto-closing match libxml2's tree, they are just not dispatched
+    MMUHtmlOpenElement stack[MMUHtmlMaxOpenElements];
+    unsigned int depth;
+    unsigned int maxDepth;
+
+    // Decoded attribute values
+    char* scratch;
+    size_t scratchLen;
+    size_t scratchCapacity;
+
+    // Deepest level at which maxDepth was checked
+    unsigned int deepest;
+    // A speculative tokenizer starts at a block boundary assuming that
+    // nothing is open, but whatever really is open below it could have
+    // changed the parse. These note every question which would have been
+    // asked of those elements: start and end tags (MMUHtmlTag bit sets)
+    // which reached the bottom of the stack, and whether it was emptied.
+    unsigned char startTagsAtBase[(MMU_HTML_TAG_COUNT + 7) / 8];
+    unsigned char endTagsAtBase[(MMU_HTML_TAG_COUNT + 7) / 8];
+    char baseClosed;
+} MMUHtmlTokenizer;
+
+void MMUHtmlTokenizerInit(MMUHtmlTokenizer* tokenizer, MMUBuilder* builder);
+void MMUHtmlTokenizerDestroy(MMUHtmlTokenizer* tokenizer);
+
+// Parses a whole document. The caller is responsible for finishing the
+// builder afterwards.
+void MMUHtmlTokenizerParse(MMUHtmlTokenizer* tokenizer, const char* html, size_t len);
+
+// Piecewise parsing, used to parse the blocks of a document in parallel.
+// MMUHtmlTokenizerParseUntil stops at the first token starting at or after
+// stop, MMUHtmlTokenizerFinish closes whatever is still open.
+void MMUHtmlTokenizerInitRecording(MMUHtmlTokenizer* tokenizer, const MMUOptions* options,
+        MMUHtmlEventLog* events);
+void MMUHtmlTokenizerStart(MMUHtmlTokenizer* tokenizer, const char* html, size_t len);
+void MMUHtmlTokenizerParseUntil(MMUHtmlTokenizer* tokenizer, const char* stop);
+void MMUHtmlTokenizerFinish(MMUHtmlTokenizer* tokenizer);
+
+// Finds the first block level start tag in [p, end) (with listItems also
+// <li>), returning end if there is none. Only the tag itself is looked at,
+// whether it really starts a block is up to the parse to find out.
+const char* MMUHtmlFindBlockStart(const char* p, const char* end, int listItems);
+
+// Puts a recording tokenizer at start, inside the body with an empty stack
+void MMUHtmlTokenizerSpeculate(MMUHtmlTokenizer* tokenizer, const char* start);
+// Whether a tokenizer which has parsed everything before start would have
+// made the same calls as the speculative tokenizer chunk, which started
+// there. If so, MMUHtmlTokenizerContinue takes over the state chunk ended in.
+int MMUHtmlTokenizerCanContinue(const MMUHtmlTokenizer* tokenizer, const MMUHtmlTokenizer* chunk,
+        const char* start);
+void MMUHtmlTokenizerContinue(MMUHtmlTokenizer* tokenizer, const MMUHtmlTokenizer* chunk);
+
+#endif
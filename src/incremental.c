@@ -0,0 +1,473 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "markmeup.h"
+
+#include "allocator.h"
+#include "builder.h"
+#include "html-parser.h"
+#include "html-tokenizer.h"
+
+#include <string.h>
+
+// The input is cut into blocks in front of block level and list item start
+// tags, wherever the tokenizer lands exactly on one with no link or list
+// item open. The builder is flushed at every cut, so the output of a block
+// only depends on its input and the state it starts in, and an edit can be
+// parsed again from the last block in front of it until the parse reaches
+// a block behind it in the state it had before.
+//
+// The blocks are kept in a gap buffer with the gap where the last edit
+// was. Blocks in front of the gap store their offsets from the start of
+// the input and output, blocks behind it from the end, so the blocks
+// behind an edit never need updating and only moving the gap to another
+// part of the document costs anything.
+
+enum {
+    MMUIncrementalInitialBlocks = 64
+};
+
+typedef struct MMUIncrementalElement {
+    MMUHtmlTag tag;
+    int element;
+    // Unknown elements only, copied into the state since the input it
+    // pointed into doesn't outlive the call
+    const char* name;
+    size_t nameLen;
+    char dispatched;
+} MMUIncrementalElement;
+
+// The tokenizer and builder state a block starts in. No text is pending
+// and no link or list item is open, everything else is here.
+typedef struct MMUIncrementalState {
+    int documentState;
+    char contentSeen;
+    char headSeen;
+    char bodySeen;
+    char inParagraph;
+    MMUBlankState blankState;
+    unsigned int preformattedDepth;
+    unsigned int depth;
+    unsigned int contextLevel;
+    int listDepth;
+    // Allocated along with the state, followed by the names
+    MMUIncrementalElement* elements;
+    MMUListState* lists;
+    MMUContext* contexts;
+} MMUIncrementalState;
+
+typedef struct MMUIncrementalBlock {
+    // Where the block starts, counted from the end behind the gap
+    size_t inputOffset;
+    size_t outputOffset;
+    MMUIncrementalState* state;
+} MMUIncrementalBlock;
+
+struct MMUIncrementalParser {
+    MMUOptions options;
+    // Whether the input can be indexed at all
+    int indexable;
+    MMUHtmlParser parser[1];
+    MMUHtmlTokenizer tokenizer[1];
+
+    MMUIncrementalBlock* blocks;
+    size_t capacity;
+    // blocks[gapStart, gapEnd) is unused
+    size_t gapStart;
+    size_t gapEnd;
+    // Whether the blocks describe the previous input
+    int indexed;
+    size_t inputLen;
+    size_t outputLen;
+};
+
+static MMUIncrementalState* MMUIncrementalCapture(MMUIncrementalParser* parser) {
+    const MMUHtmlTokenizer* tokenizer = parser->tokenizer;
+    MMUBuilder* builder = parser->parser->builder;
+    unsigned int level = builder->contextStack->level;
+    MMUIncrementalState* state;
+    size_t namesLen = 0;
+    char* names;
+    unsigned int i;
+
+    for (i = 0; i < tokenizer->depth; ++i) {
+        if (tokenizer->stack[i].tag == MMU_HTML_TAG_UNKNOWN) {
+            namesLen += tokenizer->stack[i].nameLen;
+        }
+    }
+    state = MMUAllocate(parser->options.allocator, sizeof(MMUIncrementalState)
+            + tokenizer->depth * sizeof(MMUIncrementalElement)
+            + builder->listDepth * sizeof(MMUListState)
+            + (level + 1) * sizeof(MMUContext) + namesLen);
+    state->documentState = tokenizer->documentState;
+    state->contentSeen = tokenizer->contentSeen;
+    state->headSeen = tokenizer->headSeen;
+    state->bodySeen = tokenizer->bodySeen;
+    state->inParagraph = builder->inParagraph;
+    state->blankState = builder->blankState;
+    state->preformattedDepth = builder->preformattedDepth;
+    state->depth = tokenizer->depth;
+    state->contextLevel = level;
+    state->listDepth = builder->listDepth;
+    state->elements = (MMUIncrementalElement*)(state + 1);
+    state->lists = (MMUListState*)(state->elements + tokenizer->depth);
+    state->contexts = (MMUContext*)(state->lists + builder->listDepth);
+    names = (char*)(state->contexts + level + 1);
+
+    for (i = 0; i < tokenizer->depth; ++i) {
+        const MMUHtmlOpenElement* open = tokenizer->stack + i;
+        MMUIncrementalElement* element = state->elements + i;
+
+        element->tag = open->tag;
+        element->element = open->element;
+        element->name = NULL;
+        element->nameLen = 0;
+        element->dispatched = open->dispatched;
+        if (open->tag == MMU_HTML_TAG_UNKNOWN) {
+            memcpy(names, open->name, open->nameLen);
+            element->name = names;
+            element->nameLen = open->nameLen;
+            names += open->nameLen;
+        }
+    }
+    memcpy(state->lists, MMUBuilderLists(builder), builder->listDepth * sizeof(MMUListState));
+    memcpy(state->contexts, MMUBuilderContexts(builder), (level + 1) * sizeof(MMUContext));
+    return state;
+}
+
+static void MMUIncrementalRestore(MMUIncrementalParser* parser, const MMUIncrementalState* state) {
+    MMUHtmlTokenizer* tokenizer = parser->tokenizer;
+    MMUBuilder* builder = parser->parser->builder;
+    unsigned int i;
+
+    tokenizer->documentState = state->documentState;
+    tokenizer->contentSeen = state->contentSeen;
+    tokenizer->headSeen = state->headSeen;
+    tokenizer->bodySeen = state->bodySeen;
+    tokenizer->depth = state->depth;
+    for (i = 0; i < state->depth; ++i) {
+        const MMUIncrementalElement* element = state->elements + i;
+        MMUHtmlOpenElement* open = tokenizer->stack + i;
+
+        open->tag = element->tag;
+        open->element = element->element;
+        open->name = element->name;
+        open->nameLen = element->nameLen;
+        open->dispatched = element->dispatched;
+    }
+
+    builder->inParagraph = state->inParagraph;
+    builder->blankState = state->blankState;
+    builder->preformattedDepth = state->preformattedDepth;
+    MMUBuilderReserveStacks(builder, state->contextLevel, state->listDepth);
+    builder->listDepth = state->listDepth;
+    memcpy(MMUBuilderLists(builder), state->lists, state->listDepth * sizeof(MMUListState));
+    builder->contextStack->level = state->contextLevel;
+    memcpy(MMUBuilderContexts(builder), state->contexts,
+            (state->contextLevel + 1) * sizeof(MMUContext));
+}
+
+static int MMUIncrementalStatesEqual(const MMUIncrementalState* a, const MMUIncrementalState* b) {
+    unsigned int i;
+    int j;
+
+    if (a->documentState != b->documentState
+            || a->contentSeen != b->contentSeen
+            || a->headSeen != b->headSeen
+            || a->bodySeen != b->bodySeen
+            || a->inParagraph != b->inParagraph
+            || a->blankState != b->blankState
+            || a->preformattedDepth != b->preformattedDepth
+            || a->depth != b->depth
+            || a->contextLevel != b->contextLevel
+            || a->listDepth != b->listDepth) {
+        return 0;
+    }
+    for (i = 0; i < a->depth; ++i) {
+        const MMUIncrementalElement* x = a->elements + i;
+        const MMUIncrementalElement* y = b->elements + i;
+        if (x->tag != y->tag || x->element != y->element || x->dispatched != y->dispatched
+                || x->nameLen != y->nameLen
+                || (x->nameLen && memcmp(x->name, y->name, x->nameLen) != 0)) {
+            return 0;
+        }
+    }
+    for (j = 0; j < a->listDepth; ++j) {
+        if (a->lists[j].index != b->lists[j].index || a->lists[j].ordered != b->lists[j].ordered) {
+            return 0;
+        }
+    }
+    return memcmp(a->contexts, b->contexts, (a->contextLevel + 1) * sizeof(MMUContext)) == 0;
+}
+
+static size_t MMUIncrementalCount(const MMUIncrementalParser* parser) {
+    return parser->gapStart + (parser->capacity - parser->gapEnd);
+}
+
+static size_t MMUIncrementalInputOffset(const MMUIncrementalParser* parser, size_t index) {
+    if (index < parser->gapStart) {
+        return parser->blocks[index].inputOffset;
+    }
+    return parser->inputLen - parser->blocks[index + parser->gapEnd - parser->gapStart].inputOffset;
+}
+
+// Moves the gap in front of the block at index
+static void MMUIncrementalMoveGap(MMUIncrementalParser* parser, size_t index) {
+    MMUIncrementalBlock* block;
+
+    while (parser->gapStart > index) {
+        block = parser->blocks + --parser->gapEnd;
+        *block = parser->blocks[--parser->gapStart];
+        block->inputOffset = parser->inputLen - block->inputOffset;
+        block->outputOffset = parser->outputLen - block->outputOffset;
+    }
+    while (parser->gapStart < index) {
+        block = parser->blocks + parser->gapStart++;
+        *block = parser->blocks[parser->gapEnd++];
+        block->inputOffset = parser->inputLen - block->inputOffset;
+        block->outputOffset = parser->outputLen - block->outputOffset;
+    }
+}
+
+// Adds a block in front of the gap
+static void MMUIncrementalAddBlock(MMUIncrementalParser* parser, size_t inputOffset,
+        size_t outputOffset, MMUIncrementalState* state) {
+    MMUIncrementalBlock* block;
+
+    if (parser->gapStart == parser->gapEnd) {
+        size_t behind = parser->capacity - parser->gapEnd;
+        size_t capacity = parser->capacity ? parser->capacity * 2 : MMUIncrementalInitialBlocks;
+
+        parser->blocks = MMUReallocate(parser->options.allocator, parser->blocks,
+                capacity * sizeof(MMUIncrementalBlock));
+        memmove(parser->blocks + capacity - behind, parser->blocks + parser->gapEnd,
+                behind * sizeof(MMUIncrementalBlock));
+        parser->gapEnd = capacity - behind;
+        parser->capacity = capacity;
+    }
+    block = parser->blocks + parser->gapStart++;
+    block->inputOffset = inputOffset;
+    block->outputOffset = outputOffset;
+    block->state = state;
+}
+
+// Removes the block behind the gap
+static void MMUIncrementalDropBlock(MMUIncrementalParser* parser) {
+    MMUDeallocate(parser->options.allocator, parser->blocks[parser->gapEnd++].state);
+}
+
+static void MMUIncrementalClear(MMUIncrementalParser* parser) {
+    size_t i;
+
+    for (i = 0; i < parser->gapStart; ++i) {
+        MMUDeallocate(parser->options.allocator, parser->blocks[i].state);
+    }
+    while (parser->gapEnd < parser->capacity) {
+        MMUIncrementalDropBlock(parser);
+    }
+    parser->gapStart = 0;
+    parser->indexed = 0;
+}
+
+// The last block starting before offset, or the first one. Its input and
+// the input in front of it are the same as before an edit at offset, and
+// so is its state, since no token before a cut looks further ahead than
+// the '<' at the cut.
+static size_t MMUIncrementalFindBlock(const MMUIncrementalParser* parser, size_t offset) {
+    size_t low = 0;
+    size_t high = MMUIncrementalCount(parser);
+
+    while (low + 1 < high) {
+        size_t middle = low + (high - low) / 2;
+        if (MMUIncrementalInputOffset(parser, middle) < offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Whether the output can be cut at the current offset: nothing may be left
+// open, and a link or list item which started there must have text, or it
+// couldn't be told apart from one starting after the cut
+static int MMUIncrementalCanCut(const MMUBuilder* builder) {
+    return !builder->spanDepth
+        && builder->spanStartOffset
+            != builder->flushedLen + builder->bufferLen + builder->borrowedLen;
+}
+
+// Parses on from wherever the tokenizer was put, adding a block in front of
+// the gap at every cut. Behind the gap are the blocks of the previous input
+// from the edit on: they are dropped as the parse passes them, and the
+// parse stops at the first one which lies within the last suffixLen bytes
+// (which the edit left alone) and starts in the same state again. Returns
+// how much of the previous output, counted from its end, is still valid.
+static size_t MMUIncrementalRun(MMUIncrementalParser* parser, const char* html, size_t len,
+        size_t suffixLen) {
+    MMUHtmlTokenizer* tokenizer = parser->tokenizer;
+    MMUBuilder* builder = parser->parser->builder;
+    const char* end = html + len;
+
+    while (tokenizer->cur < end) {
+        const char* stop = MMUHtmlFindBlockStart(tokenizer->cur + 1, end, 1);
+        MMUIncrementalState* state;
+        size_t offset;
+
+        MMUHtmlTokenizerParseUntil(tokenizer, stop);
+        if (stop == end || tokenizer->cur != stop || !MMUIncrementalCanCut(builder)) {
+            continue;
+        }
+        MMUBuilderFlush(builder);
+        offset = (size_t)(stop - html);
+        state = MMUIncrementalCapture(parser);
+
+        while (parser->gapEnd < parser->capacity) {
+            const MMUIncrementalBlock* old = parser->blocks + parser->gapEnd;
+            if (old->inputOffset <= suffixLen && len - old->inputOffset >= offset) {
+                break;
+            }
+            MMUIncrementalDropBlock(parser);
+        }
+        if (parser->gapEnd < parser->capacity) {
+            const MMUIncrementalBlock* old = parser->blocks + parser->gapEnd;
+            // A separator is only added once there is some output. The old
+            // output must go on past the block's start, otherwise empty
+            // links or list items at the end would be ambiguous.
+            if (len - old->inputOffset == offset && old->outputOffset > 0
+                    && (old->outputOffset < parser->outputLen) == (builder->flushedLen > 0)
+                    && MMUIncrementalStatesEqual(old->state, state)) {
+                MMUDeallocate(parser->options.allocator, state);
+                return old->outputOffset;
+            }
+        }
+        MMUIncrementalAddBlock(parser, offset, builder->flushedLen, state);
+    }
+
+    while (parser->gapEnd < parser->capacity) {
+        MMUIncrementalDropBlock(parser);
+    }
+    MMUHtmlTokenizerFinish(tokenizer);
+    MMUBuilderFlush(builder);
+    return 0;
+}
+
+static void MMUIncrementalPrepare(MMUIncrementalParser* parser, const MMUCallbacks* callbacks,
+        void* callbackContext) {
+    MMUHtmlParserReset(parser->parser, callbackContext);
+    parser->parser->builder->callbacks = callbacks;
+}
+
+static MMUStatus MMUIncrementalParseWhole(MMUIncrementalParser* parser, const char* html,
+        size_t len, const MMUCallbacks* callbacks, void* callbackContext,
+        MMUOutputDelta* delta) {
+    MMUBuilder* builder = parser->parser->builder;
+    MMUStatus status;
+
+    MMUIncrementalClear(parser);
+    MMUIncrementalPrepare(parser, callbacks, callbackContext);
+    if (parser->indexable) {
+        MMUHtmlTokenizerInit(parser->tokenizer, builder);
+        MMUHtmlTokenizerStart(parser->tokenizer, html, len);
+        MMUIncrementalAddBlock(parser, 0, 0, MMUIncrementalCapture(parser));
+        MMUIncrementalRun(parser, html, len, 0);
+        MMUHtmlTokenizerDestroy(parser->tokenizer);
+        status = MMUBuilderFinish(builder);
+        parser->indexed = 1;
+    } else {
+        status = MMUHtmlParserParse(parser->parser, html, len);
+    }
+
+    if (delta) {
+        delta->outputStart = 0;
+        delta->removedLen = parser->outputLen;
+        delta->insertedLen = builder->flushedLen;
+    }
+    parser->inputLen = len;
+    parser->outputLen = builder->flushedLen;
+    return status;
+}
+
+MMUIncrementalParser* mmuIncrementalParserCreate(const MMUOptions* options) {
+    MMUIncrementalParser* parser = MMUAllocate(options->allocator, sizeof(MMUIncrementalParser));
+
+    memset(parser, 0, sizeof(MMUIncrementalParser));
+    parser->options = *options;
+    // Limits and previews need to see the whole document in order
+    parser->indexable = MMUHtmlParserUsesNative(options) && !options->limits
+        && !options->previewLength;
+    MMUHtmlParserInit(parser->parser, NULL, &parser->options, NULL);
+    return parser;
+}
+
+void mmuIncrementalParserDestroy(MMUIncrementalParser* parser) {
+    const MMUAllocator* allocator = parser->options.allocator;
+
+    MMUIncrementalClear(parser);
+    MMUHtmlParserDestroy(parser->parser);
+    MMUDeallocate(allocator, parser->blocks);
+    MMUDeallocate(allocator, parser);
+}
+
+MMUStatus mmuIncrementalParserParse(MMUIncrementalParser* parser, const char* html, size_t len,
+        const MMUCallbacks* callbacks, void* callbackContext) {
+    return MMUIncrementalParseWhole(parser, html, len, callbacks, callbackContext, NULL);
+}
+
+MMUStatus mmuIncrementalParserEdit(MMUIncrementalParser* parser, const char* html, size_t len,
+        const MMUEdit* edit, const MMUCallbacks* callbacks, void* callbackContext,
+        MMUOutputDelta* delta) {
+    MMUBuilder* builder = parser->parser->builder;
+    const MMUIncrementalBlock* block;
+    size_t index, outputStart, resume;
+
+    if (!parser->indexed || edit->start > parser->inputLen
+            || edit->removedLen > parser->inputLen - edit->start
+            || len != parser->inputLen - edit->removedLen + edit->insertedLen) {
+        return MMUIncrementalParseWhole(parser, html, len, callbacks, callbackContext, delta);
+    }
+
+    index = MMUIncrementalFindBlock(parser, edit->start);
+    MMUIncrementalMoveGap(parser, index + 1);
+    block = parser->blocks + index;
+    outputStart = block->outputOffset;
+
+    MMUIncrementalPrepare(parser, callbacks, callbackContext);
+    MMUHtmlTokenizerInit(parser->tokenizer, builder);
+    MMUHtmlTokenizerStart(parser->tokenizer, html, len);
+    parser->tokenizer->cur = html + block->inputOffset;
+    MMUIncrementalRestore(parser, block->state);
+    builder->flushedLen = outputStart;
+
+    resume = MMUIncrementalRun(parser, html, len,
+            parser->inputLen - edit->start - edit->removedLen);
+    MMUHtmlTokenizerDestroy(parser->tokenizer);
+
+    if (delta) {
+        delta->outputStart = outputStart;
+        delta->removedLen = parser->outputLen - resume - outputStart;
+        delta->insertedLen = builder->flushedLen - outputStart;
+    }
+    parser->inputLen = len;
+    parser->outputLen = builder->flushedLen + resume;
+    return MMUBuilderFinish(builder);
+}
@@ -0,0 +1,1338 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "allocator.h"
+#include "html-entities.h"
+#include "html-parser.h"
+#include "stats.h"
+
+#include <string.h>
+
+// Markdown is parsed in two passes per block, as CommonMark describes it.
+// Each line is first matched against the list items which are open and
+// checked for the start of a new block (ATX heading, setext underline,
+// thematic break or list item). The lines of a paragraph are collected as
+// slices of the input until it ends, then tokenised for inlines in one go,
+// since emphasis and links can only be resolved once their closers have
+// been seen. Emphasis is matched with CommonMark's delimiter stack, which
+// is linear. Every token points into the input, so text is never copied
+// on the way to the builder.
+//
+// The output is what markmeup makes of the equivalent html, the elements
+// being resolved by name so that MMUOptions.extraTags can restyle them
+// (including code spans, as <code>). Code blocks, block quotes, html,
+// images and reference links aren't recognised, their text comes through
+// as paragraphs. Headings are blocks of their own, as in a browser.
+
+enum {
+    // Two elements per level, for the list and its item
+    MMUMarkdownMaxLists = MMUMaxElementDepth / 2,
+    // Longer backtick runs are never taken for code spans
+    MMUMarkdownMaxBackticks = 32,
+    MMUMarkdownTabSize = 4,
+    MMUMarkdownInitialLines = 16,
+    MMUMarkdownInitialTokens = 64,
+    MMUMarkdownInitialHref = 256
+};
+
+static const size_t MMUMarkdownNone = (size_t)-1;
+
+typedef enum MMUMarkdownTokenType {
+    MMU_MARKDOWN_TOKEN_TEXT = 0
+    // A character reference, decoded to codePoint
+  , MMU_MARKDOWN_TOKEN_CHARACTER
+  , MMU_MARKDOWN_TOKEN_SOFT_BREAK
+  , MMU_MARKDOWN_TOKEN_HARD_BREAK
+    // A run of '*' or '_'
+  , MMU_MARKDOWN_TOKEN_DELIMITER
+    // A '[' which didn't turn out to start a link
+  , MMU_MARKDOWN_TOKEN_OPEN_BRACKET
+    // text is the destination
+  , MMU_MARKDOWN_TOKEN_LINK_START
+  , MMU_MARKDOWN_TOKEN_LINK_END
+    // text is both the destination and the text
+  , MMU_MARKDOWN_TOKEN_AUTOLINK
+  , MMU_MARKDOWN_TOKEN_CODE_START
+  , MMU_MARKDOWN_TOKEN_CODE_END
+} MMUMarkdownTokenType;
+
+typedef struct MMUMarkdownToken {
+    MMUMarkdownTokenType type;
+    const char* text;
+    size_t len;
+    unsigned int codePoint;
+
+    // Delimiter runs only. count characters starting closed characters in
+    // are left as text once emphasis has been matched.
+    size_t count;
+    size_t closed;
+    char canOpen;
+    char canClose;
+    // Neighbours on the delimiter stack
+    size_t previous;
+    size_t next;
+    // MMUMarkdownEmphasis opened after the run, outermost first, and closed
+    // before it, innermost first
+    size_t opens;
+    size_t closes;
+    size_t closesTail;
+} MMUMarkdownToken;
+
+typedef struct MMUMarkdownEmphasis {
+    size_t nextOpen;
+    size_t nextClose;
+    char strong;
+} MMUMarkdownEmphasis;
+
+typedef struct MMUMarkdownLine {
+    const char* text;
+    size_t len;
+    // Ended in two or more spaces
+    char hardBreak;
+} MMUMarkdownLine;
+
+typedef struct MMUMarkdownMarker {
+    // The bullet, or the '.' or ')' after the number
+    char marker;
+    char ordered;
+    unsigned int start;
+} MMUMarkdownMarker;
+
+typedef struct MMUMarkdownList {
+    char marker;
+    char ordered;
+    // Columns a line has to be indented by, relative to the enclosing item,
+    // to continue the current item
+    unsigned int contentIndent;
+    // Whether the list and its current item are within maxDepth
+    char dispatched;
+    char itemDispatched;
+    // The first block of an item isn't a paragraph of its own, as in the
+    // html of a tight list. Whether the list is loose is only known once
+    // it ends, long after its first items were passed on.
+    char itemHasContent;
+} MMUMarkdownList;
+
+typedef struct MMUMarkdownParser {
+    MMUBuilder* builder;
+    const MMUOptions* options;
+    unsigned int depth;
+    unsigned int maxDepth;
+
+    // Resolved through MMUHtmlParserResolveElement
+    int emphasisElement;
+    int strongElement;
+    int linkElement;
+    int paragraphElement;
+    int breakElement;
+    int codeElement;
+    int headingElements[6];
+
+    MMUMarkdownList lists[MMUMarkdownMaxLists];
+    unsigned int listCount;
+
+    // The paragraph being collected, and the number of lists open when it
+    // started
+    MMUMarkdownLine* lines;
+    size_t lineCount;
+    size_t lineCapacity;
+    unsigned int paragraphLists;
+
+    MMUMarkdownToken* tokens;
+    size_t tokenCount;
+    size_t tokenCapacity;
+    MMUMarkdownEmphasis* emphasis;
+    size_t emphasisCount;
+    size_t emphasisCapacity;
+    // Top of the delimiter stack
+    size_t lastDelimiter;
+    // Open brackets, as token indices. Those below bracketFloor are
+    // inactive, since links can't contain links.
+    size_t* brackets;
+    size_t bracketCount;
+    size_t bracketCapacity;
+    size_t bracketFloor;
+    // Backtick run lengths known not to occur in the rest of the paragraph
+    char backticksMissing[MMUMarkdownMaxBackticks + 1];
+
+    // Decoded link destination
+    char* href;
+    size_t hrefCapacity;
+} MMUMarkdownParser;
+
+static void* MMUMarkdownReserve(MMUMarkdownParser* md, void* data, size_t* capacity,
+        size_t needed, size_t size, size_t initialCapacity) {
+    size_t newCapacity;
+
+    if (needed <= *capacity) {
+        return data;
+    }
+    newCapacity = *capacity ? *capacity : initialCapacity;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    *capacity = newCapacity;
+    return MMUReallocate(md->options->allocator, data, newCapacity * size);
+}
+
+static int resolveElement(const MMUOptions* options, MMUHtmlTag tag, const char* name) {
+    return MMUHtmlParserResolveElement(options, tag, name, strlen(name));
+}
+
+static void MMUMarkdownParserInit(MMUMarkdownParser* md, MMUBuilder* builder) {
+    static const char* headingNames[6] = { "h1", "h2", "h3", "h4", "h5", "h6" };
+    const MMUOptions* options = builder->options;
+    int i;
+
+    memset(md, 0, sizeof(MMUMarkdownParser));
+    md->builder = builder;
+    md->options = options;
+    // The html the document stands for has an <html> and a <body>
+    md->depth = 2;
+    md->maxDepth = MMUHtmlParserMaxDepth(options);
+    md->lastDelimiter = MMUMarkdownNone;
+
+    md->emphasisElement = resolveElement(options, MMU_HTML_TAG_EM, "em");
+    md->strongElement = resolveElement(options, MMU_HTML_TAG_STRONG, "strong");
+    md->linkElement = resolveElement(options, MMU_HTML_TAG_A, "a");
+    md->paragraphElement = resolveElement(options, MMU_HTML_TAG_P, "p");
+    md->breakElement = resolveElement(options, MMU_HTML_TAG_BR, "br");
+    md->codeElement = resolveElement(options, MMU_HTML_TAG_CODE, "code");
+    for (i = 0; i < 6; ++i) {
+        md->headingElements[i] = resolveElement(options, (MMUHtmlTag)(MMU_HTML_TAG_H1 + i),
+                headingNames[i]);
+    }
+}
+
+static void MMUMarkdownParserDestroy(MMUMarkdownParser* md) {
+    const MMUAllocator* allocator = md->options->allocator;
+
+    MMUDeallocate(allocator, md->lines);
+    MMUDeallocate(allocator, md->tokens);
+    MMUDeallocate(allocator, md->emphasis);
+    MMUDeallocate(allocator, md->brackets);
+    MMUDeallocate(allocator, md->href);
+}
+
+// Elements are counted and checked against the limits like html ones, and
+// only reach the builder within maxDepth
+
+static void MMUMarkdownOpenElement(MMUMarkdownParser* md, int element, const char* href) {
+    ++md->depth;
+    MMUBuilderCountNode(md->builder);
+    MMUBuilderCheckDepth(md->builder, md->depth);
+    if (md->depth <= md->maxDepth) {
+        MMUHtmlParserStartElement(md->builder, element, href);
+    }
+}
+
+static void MMUMarkdownCloseElement(MMUMarkdownParser* md, int element) {
+    if (md->depth <= md->maxDepth) {
+        MMUHtmlParserEndElement(md->builder, element);
+    }
+    --md->depth;
+}
+
+static int isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static int isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static int isPunctuation(char c) {
+    return (c >= '!' && c <= '/') || (c >= ':' && c <= '@') || (c >= '[' && c <= '`')
+        || (c >= '{' && c <= '~');
+}
+
+static int isAlphanumeric(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static int isHexDigit(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Characters which may start an inline construct
+static int isSpecial(char c) {
+    switch (c) {
+        case '\\':
+        case '*':
+        case '_':
+        case '`':
+        case '[':
+        case ']':
+        case '&':
+        case '<':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static unsigned int advanceColumn(unsigned int column, char c) {
+    return c == '\t' ? column + MMUMarkdownTabSize - column % MMUMarkdownTabSize : column + 1;
+}
+
+// Columns of blanks at the start of text, tabs stopping every four
+static unsigned int indentation(const char* text, const char* end, const char** after) {
+    unsigned int column = 0;
+
+    while (text < end && isBlank(*text)) {
+        column = advanceColumn(column, *text++);
+    }
+    *after = text;
+    return column;
+}
+
+static const char* skipIndentation(const char* text, const char* end, unsigned int columns) {
+    unsigned int column = 0;
+
+    while (text < end && column < columns && isBlank(*text)) {
+        column = advanceColumn(column, *text++);
+    }
+    return text;
+}
+
+// Blocks
+
+static int isThematicBreak(const char* text, const char* end) {
+    char c = text < end ? *text : '\0';
+    size_t count = 0;
+
+    if (c != '*' && c != '-' && c != '_') {
+        return 0;
+    }
+    for (; text < end; ++text) {
+        if (*text == c) {
+            ++count;
+        } else if (!isBlank(*text)) {
+            return 0;
+        }
+    }
+    return count >= 3;
+}
+
+// Level of a setext heading underline, or 0
+static int setextLevel(const char* text, const char* end) {
+    char c = text < end ? *text : '\0';
+
+    if (c != '=' && c != '-') {
+        return 0;
+    }
+    while (text < end && *text == c) {
+        ++text;
+    }
+    while (text < end && isBlank(*text)) {
+        ++text;
+    }
+    return text == end ? (c == '=' ? 1 : 2) : 0;
+}
+
+// Level of an ATX heading, or 0, with its content minus any closing #s
+static int atxHeading(const char* text, const char* end, const char** content, size_t* len) {
+    const char* closing;
+    int level = 0;
+
+    while (text < end && *text == '#' && level <= 6) {
+        ++text;
+        ++level;
+    }
+    if (level == 0 || level > 6 || (text < end && !isBlank(*text))) {
+        return 0;
+    }
+    while (text < end && isBlank(*text)) {
+        ++text;
+    }
+    while (end > text && isBlank(end[-1])) {
+        --end;
+    }
+    closing = end;
+    while (closing > text && closing[-1] == '#') {
+        --closing;
+    }
+    if (closing == text || isBlank(closing[-1])) {
+        end = closing;
+        while (end > text && isBlank(end[-1])) {
+            --end;
+        }
+    }
+    *content = text;
+    *len = (size_t)(end - text);
+    return level;
+}
+
+// Returns the end of a list marker at text, or NULL
+static const char* listMarker(const char* text, const char* end, MMUMarkdownMarker* marker) {
+    if (text < end && (*text == '-' || *text == '+' || *text == '*')) {
+        marker->marker = *text++;
+        marker->ordered = 0;
+        marker->start = 0;
+    } else {
+        const char* digits = text;
+        unsigned int start = 0;
+
+        while (text < end && *text >= '0' && *text <= '9' && text - digits < 9) {
+            start = start * 10 + (unsigned int)(*text++ - '0');
+        }
+        if (text == digits || text == end || (*text != '.' && *text != ')')) {
+            return NULL;
+        }
+        marker->marker = *text++;
+        marker->ordered = 1;
+        marker->start = start;
+    }
+    return text == end || isBlank(*text) ? text : NULL;
+}
+
+// Whether a list item may end the paragraph before it: it needs content
+// and, if ordered, to start at 1
+static int canInterruptParagraph(const MMUMarkdownMarker* marker, const char* content,
+        const char* end) {
+    while (content < end && isBlank(*content)) {
+        ++content;
+    }
+    return content < end && (!marker->ordered || marker->start == 1);
+}
+
+// Whether a line which no longer continues the open list items starts a
+// block, rather than lazily continuing their paragraph
+static int startsBlock(const char* text, const char* end) {
+    MMUMarkdownMarker marker;
+    const char* content;
+    const char* heading;
+    size_t headingLen;
+
+    if (indentation(text, end, &text) >= 4) {
+        return 0;
+    }
+    content = listMarker(text, end, &marker);
+    return isThematicBreak(text, end) || atxHeading(text, end, &heading, &headingLen)
+        || (content && canInterruptParagraph(&marker, content, end));
+}
+
+static void MMUMarkdownAddLine(MMUMarkdownParser* md, const char* text, const char* end) {
+    MMUMarkdownLine* line;
+    const char* trimmed;
+
+    while (text < end && isBlank(*text)) {
+        ++text;
+    }
+    trimmed = end;
+    while (trimmed > text && isBlank(trimmed[-1])) {
+        --trimmed;
+    }
+    if (md->lineCount == 0) {
+        md->paragraphLists = md->listCount;
+    }
+    md->lines = MMUMarkdownReserve(md, md->lines, &md->lineCapacity, md->lineCount + 1,
+            sizeof(MMUMarkdownLine), MMUMarkdownInitialLines);
+    line = md->lines + md->lineCount++;
+    line->text = text;
+    line->len = (size_t)(trimmed - text);
+    line->hardBreak = end - trimmed >= 2 && trimmed[0] == ' ' && trimmed[1] == ' ';
+}
+
+static void MMUMarkdownEmitInlines(MMUMarkdownParser* md);
+
+// Emits the collected lines as a paragraph, or a heading of level
+static void MMUMarkdownEmitBlock(MMUMarkdownParser* md, int level) {
+    int paragraph = 1;
+
+    if (md->listCount) {
+        MMUMarkdownList* list = md->lists + md->listCount - 1;
+        paragraph = list->itemHasContent;
+        list->itemHasContent = 1;
+    }
+    if (paragraph) {
+        MMUMarkdownOpenElement(md, md->paragraphElement, NULL);
+    }
+    if (level) {
+        MMUMarkdownOpenElement(md, md->headingElements[level - 1], NULL);
+    }
+    MMUMarkdownEmitInlines(md);
+    if (level) {
+        MMUMarkdownCloseElement(md, md->headingElements[level - 1]);
+    }
+    if (paragraph) {
+        MMUMarkdownCloseElement(md, md->paragraphElement);
+    }
+    md->lineCount = 0;
+}
+
+static void MMUMarkdownCloseParagraph(MMUMarkdownParser* md) {
+    if (md->lineCount && !md->builder->status) {
+        MMUMarkdownEmitBlock(md, 0);
+    }
+    md->lineCount = 0;
+}
+
+static void MMUMarkdownStartItem(MMUMarkdownParser* md, MMUMarkdownList* list) {
+    ++md->depth;
+    MMUBuilderCountNode(md->builder);
+    MMUBuilderCheckDepth(md->builder, md->depth);
+    list->itemDispatched = md->depth <= md->maxDepth;
+    list->itemHasContent = 0;
+    if (list->itemDispatched) {
+        MMUBuilderStartListItem(md->builder);
+    }
+}
+
+static void MMUMarkdownEndItem(MMUMarkdownParser* md, MMUMarkdownList* list) {
+    if (list->itemDispatched) {
+        MMUBuilderEndListItem(md->builder);
+    }
+    --md->depth;
+}
+
+static MMUMarkdownList* MMUMarkdownOpenList(MMUMarkdownParser* md, const MMUMarkdownMarker* marker) {
+    MMUMarkdownList* list = md->lists + md->listCount++;
+
+    if (md->listCount > 1) {
+        list[-1].itemHasContent = 1;
+    }
+    list->marker = marker->marker;
+    list->ordered = marker->ordered;
+    ++md->depth;
+    MMUBuilderCountNode(md->builder);
+    MMUBuilderCheckDepth(md->builder, md->depth);
+    list->dispatched = md->depth <= md->maxDepth;
+    if (list->dispatched) {
+        MMUBuilderStartList(md->builder, marker->ordered, marker->start);
+    }
+    return list;
+}
+
+// Closes lists until count are left
+static void MMUMarkdownCloseLists(MMUMarkdownParser* md, unsigned int count) {
+    while (md->listCount > count) {
+        MMUMarkdownList* list = md->lists + --md->listCount;
+        MMUMarkdownEndItem(md, list);
+        if (list->dispatched) {
+            MMUBuilderEndList(md->builder);
+        }
+        --md->depth;
+    }
+}
+
+static void MMUMarkdownParseLine(MMUMarkdownParser* md, const char* text, const char* end) {
+    MMUMarkdownList* sibling = NULL;
+    unsigned int matched;
+    int startedItem = 0;
+
+    // Open items go on through blank lines and lines indented to their content
+    for (matched = 0; matched < md->listCount; ++matched) {
+        const char* content;
+        unsigned int indent = indentation(text, end, &content);
+
+        if (content == end) {
+            text = end;
+        } else if (indent >= md->lists[matched].contentIndent) {
+            text = skipIndentation(text, end, md->lists[matched].contentIndent);
+        } else {
+            break;
+        }
+    }
+
+    {
+        const char* content;
+        indentation(text, end, &content);
+        if (content == end) {
+            MMUMarkdownCloseParagraph(md);
+            return;
+        }
+    }
+
+    if (matched < md->listCount) {
+        MMUMarkdownList* list = md->lists + matched;
+        MMUMarkdownMarker marker;
+        const char* content;
+        unsigned int indent = indentation(text, end, &content);
+        const char* markerEnd = indent < 4 && !isThematicBreak(content, end)
+            ? listMarker(content, end, &marker) : NULL;
+
+        int isSibling = markerEnd && marker.marker == list->marker
+            && marker.ordered == list->ordered;
+
+        if (md->lineCount && !isSibling && !startsBlock(text, end)) {
+            MMUMarkdownAddLine(md, text, end);
+            return;
+        }
+        MMUMarkdownCloseParagraph(md);
+        if (isSibling) {
+            MMUMarkdownCloseLists(md, matched + 1);
+            MMUMarkdownEndItem(md, list);
+            sibling = list;
+        } else {
+            MMUMarkdownCloseLists(md, matched);
+        }
+    }
+
+    for (;;) {
+        MMUMarkdownMarker marker;
+        MMUMarkdownList* list;
+        const char* start;
+        const char* content;
+        const char* markerEnd;
+        size_t len;
+        unsigned int indent = indentation(text, end, &start);
+        unsigned int spaces;
+        int level;
+
+        // Indented code isn't supported, it is kept as paragraph text
+        if (indent >= 4) {
+            break;
+        }
+        if (md->lineCount && md->paragraphLists == md->listCount && !startedItem
+                && (level = setextLevel(start, end))) {
+            if (!md->builder->status) {
+                MMUMarkdownEmitBlock(md, level);
+            }
+            md->lineCount = 0;
+            return;
+        }
+        if (isThematicBreak(start, end)) {
+            MMUMarkdownCloseParagraph(md);
+            return;
+        }
+        if ((level = atxHeading(start, end, &content, &len))) {
+            MMUMarkdownCloseParagraph(md);
+            if (len && !md->builder->status) {
+                MMUMarkdownAddLine(md, content, content + len);
+                MMUMarkdownEmitBlock(md, level);
+            }
+            return;
+        }
+        markerEnd = listMarker(start, end, &marker);
+        if (!markerEnd || (md->lineCount && !canInterruptParagraph(&marker, markerEnd, end))) {
+            break;
+        }
+        if (sibling) {
+            list = sibling;
+            sibling = NULL;
+        } else if (md->listCount == MMUMarkdownMaxLists) {
+            break;
+        } else {
+            MMUMarkdownCloseParagraph(md);
+            list = MMUMarkdownOpenList(md, &marker);
+        }
+        MMUMarkdownStartItem(md, list);
+        startedItem = 1;
+
+        // The content starts after one to four blanks, any more and it is
+        // taken to start after the first
+        spaces = indentation(markerEnd, end, &content);
+        if (content == end || spaces > 4) {
+            list->contentIndent = indent + (unsigned int)(markerEnd - start) + 1;
+            text = content == end ? end : markerEnd + 1;
+        } else {
+            list->contentIndent = indent + (unsigned int)(markerEnd - start) + spaces;
+            text = content;
+        }
+    }
+
+    {
+        const char* content;
+        indentation(text, end, &content);
+        if (content < end) {
+            MMUMarkdownAddLine(md, text, end);
+        }
+    }
+}
+
+// Inlines
+
+static size_t MMUMarkdownAddToken(MMUMarkdownParser* md, MMUMarkdownTokenType type,
+        const char* text, size_t len) {
+    MMUMarkdownToken* token;
+
+    md->tokens = MMUMarkdownReserve(md, md->tokens, &md->tokenCapacity, md->tokenCount + 1,
+            sizeof(MMUMarkdownToken), MMUMarkdownInitialTokens);
+    token = md->tokens + md->tokenCount;
+    memset(token, 0, sizeof(MMUMarkdownToken));
+    token->type = type;
+    token->text = text;
+    token->len = len;
+    token->previous = MMUMarkdownNone;
+    token->next = MMUMarkdownNone;
+    token->opens = MMUMarkdownNone;
+    token->closes = MMUMarkdownNone;
+    return md->tokenCount++;
+}
+
+static void MMUMarkdownAddText(MMUMarkdownParser* md, const char* text, const char* end) {
+    if (end > text) {
+        MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_TEXT, text, (size_t)(end - text));
+    }
+}
+
+static void MMUMarkdownRemoveDelimiter(MMUMarkdownParser* md, size_t index) {
+    MMUMarkdownToken* token = md->tokens + index;
+
+    if (token->previous != MMUMarkdownNone) {
+        md->tokens[token->previous].next = token->next;
+    }
+    if (token->next != MMUMarkdownNone) {
+        md->tokens[token->next].previous = token->previous;
+    } else {
+        md->lastDelimiter = token->previous;
+    }
+}
+
+static void MMUMarkdownAddEmphasis(MMUMarkdownParser* md, size_t opener, size_t closer, int strong) {
+    MMUMarkdownToken* closing = md->tokens + closer;
+    MMUMarkdownEmphasis* emphasis;
+    size_t index = md->emphasisCount;
+
+    md->emphasis = MMUMarkdownReserve(md, md->emphasis, &md->emphasisCapacity,
+            md->emphasisCount + 1, sizeof(MMUMarkdownEmphasis), MMUMarkdownInitialTokens);
+    emphasis = md->emphasis + md->emphasisCount++;
+    emphasis->strong = (char)strong;
+    emphasis->nextOpen = md->tokens[opener].opens;
+    md->tokens[opener].opens = index;
+    emphasis->nextClose = MMUMarkdownNone;
+    if (closing->closes == MMUMarkdownNone) {
+        closing->closes = index;
+    } else {
+        md->emphasis[closing->closesTail].nextClose = index;
+    }
+    closing->closesTail = index;
+}
+
+// Matches the delimiter runs from token floor on and takes them off the
+// stack, following CommonMark's "process emphasis"
+static void MMUMarkdownProcessEmphasis(MMUMarkdownParser* md, size_t floor) {
+    // Where the search for an opener can stop, per delimiter character,
+    // closer length modulo 3 and whether the closer can open
+    size_t openersBottom[2][3][2];
+    size_t closer = md->lastDelimiter;
+    int i, j, k;
+
+    for (i = 0; i < 2; ++i) {
+        for (j = 0; j < 3; ++j) {
+            for (k = 0; k < 2; ++k) {
+                openersBottom[i][j][k] = floor;
+            }
+        }
+    }
+
+    if (closer == MMUMarkdownNone || closer < floor) {
+        return;
+    }
+    while (md->tokens[closer].previous != MMUMarkdownNone && md->tokens[closer].previous >= floor) {
+        closer = md->tokens[closer].previous;
+    }
+
+    while (closer != MMUMarkdownNone) {
+        MMUMarkdownToken* closing = md->tokens + closer;
+        size_t* bottom;
+        size_t opener;
+        size_t next;
+
+        if (!closing->canClose) {
+            closer = closing->next;
+            continue;
+        }
+        bottom = &openersBottom[closing->text[0] == '_'][closing->len % 3][closing->canOpen != 0];
+        for (opener = closing->previous; opener != MMUMarkdownNone && opener >= *bottom;
+                opener = md->tokens[opener].previous) {
+            const MMUMarkdownToken* opening = md->tokens + opener;
+            // The rule of 3: a run which can both open and close only
+            // pairs up with one whose length doesn't make a multiple of 3
+            // with its own, unless both are
+            if (opening->text[0] == closing->text[0] && opening->canOpen
+                    && !((opening->canClose || closing->canOpen)
+                        && (opening->len + closing->len) % 3 == 0
+                        && (opening->len % 3 != 0 || closing->len % 3 != 0))) {
+                break;
+            }
+        }
+
+        if (opener != MMUMarkdownNone && opener >= *bottom) {
+            MMUMarkdownToken* opening = md->tokens + opener;
+            size_t use = opening->count >= 2 && closing->count >= 2 ? 2 : 1;
+
+            opening->count -= use;
+            closing->count -= use;
+            closing->closed += use;
+            MMUMarkdownAddEmphasis(md, opener, closer, use == 2);
+            // Runs in between can't match anything any more
+            opening->next = closer;
+            closing->previous = opener;
+            if (opening->count == 0) {
+                MMUMarkdownRemoveDelimiter(md, opener);
+            }
+            if (closing->count == 0) {
+                next = closing->next;
+                MMUMarkdownRemoveDelimiter(md, closer);
+                closer = next;
+            }
+        } else {
+            *bottom = closer;
+            next = closing->next;
+            if (!closing->canOpen) {
+                MMUMarkdownRemoveDelimiter(md, closer);
+            }
+            closer = next;
+        }
+    }
+
+    while (md->lastDelimiter != MMUMarkdownNone && md->lastDelimiter >= floor) {
+        MMUMarkdownRemoveDelimiter(md, md->lastDelimiter);
+    }
+}
+
+// The character before or after a position, line ends and the ends of the
+// paragraph counting as whitespace
+static char charBefore(const MMUMarkdownLine* line, const char* at) {
+    return at > line->text ? at[-1] : '\n';
+}
+
+static char charAfter(const MMUMarkdownLine* line, const char* at) {
+    return at < line->text + line->len ? *at : '\n';
+}
+
+static void MMUMarkdownAddDelimiter(MMUMarkdownParser* md, const MMUMarkdownLine* line,
+        const char* run, size_t len) {
+    char before = charBefore(line, run);
+    char after = charAfter(line, run + len);
+    int leftFlanking = !isWhitespace(after)
+        && (!isPunctuation(after) || isWhitespace(before) || isPunctuation(before));
+    int rightFlanking = !isWhitespace(before)
+        && (!isPunctuation(before) || isWhitespace(after) || isPunctuation(after));
+    size_t index = MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_DELIMITER, run, len);
+    MMUMarkdownToken* token = md->tokens + index;
+
+    token->count = len;
+    if (*run == '*') {
+        token->canOpen = (char)leftFlanking;
+        token->canClose = (char)rightFlanking;
+    } else {
+        // Intraword underscores aren't emphasis
+        token->canOpen = (char)(leftFlanking && (!rightFlanking || isPunctuation(before)));
+        token->canClose = (char)(rightFlanking && (!leftFlanking || isPunctuation(after)));
+    }
+    if (!token->canOpen && !token->canClose) {
+        token->type = MMU_MARKDOWN_TOKEN_TEXT;
+        return;
+    }
+    token->previous = md->lastDelimiter;
+    if (md->lastDelimiter != MMUMarkdownNone) {
+        md->tokens[md->lastDelimiter].next = index;
+    }
+    md->lastDelimiter = index;
+}
+
+static size_t backtickRun(const char* text, const char* end) {
+    const char* start = text;
+
+    while (text < end && *text == '`') {
+        ++text;
+    }
+    return (size_t)(text - start);
+}
+
+// Looks for a backtick run of exactly len from line *lineIndex, at, on,
+// moving to the line it is found on
+static const char* findBackticks(MMUMarkdownParser* md, size_t* lineIndex, const char* at,
+        size_t len) {
+    size_t i;
+
+    for (i = *lineIndex; i < md->lineCount; ++i) {
+        const MMUMarkdownLine* line = md->lines + i;
+        const char* end = line->text + line->len;
+
+        if (i != *lineIndex) {
+            at = line->text;
+        }
+        while ((at = memchr(at, '`', (size_t)(end - at))) != NULL) {
+            size_t run = backtickRun(at, end);
+            if (run == len) {
+                *lineIndex = i;
+                return at;
+            }
+            at += run;
+        }
+    }
+    md->backticksMissing[len] = 1;
+    return NULL;
+}
+
+// Adds a code span whose content runs from line first, start, to line
+// last, end. Line ends become spaces, and one space is stripped from each
+// side of content which has other characters.
+static void MMUMarkdownAddCode(MMUMarkdownParser* md, size_t first, const char* start,
+        size_t last, const char* end) {
+    size_t firstToken;
+    size_t lastToken;
+    size_t i;
+    int blank = 1;
+
+    MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_CODE_START, NULL, 0);
+    firstToken = md->tokenCount;
+    for (i = first; i <= last; ++i) {
+        const char* from = i == first ? start : md->lines[i].text;
+        const char* to = i == last ? end : md->lines[i].text + md->lines[i].len;
+        const char* c;
+
+        if (i != first) {
+            MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_TEXT, " ", 1);
+        }
+        for (c = from; c < to && blank; ++c) {
+            blank = *c == ' ';
+        }
+        MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_TEXT, from, (size_t)(to - from));
+    }
+    lastToken = md->tokenCount - 1;
+
+    while (firstToken < lastToken && md->tokens[firstToken].len == 0) {
+        ++firstToken;
+    }
+    while (lastToken > firstToken && md->tokens[lastToken].len == 0) {
+        --lastToken;
+    }
+    if (!blank && md->tokens[firstToken].text[0] == ' '
+            && md->tokens[lastToken].text[md->tokens[lastToken].len - 1] == ' ') {
+        ++md->tokens[firstToken].text;
+        --md->tokens[firstToken].len;
+        --md->tokens[lastToken].len;
+    }
+    MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_CODE_END, NULL, 0);
+}
+
+// Parses the "(destination "title")" of an inline link, returning the
+// closing parenthesis or NULL. It has to fit on the line.
+static const char* parseLinkTail(const char* text, const char* end,
+        const char** destination, size_t* len) {
+    int depth = 0;
+
+    if (text == end || *text != '(') {
+        return NULL;
+    }
+    ++text;
+    while (text < end && isBlank(*text)) {
+        ++text;
+    }
+
+    if (text < end && *text == '<') {
+        *destination = ++text;
+        while (text < end && *text != '>' && *text != '<') {
+            text += *text == '\\' && text + 1 < end ? 2 : 1;
+        }
+        if (text == end || *text != '>') {
+            return NULL;
+        }
+        *len = (size_t)(text - *destination);
+        ++text;
+    } else {
+        *destination = text;
+        while (text < end && !isBlank(*text) && (*text != ')' || depth > 0)) {
+            if (*text == '\\' && text + 1 < end) {
+                ++text;
+            } else if (*text == '(') {
+                ++depth;
+            } else if (*text == ')') {
+                --depth;
+            }
+            ++text;
+        }
+        if (depth != 0) {
+            return NULL;
+        }
+        *len = (size_t)(text - *destination);
+    }
+
+    if (text < end && isBlank(*text)) {
+        while (text < end && isBlank(*text)) {
+            ++text;
+        }
+        // The title is ignored, like the html attribute
+        if (text < end && (*text == '"' || *text == '\'' || *text == '(')) {
+            char close = *text == '(' ? ')' : *text;
+            ++text;
+            while (text < end && *text != close) {
+                text += *text == '\\' && text + 1 < end ? 2 : 1;
+            }
+            if (text == end) {
+                return NULL;
+            }
+            ++text;
+            while (text < end && isBlank(*text)) {
+                ++text;
+            }
+        }
+    }
+    return text < end && *text == ')' ? text : NULL;
+}
+
+// Decodes a character reference after '&', returning its end or NULL
+static const char* parseReference(const char* text, const char* end, unsigned int* codePoint) {
+    const char* start = text;
+
+    if (text < end && *text == '#') {
+        unsigned int value = 0;
+        int hex = ++text < end && (*text == 'x' || *text == 'X');
+
+        if (hex) {
+            ++text;
+        }
+        start = text;
+        while (text < end && text - start < (hex ? 6 : 7)
+                && (hex ? isHexDigit(*text) : *text >= '0' && *text <= '9')) {
+            char c = *text++;
+            value = value * (hex ? 16 : 10)
+                + (unsigned int)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        if (text == start || text == end || *text != ';') {
+            return NULL;
+        }
+        if (value == 0 || value > 0x10ffff || (value >= 0xd800 && value <= 0xdfff)) {
+            value = 0xfffd;
+        }
+        *codePoint = value;
+        return text + 1;
+    }
+
+    while (text < end && isAlphanumeric(*text) && text - start < 32) {
+        ++text;
+    }
+    if (text == start || text == end || *text != ';') {
+        return NULL;
+    }
+    *codePoint = MMUHtmlEntityLookup(start, (size_t)(text - start));
+    return *codePoint ? text + 1 : NULL;
+}
+
+// Parses the "scheme:..." of an autolink after '<', returning the closing
+// '>' or NULL
+static const char* parseAutolink(const char* text, const char* end) {
+    const char* start = text;
+
+    if (text == end || !((*text | 0x20) >= 'a' && (*text | 0x20) <= 'z')) {
+        return NULL;
+    }
+    while (text < end && (isAlphanumeric(*text) || *text == '+' || *text == '.' || *text == '-')) {
+        ++text;
+    }
+    if (text - start < 2 || text - start > 32 || text == end || *text != ':') {
+        return NULL;
+    }
+    while (text < end && *text != '>' && *text != '<' && !isWhitespace(*text)) {
+        ++text;
+    }
+    return text < end && *text == '>' ? text : NULL;
+}
+
+static void MMUMarkdownCloseBracket(MMUMarkdownParser* md, const char** at, const char* end) {
+    const char* bracket = *at;
+    const char* destination;
+    const char* close;
+    size_t opener;
+    size_t len;
+
+    *at = bracket + 1;
+    if (md->bracketCount == 0) {
+        MMUMarkdownAddText(md, bracket, bracket + 1);
+        return;
+    }
+    opener = md->brackets[--md->bracketCount];
+    if (md->bracketCount < md->bracketFloor
+            || !(close = parseLinkTail(bracket + 1, end, &destination, &len))) {
+        MMUMarkdownAddText(md, bracket, bracket + 1);
+        return;
+    }
+
+    md->tokens[opener].type = MMU_MARKDOWN_TOKEN_LINK_START;
+    md->tokens[opener].text = destination;
+    md->tokens[opener].len = len;
+    MMUMarkdownProcessEmphasis(md, opener + 1);
+    MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_LINK_END, NULL, 0);
+    md->bracketFloor = md->bracketCount;
+    *at = close + 1;
+}
+
+static void MMUMarkdownTokenise(MMUMarkdownParser* md) {
+    size_t i;
+
+    md->tokenCount = 0;
+    md->emphasisCount = 0;
+    md->lastDelimiter = MMUMarkdownNone;
+    md->bracketCount = 0;
+    md->bracketFloor = 0;
+    memset(md->backticksMissing, 0, sizeof(md->backticksMissing));
+
+    for (i = 0; i < md->lineCount; ++i) {
+        const MMUMarkdownLine* line = md->lines + i;
+        const char* text = line->text;
+        const char* end = text + line->len;
+        const char* plain = text;
+        int hardBreak = line->hardBreak;
+
+        while (text < end) {
+            const char* next;
+            unsigned int codePoint;
+            size_t len;
+
+            switch (*text) {
+                case '\\':
+                    if (text + 1 == end && i + 1 < md->lineCount) {
+                        MMUMarkdownAddText(md, plain, text);
+                        hardBreak = 1;
+                        plain = ++text;
+                    } else if (text + 1 < end && isPunctuation(text[1])) {
+                        MMUMarkdownAddText(md, plain, text);
+                        MMUMarkdownAddText(md, text + 1, text + 2);
+                        plain = text += 2;
+                    } else {
+                        ++text;
+                    }
+                    break;
+                case '*':
+                case '_':
+                    len = 1;
+                    while (text + len < end && text[len] == *text) {
+                        ++len;
+                    }
+                    MMUMarkdownAddText(md, plain, text);
+                    MMUMarkdownAddDelimiter(md, line, text, len);
+                    plain = text += len;
+                    break;
+                case '`':
+                    len = backtickRun(text, end);
+                    if (len <= MMUMarkdownMaxBackticks && !md->backticksMissing[len]) {
+                        size_t last = i;
+                        const char* closing = findBackticks(md, &last, text + len, len);
+                        if (closing) {
+                            MMUMarkdownAddText(md, plain, text);
+                            MMUMarkdownAddCode(md, i, text + len, last, closing);
+                            // Carry on after the span, which may be lines on
+                            if (last != i) {
+                                i = last;
+                                line = md->lines + i;
+                                end = line->text + line->len;
+                                hardBreak = line->hardBreak;
+                            }
+                            plain = text = closing + len;
+                            break;
+                        }
+                    }
+                    text += len;
+                    break;
+                case '[':
+                    MMUMarkdownAddText(md, plain, text);
+                    md->brackets = MMUMarkdownReserve(md, md->brackets, &md->bracketCapacity,
+                            md->bracketCount + 1, sizeof(size_t), MMUMarkdownInitialTokens);
+                    md->brackets[md->bracketCount++] =
+                        MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_OPEN_BRACKET, text, 1);
+                    plain = ++text;
+                    break;
+                case ']':
+                    MMUMarkdownAddText(md, plain, text);
+                    MMUMarkdownCloseBracket(md, &text, end);
+                    plain = text;
+                    break;
+                case '&':
+                    next = parseReference(text + 1, end, &codePoint);
+                    if (next) {
+                        MMUMarkdownAddText(md, plain, text);
+                        len = MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_CHARACTER, text, 0);
+                        md->tokens[len].codePoint = codePoint;
+                        plain = text = next;
+                    } else {
+                        ++text;
+                    }
+                    break;
+                case '<':
+                    next = parseAutolink(text + 1, end);
+                    if (next) {
+                        MMUMarkdownAddText(md, plain, text);
+                        MMUMarkdownAddToken(md, MMU_MARKDOWN_TOKEN_AUTOLINK, text + 1,
+                                (size_t)(next - text - 1));
+                        plain = text = next + 1;
+                    } else {
+                        ++text;
+                    }
+                    break;
+                default:
+                    ++text;
+                    while (text < end && !isSpecial(*text)) {
+                        ++text;
+                    }
+                    break;
+            }
+        }
+        MMUMarkdownAddText(md, plain, end);
+        if (i + 1 < md->lineCount) {
+            MMUMarkdownAddToken(md, hardBreak ? MMU_MARKDOWN_TOKEN_HARD_BREAK
+                    : MMU_MARKDOWN_TOKEN_SOFT_BREAK, "\n", hardBreak ? 0 : 1);
+        }
+    }
+    MMUMarkdownProcessEmphasis(md, 0);
+}
+
+// Copies a link destination into href, NUL terminated, with escapes and
+// character references decoded
+static const char* MMUMarkdownDecodeHref(MMUMarkdownParser* md, const char* text, size_t len) {
+    const char* end = text + len;
+    size_t hrefLen = 0;
+
+    // No reference is shorter than its UTF-8, so decoding never makes a
+    // destination longer
+    md->href = MMUMarkdownReserve(md, md->href, &md->hrefCapacity, len + 1, 1,
+            MMUMarkdownInitialHref);
+    while (text < end) {
+        unsigned int codePoint;
+        const char* next;
+
+        if (*text == '\\' && text + 1 < end && isPunctuation(text[1])) {
+            md->href[hrefLen++] = text[1];
+            text += 2;
+        } else if (*text == '&' && (next = parseReference(text + 1, end, &codePoint))) {
+            hrefLen += MMUEncodeUtf8(codePoint, md->href + hrefLen);
+            text = next;
+        } else {
+            md->href[hrefLen++] = *text++;
+        }
+    }
+    md->href[hrefLen] = '\0';
+    return md->href;
+}
+
+static const char* MMUMarkdownHref(MMUMarkdownParser* md, const MMUMarkdownToken* token) {
+    if (!MMUHtmlParserAttribute(md->options, md->linkElement)) {
+        return "";
+    }
+    return MMUMarkdownDecodeHref(md, token->text, token->len);
+}
+
+static void MMUMarkdownEmitInlines(MMUMarkdownParser* md) {
+    MMUBuilder* builder = md->builder;
+    size_t i;
+
+    MMUMarkdownTokenise(md);
+
+    for (i = 0; i < md->tokenCount && !builder->status; ++i) {
+        const MMUMarkdownToken* token = md->tokens + i;
+        size_t emphasis;
+        char encoded[4];
+
+        switch (token->type) {
+            case MMU_MARKDOWN_TOKEN_TEXT:
+                if (token->len) {
+                    MMUBuilderCountNode(builder);
+                    MMUBuilderAppendBorrowedText(builder, token->text, token->len);
+                }
+                break;
+            case MMU_MARKDOWN_TOKEN_CHARACTER:
+                MMUBuilderAppendText(builder, encoded, MMUEncodeUtf8(token->codePoint, encoded));
+                break;
+            case MMU_MARKDOWN_TOKEN_SOFT_BREAK:
+                MMUBuilderAppendText(builder, token->text, token->len);
+                break;
+            case MMU_MARKDOWN_TOKEN_HARD_BREAK:
+                MMUMarkdownOpenElement(md, md->breakElement, NULL);
+                MMUMarkdownCloseElement(md, md->breakElement);
+                break;
+            case MMU_MARKDOWN_TOKEN_DELIMITER:
+                for (emphasis = token->closes; emphasis != MMUMarkdownNone;
+                        emphasis = md->emphasis[emphasis].nextClose) {
+                    MMUMarkdownCloseElement(md, md->emphasis[emphasis].strong
+                            ? md->strongElement : md->emphasisElement);
+                }
+                if (token->count) {
+                    MMUBuilderAppendBorrowedText(builder, token->text + token->closed, token->count);
+                }
+                for (emphasis = token->opens; emphasis != MMUMarkdownNone;
+                        emphasis = md->emphasis[emphasis].nextOpen) {
+                    MMUMarkdownOpenElement(md, md->emphasis[emphasis].strong
+                            ? md->strongElement : md->emphasisElement, NULL);
+                }
+                break;
+            case MMU_MARKDOWN_TOKEN_OPEN_BRACKET:
+                MMUBuilderAppendBorrowedText(builder, token->text, token->len);
+                break;
+            case MMU_MARKDOWN_TOKEN_LINK_START:
+                MMUMarkdownOpenElement(md, md->linkElement, MMUMarkdownHref(md, token));
+                break;
+            case MMU_MARKDOWN_TOKEN_LINK_END:
+                MMUMarkdownCloseElement(md, md->linkElement);
+                break;
+            case MMU_MARKDOWN_TOKEN_AUTOLINK:
+                MMUMarkdownOpenElement(md, md->linkElement, MMUMarkdownHref(md, token));
+                MMUBuilderCountNode(builder);
+                MMUBuilderAppendBorrowedText(builder, token->text, token->len);
+                MMUMarkdownCloseElement(md, md->linkElement);
+                break;
+            case MMU_MARKDOWN_TOKEN_CODE_START:
+                MMUMarkdownOpenElement(md, md->codeElement, NULL);
+                break;
+            case MMU_MARKDOWN_TOKEN_CODE_END:
+                MMUMarkdownCloseElement(md, md->codeElement);
+                break;
+        }
+    }
+}
+
+MMUStatus mmuParseMarkdown(const char* markdown, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    return mmuParseMarkdownN(markdown, strlen(markdown), callbacks, options, callbackContext);
+}
+
+MMUStatus mmuParseMarkdownN(const char* markdown, size_t len, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext) {
+    const char* end = markdown + len;
+    MMUBuilder builder[1];
+    MMUMarkdownParser md[1];
+    MMUStatus status;
+
+    MMU_STATS_TIMER_START(options, totalStart);
+    MMUBuilderInit(builder, callbacks, options, callbackContext);
+    MMUBuilderCheckInputSize(builder, len);
+    MMUMarkdownParserInit(md, builder);
+
+    {
+        MMU_STATS_TIMER_START(options, parseStart);
+        while (markdown < end && !builder->status) {
+            const char* lineEnd = memchr(markdown, '\n', (size_t)(end - markdown));
+            const char* next = lineEnd ? lineEnd + 1 : end;
+
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+            if (lineEnd > markdown && lineEnd[-1] == '\r') {
+                --lineEnd;
+            }
+            MMUMarkdownParseLine(md, markdown, lineEnd);
+            markdown = next;
+        }
+        MMUMarkdownCloseParagraph(md);
+        MMUMarkdownCloseLists(md, 0);
+        MMU_STATS_TIMER_END(options, parseNanoseconds, parseStart);
+    }
+
+    MMUMarkdownParserDestroy(md);
+    status = MMUBuilderFinish(builder);
+    MMUBuilderDestroy(builder);
+    MMU_STATS_TIMER_END(options, totalNanoseconds, totalStart);
+    return status;
+}
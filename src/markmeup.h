@@ -25,10 +25,20 @@
 
 #include <stdlib.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 enum MMUTextStyle {
     MMU_TEXT_STYLE_BOLD = 1 << 0
   , MMU_TEXT_STYLE_ITALIC = 1 << 1
   , MMU_TEXT_STYLE_UNDERLINED = 1 << 2
+    // Not produced by any built-in tag, for use with MMUOptions.extraTags
+  , MMU_TEXT_STYLE_STRIKETHROUGH = 1 << 3
+  , MMU_TEXT_STYLE_MONOSPACE = 1 << 4
+  , MMU_TEXT_STYLE_HIGHLIGHTED = 1 << 5
+  , MMU_TEXT_STYLE_SUPERSCRIPT = 1 << 6
+  , MMU_TEXT_STYLE_SUBSCRIPT = 1 << 7
 };
 
 typedef struct MMUContext {
@@ -37,20 +47,606 @@ typedef struct MMUContext {
 } MMUContext;
 
 typedef struct MMUCallbacks {
+    // text is NUL terminated (but see MMU_OUTPUT_BORROWED_TEXT) and only
+    // valid until the callback returns. Runs are never empty, and two runs
+    // in a row only share a textContext when a link or list item boundary
+    // (or a very long run) lies between them.
     void (*appendText)(const char* text, size_t len, const MMUContext* textContext, void* callbackContext);
     void (*startLink)(const char* href, void* callbackContext);
     void (*endLink)(void* callbackContext);
     void (*startListItem)(int depth, unsigned int index, void* callbackContext);
     void (*endListItem)(void* callbackContext);
     void (*finish)(void* callbackContext);
+    // Optional, called instead of appendText with MMU_OUTPUT_UTF16_TEXT. The
+    // text is NUL terminated and len is in UTF-16 code units.
+    void (*appendTextUtf16)(const unsigned short* text, size_t len, const MMUContext* textContext, void* callbackContext);
 } MMUCallbacks;
 
+enum MMUHtmlBackend {
+    // libxml2's HTML parser (the default)
+    MMU_HTML_BACKEND_LIBXML2 = 0
+    // The built-in tokenizer, which only understands the supported subset
+  , MMU_HTML_BACKEND_NATIVE = 1
+};
+
+enum MMUOutputFlags {
+    // MMUDocument spans and links also carry offsets in UTF-16 code units,
+    // as used by NSAttributedString and Spannable
+    MMU_OUTPUT_UTF16_OFFSETS = 1 << 0
+    // Text is transcoded to UTF-16 and passed to appendTextUtf16 (or stored
+    // in MMUDocument.utf16Text), implies MMU_OUTPUT_UTF16_OFFSETS
+  , MMU_OUTPUT_UTF16_TEXT = 1 << 1
+    // appendText may be passed text which points straight into the input
+    // (or libxml2's tree) instead of a copy. Such text is not NUL terminated,
+    // so only the first len bytes may be read. Like all text passed to
+    // appendText it is only valid until the callback returns.
+  , MMU_OUTPUT_BORROWED_TEXT = 1 << 2
+    // A preview (see MMUOptions.previewLength) is cut at the end of the last
+    // whole word which fits rather than in the middle of one
+  , MMU_OUTPUT_PREVIEW_WORDS = 1 << 3
+    // Styles and headings are ignored and text is only flushed when the
+    // builder's buffer fills up, so appendText gets few, large runs with the
+    // default context. Links and list items are still reported, in order,
+    // but no longer line up with the text. Used by mmuExtractText.
+  , MMU_OUTPUT_PLAIN_TEXT = 1 << 4
+    // Each run of blanks in the text (spaces, tabs, newlines, carriage
+    // returns and form feeds) becomes a single space, and blanks next
+    // to separators or at the start or end of the document are dropped.
+    // Text inside <pre> is kept as it is. With MMU_OUTPUT_BORROWED_TEXT,
+    // text which needed no collapsing is still borrowed.
+  , MMU_OUTPUT_COLLAPSE_WHITESPACE = 1 << 5
+    // Links are treated like unrecognised elements, their text is kept but
+    // hrefs aren't looked up and startLink and endLink aren't called. For
+    // callers with no use for links, such as markmeup.hpp's sinks without
+    // link handlers.
+  , MMU_OUTPUT_IGNORE_LINKS = 1 << 6
+};
+
+// Returned by the parse functions. Anything but MMU_STATUS_OK means that
+// the parse was cut short, though the callbacks still ended with finish
+// (after endLink and endListItem for anything left open), so whatever was
+// produced up to that point is well formed.
+typedef enum MMUStatus {
+    MMU_STATUS_OK = 0
+  , MMU_STATUS_INPUT_TOO_LARGE
+  , MMU_STATUS_TOO_MANY_NODES
+  , MMU_STATUS_TOO_DEEP
+  , MMU_STATUS_OUTPUT_TOO_LARGE
+  , MMU_STATUS_TOO_MANY_LINKS
+  , MMU_STATUS_TIMED_OUT
+    // Only from mmuParseHtmlFile/mmuParseHtmlFd, see errno
+  , MMU_STATUS_IO_ERROR
+    // Not an error, the document was longer than MMUOptions.previewLength
+  , MMU_STATUS_PREVIEW_TRUNCATED
+} MMUStatus;
+
+// Budgets for hostile input, each 0 for no limit. A parse which exceeds one
+// stops with the matching MMUStatus.
+typedef struct MMULimits {
+    size_t maxInputBytes;
+    // Elements and text nodes
+    size_t maxNodes;
+    // Element nesting, counted like MMUOptions.maxDepth. Unlike maxDepth,
+    // which only stops styling, going deeper than this ends the parse.
+    unsigned int maxDepth;
+    // Text passed to appendText, in bytes of UTF-8. The text is cut at the
+    // last whole character which fits.
+    size_t maxOutputBytes;
+    size_t maxLinks;
+    // Wall clock time since the parser was created or reset, checked every
+    // few hundred nodes. libxml2 builds its tree before markmeup sees any
+    // of it, so with that back-end the time spent there can only be bounded
+    // through maxInputBytes.
+    unsigned long timeoutMilliseconds;
+} MMULimits;
+
+// Maps an additional element (e.g. "code") to text style bits
+typedef struct MMUTagStyle {
+    // Lower case
+    const char* tagName;
+    unsigned char textStyle;
+} MMUTagStyle;
+
+// Memory hooks. Each function receives userData as its last argument.
+// reallocate(NULL, ...) must behave like allocate and deallocate(NULL, ...)
+// must do nothing.
+typedef struct MMUAllocator {
+    void* (*allocate)(size_t size, void* userData);
+    void* (*reallocate)(void* ptr, size_t size, void* userData);
+    void (*deallocate)(void* ptr, void* userData);
+    void* userData;
+} MMUAllocator;
+
+// Instrumentation, only collected when markmeup is built with
+// MMU_ENABLE_STATS (make STATS=1). Every parse adds to the counters, so
+// zero the struct first to look at a single document. A struct must only
+// be used by one thread at a time, use mmuStatsMerge to combine them.
+typedef struct MMUStats {
+    size_t documents;
+    // Elements and text nodes seen by the html front-end
+    size_t nodesVisited;
+    size_t elementsRecognised;
+    size_t elementsIgnored;
+    size_t flushes;
+    size_t bytesEmitted;
+    size_t bufferReallocations;
+    unsigned int maxContextDepth;
+    unsigned int maxListDepth;
+
+    // Monotonic clock, in nanoseconds. parse is the html parser itself
+    // (htmlReadDoc, libxml2's push parser or the native tokenizer, the
+    // latter two including the builder work they drive), walk is the
+    // libxml2 tree walk and callbacks is the time spent inside
+    // MMUCallbacks, which is included in the other two.
+    unsigned long long parseNanoseconds;
+    unsigned long long walkNanoseconds;
+    unsigned long long callbackNanoseconds;
+    unsigned long long totalNanoseconds;
+} MMUStats;
+
+void mmuStatsMerge(MMUStats* into, const MMUStats* from);
+
 typedef struct MMUOptions {
     const char* lineSeparator;
     const char* paragraphSeparator;
+    int htmlBackend;
+    // Extra elements to recognise, these override the built-in ones
+    const MMUTagStyle* extraTags;
+    size_t extraTagCount;
+    // Deepest element nesting to style, 0 for the default (and maximum) of
+    // 127. Elements nested deeper are ignored but their text is kept.
+    unsigned int maxDepth;
+    // MMUOutputFlags
+    unsigned int outputFlags;
+    // Used for all of markmeup's own memory, NULL for malloc/realloc/free.
+    // libxml2 only supports process wide hooks, see xmlMemSetup.
+    const MMUAllocator* allocator;
+    // Optional, see MMUStats
+    MMUStats* stats;
+    // Encoding of the input as understood by libxml2 (e.g. "ISO-8859-1"),
+    // NULL for UTF-8. Output is always UTF-8. The native tokenizer only
+    // reads UTF-8, so other encodings are parsed with libxml2.
+    const char* encoding;
+    // Optional, see MMULimits
+    const MMULimits* limits;
+    // Stop once this many characters (code points, separators included)
+    // have been produced, 0 for the whole document. Input past that point
+    // isn't parsed at all. A document which gets cut short ends with
+    // previewEllipsis (e.g. "\u2026", NULL for none), which isn't counted.
+    // A link the cut falls in front of, before any of its text, is left
+    // out, so the ellipsis never ends up alone inside one.
+    size_t previewLength;
+    const char* previewEllipsis;
+    // Initial size of the text buffer, which is allocated on first use and
+    // grows by doubling, 0 for 4KB. Lower it when many parsers are kept alive.
+    size_t bufferSize;
 } MMUOptions;
 
-void mmuParseHtml(const char* html, const MMUCallbacks* callbacks,
+MMUStatus mmuParseHtml(const char* html, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext);
+// As mmuParseHtml, for len bytes which needn't be NUL terminated
+MMUStatus mmuParseHtmlN(const char* html, size_t len, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext);
+// Parse a file without copying it into memory first. Regular files are
+// mapped and parsed whole. Anything else (pipes, sockets) is read from the
+// current position and fed to libxml2's push parser as it arrives, or
+// collected in memory for the native tokenizer. The fd isn't closed.
+// Returns MMU_STATUS_IO_ERROR with errno set if the input couldn't be
+// opened or read. Like any other failed parse it still ends with finish:
+// a read error part way through parses what was read before it, and an
+// input which couldn't be opened gives an empty document.
+MMUStatus mmuParseHtmlFile(const char* path, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext);
+MMUStatus mmuParseHtmlFd(int fd, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext);
+
+// Parses UTF-8 Markdown (emphasis, strong emphasis, inline links and
+// autolinks, code spans, paragraphs, hard breaks, lists and ATX and setext
+// headings) straight into the callbacks, without going through html. The
+// result is the same as for the equivalent html, except that headings are
+// separated from the text before them like paragraphs, and that list items
+// start like those of a tight list even in a loose one, whose first block
+// html would separate. htmlBackend and encoding are ignored.
+MMUStatus mmuParseMarkdown(const char* markdown, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext);
+MMUStatus mmuParseMarkdownN(const char* markdown, size_t len, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext);
+
+// A run of text with the same attributes
+typedef struct MMUSpan {
+    size_t start;
+    size_t length;
+    // Only set with MMU_OUTPUT_UTF16_OFFSETS or MMU_OUTPUT_UTF16_TEXT
+    size_t utf16Start;
+    size_t utf16Length;
+    MMUContext context;
+    // Index into MMUDocument.links, or -1 if the text isn't part of a link
+    int linkIndex;
+} MMUSpan;
+
+typedef struct MMULink {
+    // Offset of the NUL terminated href in MMUDocument.hrefs, see
+    // mmuDocumentGetHref
+    size_t hrefOffset;
+    // Range of the text covered by the link
+    size_t start;
+    size_t length;
+    size_t utf16Start;
+    size_t utf16Length;
+} MMULink;
+
+// The whole output of a parse: a single NUL terminated UTF-8 buffer, the
+// spans covering it in order and the links they refer to. Adjacent text
+// with the same attributes always shares one span.
+//
+// With MMU_OUTPUT_UTF16_TEXT the text is stored in utf16Text instead, and
+// only the utf16 offsets of spans and links are meaningful.
+typedef struct MMUDocument {
+    char* text;
+    size_t textLen;
+    unsigned short* utf16Text;
+    // Also maintained for MMU_OUTPUT_UTF16_OFFSETS
+    size_t utf16Len;
+    MMUSpan* spans;
+    size_t spanCount;
+    MMULink* links;
+    size_t linkCount;
+    char* hrefs;
+    size_t hrefsLen;
+    // MMUOutputFlags, copied from the options by mmuParseHtmlDocument. Set
+    // it directly when filling a document through mmuDocumentCallbacks.
+    unsigned int outputFlags;
+    // NULL (the default) for the C heap, may be set after mmuDocumentInit.
+    // Unlike MMUOptions.allocator it is used for the lifetime of the
+    // document, so it shouldn't be an arena which is reset between parses.
+    const MMUAllocator* allocator;
+
+    // Private
+    size_t textCapacity;
+    size_t utf16TextCapacity;
+    size_t spanCapacity;
+    size_t linkCapacity;
+    size_t hrefsCapacity;
+    int openLink;
+} MMUDocument;
+
+// Callbacks which fill the MMUDocument passed as callbackContext, for use
+// with MMUHtmlParser or any other producer of callbacks
+extern const MMUCallbacks mmuDocumentCallbacks;
+
+void mmuDocumentInit(MMUDocument* document);
+void mmuDocumentDestroy(MMUDocument* document);
+// Empties the document but keeps its memory for the next parse
+void mmuDocumentClear(MMUDocument* document);
+const char* mmuDocumentGetHref(const MMUDocument* document, size_t linkIndex);
+
+// Replaces the contents of document with the result of parsing html. A
+// document which is reused for several parses stops allocating once its
+// buffers are large enough.
+MMUStatus mmuParseHtmlDocument(const char* html, const MMUOptions* options,
+        MMUDocument* document);
+MMUStatus mmuParseHtmlDocumentN(const char* html, size_t len, const MMUOptions* options,
+        MMUDocument* document);
+
+// Just the text of a document, with separators, for indexing and the like
+typedef struct MMUText {
+    // NUL terminated
+    char* text;
+    size_t textLen;
+    // The href of every link in document order, each NUL terminated
+    char* hrefs;
+    size_t hrefsLen;
+    size_t hrefCount;
+    // As MMUDocument.allocator
+    const MMUAllocator* allocator;
+
+    // Private
+    size_t textCapacity;
+    size_t hrefsCapacity;
+} MMUText;
+
+// Callbacks which fill the MMUText passed as callbackContext
+extern const MMUCallbacks mmuTextCallbacks;
+
+void mmuTextInit(MMUText* text);
+void mmuTextDestroy(MMUText* text);
+// Empties text but keeps its memory for the next parse
+void mmuTextClear(MMUText* text);
+
+// Replaces the contents of text with the text of html, parsed with
+// MMU_OUTPUT_PLAIN_TEXT added to options->outputFlags. Add
+// MMU_OUTPUT_COLLAPSE_WHITESPACE as well to normalise blanks.
+MMUStatus mmuExtractText(const char* html, const MMUOptions* options, MMUText* text);
+
+// Parses count documents on the threads of a pool, the calling thread
+// included. Each thread keeps one parser for the batch, reset between
+// documents. The callbacks of a document all run on the same thread, with
+// callbackContexts[index] (or NULL if callbackContexts is NULL), finish
+// signalling that it is complete, but different documents run concurrently
+// in no particular order. options->allocator must be thread safe, stats are
+// collected per thread and merged into options->stats at the end. If
+// statuses isn't NULL it receives the MMUStatus of each document.
+//
+// A pool's threads wait for work in between batches, so a service which
+// parses many small batches only starts them once. A pool runs one batch
+// at a time, batches passed to it by several threads take turns.
+typedef struct MMUBatchPool MMUBatchPool;
+
+// threadCount counts the calling thread, 0 for one per CPU. allocator (NULL
+// for the C heap) is only used for the pool itself.
+MMUBatchPool* mmuBatchPoolCreate(unsigned int threadCount, const MMUAllocator* allocator);
+// No batch may be running on the pool
+void mmuBatchPoolDestroy(MMUBatchPool* pool);
+void mmuParseHtmlBatchPooled(MMUBatchPool* pool, const char* const* inputs, size_t count,
+        const MMUCallbacks* callbacks, const MMUOptions* options,
+        void* const* callbackContexts, MMUStatus* statuses);
+// As mmuParseHtmlBatchPooled, but fills documents[i] with the result for
+// inputs[i]. The documents must have been initialised.
+void mmuParseHtmlDocumentBatchPooled(MMUBatchPool* pool, const char* const* inputs, size_t count,
+        const MMUOptions* options, MMUDocument* documents, MMUStatus* statuses);
+
+// One-off batches on a pool of threadCount threads (0 for one per CPU, and
+// never more than count), which is created and destroyed by the call
+void mmuParseHtmlBatch(const char* const* inputs, size_t count,
+        const MMUCallbacks* callbacks, const MMUOptions* options,
+        void* const* callbackContexts, MMUStatus* statuses, unsigned int threadCount);
+void mmuParseHtmlDocumentBatch(const char* const* inputs, size_t count,
+        const MMUOptions* options, MMUDocument* documents, MMUStatus* statuses,
+        unsigned int threadCount);
+
+// Parses one large document using up to threadCount threads (0 for one per
+// CPU), with exactly the same result as mmuParseHtml. The input is cut in
+// front of block level tags and the pieces are tokenized concurrently, but
+// the callbacks all run on the calling thread, in order. A piece whose parse
+// turns out to depend on elements left open before it (such as a <p> which
+// is only closed by the next block) is parsed again sequentially. Only the
+// native back-end can be split, anything else and documents under 128KB are
+// handed to mmuParseHtml, as are previews and documents parsed with
+// MMUOptions.limits.
+// options->allocator must be thread safe.
+MMUStatus mmuParseHtmlParallel(const char* html, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext, unsigned int threadCount);
+MMUStatus mmuParseHtmlDocumentParallel(const char* html, const MMUOptions* options,
+        MMUDocument* document, unsigned int threadCount);
+
+// A compact encoding of the callbacks made by a parse, for storing results
+// and replaying them later without any html parsing. The writer is a
+// callback sink like MMUDocument; mmuBinaryReplay reads an encoding in
+// place (e.g. straight from mmap), handing out text and hrefs which point
+// into it, so it must stay mapped while the callbacks run. UTF-16 text
+// isn't supported, the writer only stores UTF-8.
+enum {
+    MMU_BINARY_VERSION = 1
+};
+
+typedef struct MMUBinaryWriter {
+    // The encoding, complete once finish has been called
+    unsigned char* data;
+    size_t len;
+    // NULL (the default) for the C heap, may be set after
+    // mmuBinaryWriterInit
+    const MMUAllocator* allocator;
+
+    // Private
+    size_t capacity;
+    unsigned char* text;
+    size_t textLen;
+    size_t textCapacity;
+    unsigned char* strings;
+    size_t stringsLen;
+    size_t stringsCapacity;
+    unsigned char* events;
+    size_t eventsLen;
+    size_t eventsCapacity;
+} MMUBinaryWriter;
+
+extern const MMUCallbacks mmuBinaryWriterCallbacks;
+
+void mmuBinaryWriterInit(MMUBinaryWriter* writer);
+void mmuBinaryWriterDestroy(MMUBinaryWriter* writer);
+// Starts a new encoding, keeping the memory
+void mmuBinaryWriterClear(MMUBinaryWriter* writer);
+MMUStatus mmuParseHtmlBinary(const char* html, const MMUOptions* options, MMUBinaryWriter* writer);
+
+// Makes the callbacks recorded in an encoding of len bytes and returns 1,
+// or returns 0 as soon as the data turns out to be truncated, corrupt or of
+// another version, without calling finish
+int mmuBinaryReplay(const void* data, size_t len, const MMUCallbacks* callbacks,
+        void* callbackContext);
+
+// A bounded cache of parse results for inputs which are parsed again and
+// again, such as templated fragments. Entries are keyed by the input and
+// every option which affects the output, and store the callbacks made so
+// that a hit replays them without parsing. The cache is split into
+// shardCount independently locked shards (0 for a default of 16), each
+// evicting with the CLOCK approximation of LRU once it holds more than its
+// share of capacity bytes. allocator (NULL for the C heap) must be thread
+// safe if the cache is shared between threads.
+typedef struct MMUCache MMUCache;
+
+typedef struct MMUCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t insertions;
+    size_t evictions;
+    // Currently cached
+    size_t entries;
+    size_t bytes;
+} MMUCacheStats;
+
+MMUCache* mmuCacheCreate(size_t capacity, unsigned int shardCount, const MMUAllocator* allocator);
+// No parse may be using the cache
+void mmuCacheDestroy(MMUCache* cache);
+void mmuCacheClear(MMUCache* cache);
+void mmuCacheGetStats(MMUCache* cache, MMUCacheStats* stats);
+
+// As mmuParseHtml, but answered from cache when possible. On a miss the
+// document is parsed as usual and its callbacks are recorded on the way.
+// Replayed text is always a NUL terminated copy, and MMUOptions.stats only
+// counts documents which were actually parsed. Parses with MMUOptions.limits
+// bypass the cache, neither answered from it nor stored, since a stored
+// result can't tell whether it fits them.
+MMUStatus mmuParseHtmlCached(MMUCache* cache, const char* html, const MMUCallbacks* callbacks,
         const MMUOptions* options, void* callbackContext);
 
+// A pull alternative to callbacks: the reader hands out the same text
+// runs, link and list item boundaries one small tagged struct at a time,
+// parsing only as far as it needs to (a slice of the input at a time with
+// the native tokenizer, a few nodes of libxml2's tree at a time otherwise)
+// whenever its queue of events runs dry. The events are exactly what
+// mmuParseHtml would call back with. Consumers can therefore interleave parsing with their
+// own work, stop early, or take events in batches with mmuReaderRead
+// without any indirect calls:
+//
+//     MMUReader* reader = mmuReaderCreate(html, len, &options);
+//     MMUEvent event;
+//     while (mmuReaderNext(reader, &event)) {
+//         ...
+//     }
+//     mmuReaderDestroy(reader);
+//
+// The input and options must outlive the reader. MMU_OUTPUT_UTF16_TEXT is
+// ignored, and a timeout in MMUOptions.limits runs from mmuReaderCreate.
+typedef enum MMUEventType {
+    MMU_EVENT_TEXT = 0
+    // text is the href
+  , MMU_EVENT_START_LINK
+  , MMU_EVENT_END_LINK
+  , MMU_EVENT_START_LIST_ITEM
+  , MMU_EVENT_END_LIST_ITEM
+} MMUEventType;
+
+typedef struct MMUEvent {
+    MMUEventType type;
+    // Text runs and hrefs. They are NUL terminated, except for text borrowed
+    // from the input with MMU_OUTPUT_BORROWED_TEXT (native tokenizer only),
+    // which stays valid as long as the input. Anything else stays valid
+    // until the reader next has to parse, so at least until the following
+    // call to mmuReaderNext or mmuReaderRead.
+    const char* text;
+    size_t len;
+    // Text runs only
+    MMUContext context;
+    // List items only
+    int depth;
+    unsigned int index;
+} MMUEvent;
+
+typedef struct MMUReader MMUReader;
+
+MMUReader* mmuReaderCreate(const char* html, size_t len, const MMUOptions* options);
+void mmuReaderDestroy(MMUReader* reader);
+// Fills event and returns 1, or returns 0 once the document is finished
+int mmuReaderNext(MMUReader* reader, MMUEvent* event);
+// Fills up to max events, returning how many. Fewer than max doesn't mean
+// that the document is finished, only 0 does.
+size_t mmuReaderRead(MMUReader* reader, MMUEvent* events, size_t max);
+// Whether the parse stopped at one of MMUOptions.limits or a preview,
+// final once mmuReaderNext has returned 0
+MMUStatus mmuReaderStatus(const MMUReader* reader);
+
+// Re-parsing of a document which is edited a little at a time, such as the
+// source of a live preview. The parser keeps an index of the blocks of the
+// last input, which is cut in front of block level and list item start
+// tags wherever no link or list item is open. Each block records where it
+// starts in the input and the output and the state it starts in (open
+// elements, the MMUContext stack and list numbering). An edit is parsed
+// again from the last block in front of it up to the first block behind it
+// which starts in the same state as before, so a typical edit costs the
+// same however long the document is:
+//
+//     MMUIncrementalParser* parser = mmuIncrementalParserCreate(&options);
+//     mmuIncrementalParserParse(parser, html, len, &callbacks, context);
+//     ...
+//     // One character typed at offset 120
+//     edit.start = 120;
+//     edit.removedLen = 0;
+//     edit.insertedLen = 1;
+//     mmuIncrementalParserEdit(parser, html, len, &edit, &callbacks, context, &delta);
+//     ...
+//     mmuIncrementalParserDestroy(parser);
+//
+// The callbacks made for an edit only cover the output which changed: it
+// replaces delta.removedLen bytes of the previous output at
+// delta.outputStart, and finish marks its end. Links and list items never
+// cross its edges: those replaced are exactly the ones which started in
+// the removed output, short of its end unless that is the end of the
+// previous output. The builder is flushed at every block, so text runs may
+// be split where mmuParseHtml would have joined them, but the text is the
+// same. Offsets count bytes of UTF-8 output, also with
+// MMU_OUTPUT_UTF16_TEXT.
+//
+// Only the native tokenizer can start in the middle of a document. With
+// libxml2, MMUOptions.limits or a preview every call parses the whole
+// document, as does an edit which doesn't fit the previous input. What
+// the options point to must outlive the parser, the input only has to
+// stay valid during each call.
+typedef struct MMUIncrementalParser MMUIncrementalParser;
+
+// removedLen bytes of the previous input at start were replaced by the
+// insertedLen bytes now at start
+typedef struct MMUEdit {
+    size_t start;
+    size_t removedLen;
+    size_t insertedLen;
+} MMUEdit;
+
+typedef struct MMUOutputDelta {
+    size_t outputStart;
+    size_t removedLen;
+    size_t insertedLen;
+} MMUOutputDelta;
+
+MMUIncrementalParser* mmuIncrementalParserCreate(const MMUOptions* options);
+void mmuIncrementalParserDestroy(MMUIncrementalParser* parser);
+// Parses a whole document, replacing the index
+MMUStatus mmuIncrementalParserParse(MMUIncrementalParser* parser, const char* html, size_t len,
+        const MMUCallbacks* callbacks, void* callbackContext);
+// html and len are the input after the edit. delta may be NULL.
+MMUStatus mmuIncrementalParserEdit(MMUIncrementalParser* parser, const char* html, size_t len,
+        const MMUEdit* edit, const MMUCallbacks* callbacks, void* callbackContext,
+        MMUOutputDelta* delta);
+
+// A bump allocator backed by a single block. Memory is handed out in order
+// and only given back by mmuArenaReset, apart from growing or freeing the
+// most recent allocation, which happens in place. Requests which don't fit
+// fall back to the heap and the block is enlarged to cover them at the next
+// reset, so a workload which parses documents of similar sizes settles at
+// no heap allocations at all:
+//
+//     mmuArenaInit(arena, 64 * 1024);
+//     options.allocator = &arena->allocator;
+//     for (each document) {
+//         mmuParseHtml(html, &callbacks, &options, context);
+//         mmuArenaReset(arena);
+//     }
+//     mmuArenaDestroy(arena);
+typedef struct MMUArena {
+    // Pass this as MMUOptions.allocator
+    MMUAllocator allocator;
+
+    // Private
+    char* block;
+    size_t capacity;
+    size_t used;
+    // Offset of the most recent allocation
+    size_t last;
+    // Bytes requested since the last reset which didn't fit
+    size_t overflow;
+} MMUArena;
+
+void mmuArenaInit(MMUArena* arena, size_t capacity);
+void mmuArenaDestroy(MMUArena* arena);
+// Invalidates everything allocated from the arena, so parsers using it must
+// have been destroyed
+void mmuArenaReset(MMUArena* arena);
+
+// Number of UTF-16 code units in len bytes of UTF-8, for callback users
+// who need UTF-16 offsets without the text
+size_t mmuUtf16Length(const char* text, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,339 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef MMU_MARKMEUP_HPP
+#define MMU_MARKMEUP_HPP
+
+// A header-only C++17 layer over markmeup.h. Output goes to a sink, any
+// class with some of these members:
+//
+//     void text(std::string_view text, const MMUContext& context);
+//     void startLink(std::string_view href);
+//     void endLink();
+//     void startListItem(int depth, unsigned int index);
+//     void endListItem();
+//     void finish();
+//
+// markmeup::parse pulls events from an MMUReader in batches and hands each
+// to the matching member. This is a convenience rather than a faster path:
+// the reader fills its batches through callbacks of its own, so every
+// event still costs the same indirect calls as MMUCallbacks would. Events
+// the sink has no member for are dropped, and a sink with neither link
+// member parses with MMU_OUTPUT_IGNORE_LINKS, which skips looking up hrefs.
+//
+//     struct Counter {
+//         size_t bytes = 0;
+//         void text(std::string_view text, const MMUContext&) { bytes += text.size(); }
+//     };
+//
+//     Counter counter;
+//     markmeup::parse(html, counter);
+
+#include "markmeup.h"
+
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace markmeup {
+
+// MMUOptions with "\n" and "\n\n" as the line and paragraph separators and
+// everything else zeroed
+struct Options : MMUOptions {
+    Options() : MMUOptions() {
+        lineSeparator = "\n";
+        paragraphSeparator = "\n\n";
+    }
+};
+
+namespace detail {
+
+template <class Sink, class = void>
+struct HasText : std::false_type {};
+template <class Sink>
+struct HasText<Sink, std::void_t<decltype(std::declval<Sink&>().text(
+        std::string_view(), std::declval<const MMUContext&>()))>> : std::true_type {};
+
+template <class Sink, class = void>
+struct HasStartLink : std::false_type {};
+template <class Sink>
+struct HasStartLink<Sink, std::void_t<decltype(std::declval<Sink&>().startLink(
+        std::string_view()))>> : std::true_type {};
+
+template <class Sink, class = void>
+struct HasEndLink : std::false_type {};
+template <class Sink>
+struct HasEndLink<Sink, std::void_t<decltype(std::declval<Sink&>().endLink())>>
+        : std::true_type {};
+
+template <class Sink, class = void>
+struct HasStartListItem : std::false_type {};
+template <class Sink>
+struct HasStartListItem<Sink, std::void_t<decltype(std::declval<Sink&>().startListItem(0, 0u))>>
+        : std::true_type {};
+
+template <class Sink, class = void>
+struct HasEndListItem : std::false_type {};
+template <class Sink>
+struct HasEndListItem<Sink, std::void_t<decltype(std::declval<Sink&>().endListItem())>>
+        : std::true_type {};
+
+template <class Sink, class = void>
+struct HasFinish : std::false_type {};
+template <class Sink>
+struct HasFinish<Sink, std::void_t<decltype(std::declval<Sink&>().finish())>>
+        : std::true_type {};
+
+template <class Sink>
+constexpr bool handlesLinks = HasStartLink<Sink>::value || HasEndLink<Sink>::value;
+
+// The options a sink is parsed with
+template <class Sink>
+inline MMUOptions sinkOptions(const MMUOptions& options) {
+    MMUOptions result = options;
+    if constexpr (!handlesLinks<Sink>) {
+        result.outputFlags |= MMU_OUTPUT_IGNORE_LINKS;
+    }
+    return result;
+}
+
+template <class Sink>
+inline void dispatch(Sink& sink, const MMUEvent& event) {
+    switch (event.type) {
+        case MMU_EVENT_TEXT:
+            if constexpr (HasText<Sink>::value) {
+                sink.text(std::string_view(event.text, event.len), event.context);
+            }
+            break;
+        case MMU_EVENT_START_LINK:
+            if constexpr (HasStartLink<Sink>::value) {
+                sink.startLink(std::string_view(event.text, event.len));
+            }
+            break;
+        case MMU_EVENT_END_LINK:
+            if constexpr (HasEndLink<Sink>::value) {
+                sink.endLink();
+            }
+            break;
+        case MMU_EVENT_START_LIST_ITEM:
+            if constexpr (HasStartListItem<Sink>::value) {
+                sink.startListItem(event.depth, event.index);
+            }
+            break;
+        case MMU_EVENT_END_LIST_ITEM:
+            if constexpr (HasEndListItem<Sink>::value) {
+                sink.endListItem();
+            }
+            break;
+    }
+}
+
+// Trampolines for the C entry points which only take callbacks
+template <class Sink>
+struct Callbacks {
+    static void appendText(const char* text, size_t len, const MMUContext* context, void* sink) {
+        if constexpr (HasText<Sink>::value) {
+            static_cast<Sink*>(sink)->text(std::string_view(text, len), *context);
+        }
+    }
+    static void startLink(const char* href, void* sink) {
+        if constexpr (HasStartLink<Sink>::value) {
+            static_cast<Sink*>(sink)->startLink(std::string_view(href));
+        }
+    }
+    static void endLink(void* sink) {
+        if constexpr (HasEndLink<Sink>::value) {
+            static_cast<Sink*>(sink)->endLink();
+        }
+    }
+    static void startListItem(int depth, unsigned int index, void* sink) {
+        if constexpr (HasStartListItem<Sink>::value) {
+            static_cast<Sink*>(sink)->startListItem(depth, index);
+        }
+    }
+    static void endListItem(void* sink) {
+        if constexpr (HasEndListItem<Sink>::value) {
+            static_cast<Sink*>(sink)->endListItem();
+        }
+    }
+    static void finish(void* sink) {
+        if constexpr (HasFinish<Sink>::value) {
+            static_cast<Sink*>(sink)->finish();
+        }
+    }
+
+    static constexpr MMUCallbacks table = {
+        appendText, startLink, endLink, startListItem, endListItem, finish, nullptr
+    };
+};
+
+} // namespace detail
+
+// An MMUCallbacks table calling a Sink passed as callbackContext, for the
+// C functions with no pull equivalent (files, Markdown, caches and so on)
+template <class Sink>
+inline const MMUCallbacks& callbacks() {
+    return detail::Callbacks<Sink>::table;
+}
+
+// Owns an MMUReader. The input must outlive it, as must whatever the
+// options point to (separators, extraTags, limits, the allocator), though
+// the options themselves are copied.
+class Reader {
+public:
+    Reader(std::string_view html, const MMUOptions& options = Options())
+        : reader_(mmuReaderCreate(html.data(), html.size(), &options)) {
+    }
+
+    Reader(Reader&& other) noexcept : reader_(std::exchange(other.reader_, nullptr)) {
+    }
+
+    Reader& operator=(Reader&& other) noexcept {
+        if (this != &other) {
+            reset();
+            reader_ = std::exchange(other.reader_, nullptr);
+        }
+        return *this;
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    ~Reader() {
+        reset();
+    }
+
+    bool next(MMUEvent& event) {
+        return mmuReaderNext(reader_, &event) != 0;
+    }
+
+    std::size_t read(MMUEvent* events, std::size_t max) {
+        return mmuReaderRead(reader_, events, max);
+    }
+
+    MMUStatus status() const {
+        return mmuReaderStatus(reader_);
+    }
+
+    MMUReader* get() const noexcept {
+        return reader_;
+    }
+
+private:
+    void reset() noexcept {
+        if (reader_) {
+            mmuReaderDestroy(reader_);
+            reader_ = nullptr;
+        }
+    }
+
+    MMUReader* reader_;
+};
+
+// Owns an MMUDocument, which keeps its memory across parses
+class Document {
+public:
+    Document() {
+        mmuDocumentInit(&document_);
+    }
+
+    Document(Document&& other) noexcept : document_(other.document_) {
+        mmuDocumentInit(&other.document_);
+        other.document_.allocator = document_.allocator;
+    }
+
+    Document& operator=(Document&& other) noexcept {
+        if (this != &other) {
+            mmuDocumentDestroy(&document_);
+            document_ = other.document_;
+            mmuDocumentInit(&other.document_);
+            other.document_.allocator = document_.allocator;
+        }
+        return *this;
+    }
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    ~Document() {
+        mmuDocumentDestroy(&document_);
+    }
+
+    MMUStatus parse(std::string_view html, const MMUOptions& options = Options()) {
+        return mmuParseHtmlDocumentN(html.data(), html.size(), &options, &document_);
+    }
+
+    std::string_view text() const {
+        return std::string_view(document_.text ? document_.text : "", document_.textLen);
+    }
+
+    std::string_view href(std::size_t linkIndex) const {
+        return mmuDocumentGetHref(&document_, linkIndex);
+    }
+
+    const MMUDocument& get() const noexcept {
+        return document_;
+    }
+
+    MMUDocument& get() noexcept {
+        return document_;
+    }
+
+private:
+    MMUDocument document_;
+};
+
+// Parses html into sink, returning the status of the parse
+template <class Sink>
+inline MMUStatus parse(std::string_view html, Sink& sink, const MMUOptions& options = Options()) {
+    enum { BatchSize = 64 };
+    MMUOptions parseOptions = detail::sinkOptions<Sink>(options);
+    Reader reader(html, parseOptions);
+    MMUEvent events[BatchSize];
+    std::size_t count;
+
+    while ((count = reader.read(events, BatchSize)) != 0) {
+        for (std::size_t i = 0; i < count; ++i) {
+            detail::dispatch(sink, events[i]);
+        }
+    }
+    if constexpr (detail::HasFinish<Sink>::value) {
+        sink.finish();
+    }
+    return reader.status();
+}
+
+// Parses Markdown into sink. There is no pull reader for Markdown, so the
+// sink is called through callbacks<Sink>(), though links are still skipped
+// for sinks without link members.
+template <class Sink>
+inline MMUStatus parseMarkdown(std::string_view markdown, Sink& sink,
+        const MMUOptions& options = Options()) {
+    MMUOptions parseOptions = detail::sinkOptions<Sink>(options);
+    return mmuParseMarkdownN(markdown.data(), markdown.size(), &callbacks<Sink>(),
+            &parseOptions, &sink);
+}
+
+} // namespace markmeup
+
+#endif
@@ -0,0 +1,272 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "allocator.h"
+#include "batch.h"
+#include "document.h"
+#include "html-parser.h"
+#include "html-tokenizer.h"
+#include "parallel.h"
+#include "stats.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// A large document is cut in front of block level start tags into chunks
+// which are tokenized concurrently. Every chunk but the first is parsed
+// speculatively: it assumes that it starts inside the body with nothing
+// open, and records its builder calls instead of making them. The calling
+// thread then walks the chunks in order with the real tokenizer state,
+// replaying the calls of each chunk whose assumption held (or made no
+// difference, see MMUHtmlTokenizerCanContinue) and parsing the others
+// itself. All output goes through one builder on the calling thread, so
+// offsets, separators and runs come out exactly as in a sequential parse.
+
+enum {
+    // Smaller documents aren't worth the threads
+    MMUParallelMinChunkSize = 64 * 1024,
+    // Chunks per thread, so that a thread which finishes early can help
+    MMUParallelChunksPerThread = 4
+};
+
+typedef struct MMUParallelChunk {
+    const char* start;
+    const char* stop;
+    MMUHtmlTokenizer tokenizer;
+    MMUHtmlEventLog events;
+    // Stats are only merged for chunks whose result is used
+    MMUOptions options;
+    MMUStats stats;
+    int done;
+} MMUParallelChunk;
+
+typedef struct MMUParallelParse {
+    const char* html;
+    size_t len;
+    MMUParallelChunk* chunks;
+    size_t chunkCount;
+    atomic_size_t next;
+    pthread_mutex_t mutex;
+    pthread_cond_t chunkDone;
+} MMUParallelParse;
+
+// Picks up to chunkCount chunks of roughly equal size, returning how many
+// it found
+static size_t planChunks(MMUParallelParse* parse, size_t chunkCount) {
+    const char* end = parse->html + parse->len;
+    const char* start = parse->html;
+    size_t count = 0;
+    size_t i;
+
+    for (i = 1; i <= chunkCount; ++i) {
+        const char* stop = end;
+        if (i < chunkCount) {
+            const char* target = parse->html + parse->len / chunkCount * i;
+            stop = MMUHtmlFindBlockStart(target > start ? target : start + 1, end, 0);
+            if (stop == end) {
+                // No more cut points, the rest is one chunk
+                i = chunkCount;
+            }
+        }
+        parse->chunks[count].start = start;
+        parse->chunks[count].stop = stop;
+        ++count;
+        start = stop;
+    }
+    return count;
+}
+
+static void parseChunk(MMUParallelParse* parse, MMUParallelChunk* chunk) {
+    MMUHtmlTokenizer* tokenizer = &chunk->tokenizer;
+
+    MMU_STATS_TIMER_START(&chunk->options, parseStart);
+    MMUHtmlEventLogInit(&chunk->events, &chunk->options);
+    MMUHtmlTokenizerInitRecording(tokenizer, &chunk->options, &chunk->events);
+    MMUHtmlTokenizerStart(tokenizer, parse->html, parse->len);
+    if (chunk != parse->chunks) {
+        MMUHtmlTokenizerSpeculate(tokenizer, chunk->start);
+    }
+    MMUHtmlTokenizerParseUntil(tokenizer, chunk->stop);
+    MMU_STATS_TIMER_END(&chunk->options, parseNanoseconds, parseStart);
+
+    pthread_mutex_lock(&parse->mutex);
+    chunk->done = 1;
+    pthread_cond_broadcast(&parse->chunkDone);
+    pthread_mutex_unlock(&parse->mutex);
+}
+
+// Parses the next unclaimed chunk, if there is one
+static int parseNextChunk(MMUParallelParse* parse) {
+    size_t index = atomic_fetch_add_explicit(&parse->next, 1, memory_order_relaxed);
+    if (index >= parse->chunkCount) {
+        return 0;
+    }
+    parseChunk(parse, parse->chunks + index);
+    return 1;
+}
+
+static void* runWorker(void* data) {
+    MMUParallelParse* parse = (MMUParallelParse*)data;
+    while (parseNextChunk(parse)) {
+    }
+    return NULL;
+}
+
+// Called on the calling thread, which helps with the parsing until the
+// chunk it needs next is ready
+static void waitForChunk(MMUParallelParse* parse, MMUParallelChunk* chunk) {
+    int done;
+
+    for (;;) {
+        pthread_mutex_lock(&parse->mutex);
+        done = chunk->done;
+        pthread_mutex_unlock(&parse->mutex);
+        if (done || !parseNextChunk(parse)) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&parse->mutex);
+    while (!chunk->done) {
+        pthread_cond_wait(&parse->chunkDone, &parse->mutex);
+    }
+    pthread_mutex_unlock(&parse->mutex);
+}
+
+static void stitchChunk(MMUParallelParse* parse, MMUHtmlTokenizer* tokenizer,
+        MMUParallelChunk* chunk, const MMUOptions* options) {
+    if (chunk == parse->chunks
+            || MMUHtmlTokenizerCanContinue(tokenizer, &chunk->tokenizer, chunk->start)) {
+        MMUHtmlEventLogReplay(&chunk->events, tokenizer->builder);
+        MMUHtmlTokenizerContinue(tokenizer, &chunk->tokenizer);
+        if (options->stats) {
+            mmuStatsMerge(options->stats, &chunk->stats);
+        }
+    } else {
+        MMU_STATS_TIMER_START(options, parseStart);
+        MMUHtmlTokenizerParseUntil(tokenizer, chunk->stop);
+        MMU_STATS_TIMER_END(options, parseNanoseconds, parseStart);
+    }
+
+    MMUHtmlTokenizerDestroy(&chunk->tokenizer);
+    MMUHtmlEventLogDestroy(&chunk->events);
+}
+
+static void parseParallel(MMUParallelParse* parse, MMUBuilder* builder, unsigned int threadCount) {
+    const MMUOptions* options = builder->options;
+    MMUHtmlTokenizer tokenizer[1];
+    pthread_t* threads;
+    size_t i;
+    unsigned int started;
+
+    for (i = 0; i < parse->chunkCount; ++i) {
+        MMUParallelChunk* chunk = parse->chunks + i;
+        chunk->options = *options;
+        memset(&chunk->stats, 0, sizeof(chunk->stats));
+        chunk->options.stats = options->stats ? &chunk->stats : NULL;
+        chunk->done = 0;
+    }
+    atomic_init(&parse->next, 0);
+    pthread_mutex_init(&parse->mutex, NULL);
+    pthread_cond_init(&parse->chunkDone, NULL);
+
+    threads = MMUAllocate(options->allocator, threadCount * sizeof(pthread_t));
+    for (started = 0; started + 1 < threadCount; ++started) {
+        if (pthread_create(threads + started, NULL, runWorker, parse) != 0) {
+            // The calling thread picks up the slack
+            break;
+        }
+    }
+
+    MMUHtmlTokenizerInit(tokenizer, builder);
+    MMUHtmlTokenizerStart(tokenizer, parse->html, parse->len);
+    for (i = 0; i < parse->chunkCount; ++i) {
+        waitForChunk(parse, parse->chunks + i);
+        stitchChunk(parse, tokenizer, parse->chunks + i, options);
+    }
+    MMUHtmlTokenizerFinish(tokenizer);
+    MMUHtmlTokenizerDestroy(tokenizer);
+
+    while (started > 0) {
+        pthread_join(threads[--started], NULL);
+    }
+    MMUDeallocate(options->allocator, threads);
+    pthread_cond_destroy(&parse->chunkDone);
+    pthread_mutex_destroy(&parse->mutex);
+}
+
+MMUStatus MMUParallelParseHtml(const char* html, size_t len, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext, unsigned int threadCount,
+        size_t minChunkSize) {
+    MMUParallelParse parse;
+    MMUBuilder builder[1];
+    size_t chunkCount;
+    MMUStatus status;
+
+    if (threadCount == 0) {
+        threadCount = MMUBatchDefaultThreadCount();
+    }
+    parse.html = html;
+    parse.len = len;
+    chunkCount = parse.len / (minChunkSize ? minChunkSize : 1);
+    if (chunkCount > (size_t)threadCount * MMUParallelChunksPerThread) {
+        chunkCount = (size_t)threadCount * MMUParallelChunksPerThread;
+    }
+
+    // Only the native tokenizer can start in the middle of a document, and
+    // limits and previews need a single builder which sees the nodes in
+    // order (a preview only parses the start of the document anyway)
+    if (!MMUHtmlParserUsesNative(options) || options->limits || options->previewLength
+            || threadCount < 2 || chunkCount < 2) {
+        return mmuParseHtmlN(html, len, callbacks, options, callbackContext);
+    }
+
+    {
+        MMU_STATS_TIMER_START(options, totalStart);
+        parse.chunks = MMUAllocate(options->allocator, chunkCount * sizeof(MMUParallelChunk));
+        parse.chunkCount = planChunks(&parse, chunkCount);
+
+        MMUBuilderInit(builder, callbacks, options, callbackContext);
+        parseParallel(&parse, builder, threadCount);
+        status = MMUBuilderFinish(builder);
+        MMUBuilderDestroy(builder);
+
+        MMUDeallocate(options->allocator, parse.chunks);
+        MMU_STATS_TIMER_END(options, totalNanoseconds, totalStart);
+    }
+    return status;
+}
+
+MMUStatus mmuParseHtmlParallel(const char* html, const MMUCallbacks* callbacks,
+        const MMUOptions* options, void* callbackContext, unsigned int threadCount) {
+    return MMUParallelParseHtml(html, strlen(html), callbacks, options, callbackContext,
+            threadCount, MMUParallelMinChunkSize);
+}
+
+MMUStatus mmuParseHtmlDocumentParallel(const char* html, const MMUOptions* options,
+        MMUDocument* document, unsigned int threadCount) {
+    MMUDocumentPrepare(document, options, strlen(html));
+    return mmuParseHtmlParallel(html, &mmuDocumentCallbacks, options, document, threadCount);
+}
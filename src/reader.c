@@ -0,0 +1,283 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "allocator.h"
+#include "html-parser.h"
+#include "html-tokenizer.h"
+
+#include <limits.h>
+#include <string.h>
+
+// The reader drives an ordinary MMUHtmlParser whose callbacks append to a
+// queue instead of calling out. Whenever the queue runs dry the parse is
+// taken one step further: the native tokenizer through the next slice of
+// the input, the walk of libxml2's tree through the next few nodes. The
+// tree is what mmuParseHtml walks too, so the events are the same; only
+// documents too large for it are fed to libxml2's push parser a slice at a
+// time instead. Copied text is kept in one strings buffer, emptied together
+// with the queue, so nothing handed out moves until the reader has to
+// parse again.
+
+enum {
+    MMUReaderStepSize = 4096,
+    MMUReaderStepNodes = 256,
+    MMUReaderInitialEvents = 64,
+    MMUReaderInitialStrings = 1024
+};
+
+typedef struct MMUReaderEvent {
+    MMUEvent event;
+    // Where event.text starts in the strings, unless it is already set
+    // because it points straight into the input
+    size_t offset;
+} MMUReaderEvent;
+
+struct MMUReader {
+    const char* html;
+    size_t len;
+    // Fed to libxml2 so far
+    size_t fed;
+    // The caller's options minus the output the reader can't express
+    MMUOptions options;
+    MMUHtmlParser parser[1];
+    MMUHtmlTokenizer tokenizer[1];
+    int native;
+    // Whether libxml2 parses the input into a tree, which happens on the
+    // first step
+    int tree;
+    int loaded;
+    int finished;
+
+    MMUReaderEvent* events;
+    size_t count;
+    size_t capacity;
+    // Next event to hand out
+    size_t next;
+    char* strings;
+    size_t stringsLen;
+    size_t stringsCapacity;
+};
+
+static MMUReaderEvent* MMUReaderAddEvent(MMUReader* reader, MMUEventType type) {
+    MMUReaderEvent* event;
+
+    if (reader->count == reader->capacity) {
+        reader->capacity = reader->capacity ? reader->capacity * 2 : MMUReaderInitialEvents;
+        reader->events = MMUReallocate(reader->options.allocator, reader->events,
+                reader->capacity * sizeof(MMUReaderEvent));
+    }
+    event = reader->events + reader->count++;
+    memset(event, 0, sizeof(MMUReaderEvent));
+    event->event.type = type;
+    return event;
+}
+
+// Copies len bytes and a terminator into the strings
+static size_t MMUReaderAddString(MMUReader* reader, const char* text, size_t len) {
+    size_t offset = reader->stringsLen;
+
+    if (offset + len + 1 > reader->stringsCapacity) {
+        size_t capacity = reader->stringsCapacity ? reader->stringsCapacity : MMUReaderInitialStrings;
+        while (capacity < offset + len + 1) {
+            capacity *= 2;
+        }
+        reader->strings = MMUReallocate(reader->options.allocator, reader->strings, capacity);
+        reader->stringsCapacity = capacity;
+    }
+    memcpy(reader->strings + offset, text, len);
+    reader->strings[offset + len] = '\0';
+    reader->stringsLen += len + 1;
+    return offset;
+}
+
+static void MMUReaderAppendText(const char* text, size_t len,
+        const MMUContext* textContext, void* callbackContext) {
+    MMUReader* reader = (MMUReader*)callbackContext;
+    MMUReaderEvent* event = MMUReaderAddEvent(reader, MMU_EVENT_TEXT);
+
+    event->event.len = len;
+    event->event.context = *textContext;
+    // Borrowed text from the input outlives the reader, so it is passed on
+    // as it is
+    if (text >= reader->html && text < reader->html + reader->len) {
+        event->event.text = text;
+    } else {
+        event->offset = MMUReaderAddString(reader, text, len);
+    }
+}
+
+static void MMUReaderStartLink(const char* href, void* callbackContext) {
+    MMUReader* reader = (MMUReader*)callbackContext;
+    MMUReaderEvent* event = MMUReaderAddEvent(reader, MMU_EVENT_START_LINK);
+
+    event->event.len = strlen(href);
+    event->offset = MMUReaderAddString(reader, href, event->event.len);
+}
+
+static void MMUReaderEndLink(void* callbackContext) {
+    MMUReaderAddEvent((MMUReader*)callbackContext, MMU_EVENT_END_LINK);
+}
+
+static void MMUReaderStartListItem(int depth, unsigned int index, void* callbackContext) {
+    MMUReaderEvent* event = MMUReaderAddEvent((MMUReader*)callbackContext, MMU_EVENT_START_LIST_ITEM);
+
+    event->event.depth = depth;
+    event->event.index = index;
+}
+
+static void MMUReaderEndListItem(void* callbackContext) {
+    MMUReaderAddEvent((MMUReader*)callbackContext, MMU_EVENT_END_LIST_ITEM);
+}
+
+static void MMUReaderFinish(void* callbackContext) {
+    ((MMUReader*)callbackContext)->finished = 1;
+}
+
+static const MMUCallbacks MMUReaderCallbacks = {
+    MMUReaderAppendText,
+    MMUReaderStartLink,
+    MMUReaderEndLink,
+    MMUReaderStartListItem,
+    MMUReaderEndListItem,
+    MMUReaderFinish,
+    NULL
+};
+
+MMUReader* mmuReaderCreate(const char* html, size_t len, const MMUOptions* options) {
+    MMUReader* reader = MMUAllocate(options->allocator, sizeof(MMUReader));
+
+    memset(reader, 0, sizeof(MMUReader));
+    reader->html = html;
+    reader->len = len;
+    reader->options = *options;
+    // Events only carry UTF-8
+    reader->options.outputFlags &= ~MMU_OUTPUT_UTF16_TEXT;
+    reader->native = MMUHtmlParserUsesNative(&reader->options);
+    reader->tree = !reader->native && len <= INT_MAX;
+    if (!reader->native) {
+        // Borrowed text would only last as long as libxml2's tree or, with
+        // the push parser, one step
+        reader->options.outputFlags &= ~MMU_OUTPUT_BORROWED_TEXT;
+    }
+
+    MMUHtmlParserInit(reader->parser, &MMUReaderCallbacks, &reader->options, reader);
+    if (reader->native || reader->tree) {
+        // Fed to libxml2 a slice at a time this is checked as it goes
+        MMUBuilderCheckInputSize(reader->parser->builder, len);
+    }
+    if (reader->native) {
+        MMUHtmlTokenizerInit(reader->tokenizer, reader->parser->builder);
+        MMUHtmlTokenizerStart(reader->tokenizer, html, len);
+    }
+    return reader;
+}
+
+void mmuReaderDestroy(MMUReader* reader) {
+    const MMUAllocator* allocator = reader->options.allocator;
+
+    if (reader->native) {
+        MMUHtmlTokenizerDestroy(reader->tokenizer);
+    }
+    MMUHtmlParserDestroy(reader->parser);
+    MMUDeallocate(allocator, reader->events);
+    MMUDeallocate(allocator, reader->strings);
+    MMUDeallocate(allocator, reader);
+}
+
+// Parses until at least one event is queued or the document is finished
+static void MMUReaderRefill(MMUReader* reader) {
+    MMUBuilder* builder = reader->parser->builder;
+
+    reader->count = 0;
+    reader->next = 0;
+    reader->stringsLen = 0;
+
+    while (reader->count == 0 && !reader->finished) {
+        if (reader->native) {
+            MMUHtmlTokenizer* tokenizer = reader->tokenizer;
+            size_t left = (size_t)(tokenizer->end - tokenizer->cur);
+
+            if (left > 0 && !builder->status) {
+                MMUHtmlTokenizerParseUntil(tokenizer,
+                        tokenizer->cur + (left < MMUReaderStepSize ? left : MMUReaderStepSize));
+            } else {
+                MMUHtmlTokenizerFinish(tokenizer);
+                MMUBuilderFinish(builder);
+            }
+        } else if (reader->tree) {
+            if (!reader->loaded && !builder->status) {
+                MMUHtmlParserLoad(reader->parser, reader->html, reader->len);
+                reader->loaded = 1;
+            }
+            if (!MMUHtmlParserWalk(reader->parser, MMUReaderStepNodes)) {
+                MMUBuilderFinish(builder);
+            }
+        } else {
+            size_t left = reader->len - reader->fed;
+
+            if (left > 0 && !builder->status) {
+                size_t size = left < MMUReaderStepSize ? left : MMUReaderStepSize;
+                MMUHtmlParserFeed(reader->parser, reader->html + reader->fed, size);
+                reader->fed += size;
+            } else {
+                MMUHtmlParserEnd(reader->parser);
+            }
+        }
+    }
+}
+
+static void MMUReaderTake(MMUReader* reader, MMUEvent* event) {
+    MMUReaderEvent* queued = reader->events + reader->next++;
+
+    *event = queued->event;
+    if (event->type == MMU_EVENT_START_LINK
+            || (event->type == MMU_EVENT_TEXT && !event->text)) {
+        event->text = reader->strings + queued->offset;
+    }
+}
+
+int mmuReaderNext(MMUReader* reader, MMUEvent* event) {
+    if (reader->next == reader->count) {
+        MMUReaderRefill(reader);
+        if (reader->count == 0) {
+            return 0;
+        }
+    }
+    MMUReaderTake(reader, event);
+    return 1;
+}
+
+size_t mmuReaderRead(MMUReader* reader, MMUEvent* events, size_t max) {
+    size_t n = 0;
+
+    if (max > 0 && reader->next == reader->count) {
+        MMUReaderRefill(reader);
+    }
+    while (n < max && reader->next < reader->count) {
+        MMUReaderTake(reader, events + n++);
+    }
+    return n;
+}
+
+MMUStatus mmuReaderStatus(const MMUReader* reader) {
+    return reader->parser->builder->status;
+}
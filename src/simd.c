@@ -0,0 +1,333 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "simd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static int isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int isWhitespace(char c) {
+    return isBlank(c) || c == '\f';
+}
+
+const char* MMUFindAny2(const char* p, const char* end, char a, char b) {
+    return MMUFindAny3(p, end, a, b, b);
+}
+
+const char* MMUFindAny3(const char* p, const char* end, char a, char b, char c) {
+#if defined(__AVX2__)
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, va),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, vb), _mm256_cmpeq_epi8(chunk, vc)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, vb), _mm_cmpeq_epi8(chunk, vc)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; ++p) {
+        if (*p == a || *p == b || *p == c) {
+            return p;
+        }
+    }
+    return end;
+}
+
+// Skips the blanks, and form feeds too unless formFeed is a space
+static const char* skipBlanks(const char* p, const char* end, char formFeed) {
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i extra = _mm256_set1_epi8(formFeed);
+
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        __m256i blanks = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, carriageReturn)));
+        blanks = _mm256_or_si256(blanks, _mm256_cmpeq_epi8(chunk, extra));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(blanks);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i extra = _mm_set1_epi8(formFeed);
+
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i blanks = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriageReturn)));
+        blanks = _mm_or_si128(blanks, _mm_cmpeq_epi8(chunk, extra));
+        unsigned int mask = ~(unsigned int)_mm_movemask_epi8(blanks) & 0xFFFF;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && (isBlank(*p) || *p == formFeed)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* MMUSkipBlanks(const char* p, const char* end) {
+    return skipBlanks(p, end, ' ');
+}
+
+const char* MMUSkipWhitespace(const char* p, const char* end) {
+    return skipBlanks(p, end, '\f');
+}
+
+const char* MMUFindCollapsible(const char* p, const char* end) {
+    // Each block also looks at the byte after it, to tell whether its last
+    // blank is followed by another
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i formFeed = _mm256_set1_epi8('\f');
+
+    while (end - p > 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        __m256i spaceBytes = _mm256_cmpeq_epi8(chunk, space);
+        __m256i blankBytes = _mm256_or_si256(
+                _mm256_or_si256(spaceBytes, _mm256_cmpeq_epi8(chunk, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, carriageReturn)));
+        blankBytes = _mm256_or_si256(blankBytes, _mm256_cmpeq_epi8(chunk, formFeed));
+        unsigned int spaces = (unsigned int)_mm256_movemask_epi8(spaceBytes);
+        unsigned int blanks = (unsigned int)_mm256_movemask_epi8(blankBytes);
+        unsigned int nextBlanks = (blanks >> 1) | ((unsigned int)isWhitespace(p[32]) << 31);
+        unsigned int mask = (blanks & ~spaces) | (blanks & nextBlanks);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i formFeed = _mm_set1_epi8('\f');
+
+    while (end - p > 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i spaceBytes = _mm_cmpeq_epi8(chunk, space);
+        __m128i blankBytes = _mm_or_si128(
+                _mm_or_si128(spaceBytes, _mm_cmpeq_epi8(chunk, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriageReturn)));
+        blankBytes = _mm_or_si128(blankBytes, _mm_cmpeq_epi8(chunk, formFeed));
+        unsigned int spaces = (unsigned int)_mm_movemask_epi8(spaceBytes);
+        unsigned int blanks = (unsigned int)_mm_movemask_epi8(blankBytes);
+        unsigned int nextBlanks = (blanks >> 1) | ((unsigned int)isWhitespace(p[16]) << 15);
+        unsigned int mask = (blanks & ~spaces) | (blanks & nextBlanks);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; ++p) {
+        if (isWhitespace(*p) && (*p != ' ' || p + 1 == end || isWhitespace(p[1]))) {
+            return p;
+        }
+    }
+    return end;
+}
+
+// Returns a pointer to the first byte in [p, end) which isn't ASCII, or end
+static const unsigned char* skipAscii(const unsigned char* p, const unsigned char* end) {
+#if defined(__AVX2__)
+    while (end - p >= 32) {
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)p));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    while (end - p >= 16) {
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && *p < 0x80) {
+        ++p;
+    }
+    return p;
+}
+
+// As skipAscii, but also widens the skipped bytes into out
+static const unsigned char* widenAscii(const unsigned char* p, const unsigned char* end,
+        unsigned short** out) {
+#if defined(__AVX2__)
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        if (_mm256_movemask_epi8(chunk)) {
+            break;
+        }
+        _mm256_storeu_si256((__m256i*)*out, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(chunk)));
+        _mm256_storeu_si256((__m256i*)(*out + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(chunk, 1)));
+        p += 32;
+        *out += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        if (_mm_movemask_epi8(chunk)) {
+            break;
+        }
+        _mm_storeu_si128((__m128i*)*out, _mm_unpacklo_epi8(chunk, zero));
+        _mm_storeu_si128((__m128i*)(*out + 8), _mm_unpackhi_epi8(chunk, zero));
+        p += 16;
+        *out += 16;
+    }
+#endif
+
+    while (p < end && *p < 0x80) {
+        *(*out)++ = *p++;
+    }
+    return p;
+}
+
+static int isContinuation(const unsigned char* p, const unsigned char* end) {
+    return p < end && (*p & 0xC0) == 0x80;
+}
+
+// Decodes the non-ASCII sequence at *p and advances past it. Anything which
+// isn't well-formed (overlong forms, surrogates, values past U+10FFFF,
+// truncated sequences) decodes to U+FFFD and consumes a single byte.
+static unsigned int decodeUtf8(const unsigned char** p, const unsigned char* end) {
+    const unsigned char* s = *p;
+    unsigned int codePoint;
+
+    if (s[0] >= 0xC2 && s[0] <= 0xDF && isContinuation(s + 1, end)) {
+        *p += 2;
+        return ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+    }
+    if (s[0] >= 0xE0 && s[0] <= 0xEF && isContinuation(s + 1, end) && isContinuation(s + 2, end)) {
+        codePoint = ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        if (codePoint >= 0x800 && (codePoint < 0xD800 || codePoint > 0xDFFF)) {
+            *p += 3;
+            return codePoint;
+        }
+    }
+    if (s[0] >= 0xF0 && s[0] <= 0xF4 && isContinuation(s + 1, end) && isContinuation(s + 2, end)
+            && isContinuation(s + 3, end)) {
+        codePoint = ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        if (codePoint >= 0x10000 && codePoint <= 0x10FFFF) {
+            *p += 4;
+            return codePoint;
+        }
+    }
+
+    *p += 1;
+    return 0xFFFD;
+}
+
+size_t MMUUtf8ToUtf16Length(const char* p, const char* end) {
+    const unsigned char* s = (const unsigned char*)p;
+    const unsigned char* e = (const unsigned char*)end;
+    size_t len = 0;
+
+    for (;;) {
+        const unsigned char* nonAscii = skipAscii(s, e);
+        len += nonAscii - s;
+        s = nonAscii;
+        if (s == e) {
+            return len;
+        }
+        len += decodeUtf8(&s, e) > 0xFFFF ? 2 : 1;
+    }
+}
+
+size_t MMUUtf8ToUtf16(const char* p, const char* end, unsigned short* out) {
+    const unsigned char* s = (const unsigned char*)p;
+    const unsigned char* e = (const unsigned char*)end;
+    unsigned short* start = out;
+
+    for (;;) {
+        unsigned int codePoint;
+
+        s = widenAscii(s, e, &out);
+        if (s == e) {
+            return out - start;
+        }
+
+        codePoint = decodeUtf8(&s, e);
+        if (codePoint > 0xFFFF) {
+            codePoint -= 0x10000;
+            *out++ = (unsigned short)(0xD800 | (codePoint >> 10));
+            *out++ = (unsigned short)(0xDC00 | (codePoint & 0x3FF));
+        } else {
+            *out++ = (unsigned short)codePoint;
+        }
+    }
+}
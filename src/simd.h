@@ -0,0 +1,59 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef MMU_SIMD_H_
+#define MMU_SIMD_H_
+
+// Byte scanning kernels used on the text paths. The widest instruction set
+// the compiler targets is chosen at build time (AVX2, then SSE2), with a
+// portable scalar fallback.
+
+#include <stddef.h>
+
+// Returns a pointer to the first byte in [p, end) equal to a or b, or end
+const char* MMUFindAny2(const char* p, const char* end, char a, char b);
+
+// Returns a pointer to the first byte in [p, end) equal to a, b or c, or end
+const char* MMUFindAny3(const char* p, const char* end, char a, char b, char c);
+
+// Returns a pointer to the first byte in [p, end) which is not one of the
+// blanks libxml2 recognises (space, tab, carriage return, newline), or end
+const char* MMUSkipBlanks(const char* p, const char* end);
+
+// MMUSkipBlanks, also skipping form feeds: the whitespace which
+// MMU_OUTPUT_COLLAPSE_WHITESPACE collapses
+const char* MMUSkipWhitespace(const char* p, const char* end);
+
+// Returns a pointer to the first byte of that whitespace in [p, end) which
+// collapsing would change: one which isn't a space, or which is followed by
+// another blank or by end. Text before it needs no collapsing.
+const char* MMUFindCollapsible(const char* p, const char* end);
+
+// Number of UTF-16 code units needed for the UTF-8 in [p, end). Invalid
+// sequences count as one U+FFFD per byte, as written by MMUUtf8ToUtf16.
+size_t MMUUtf8ToUtf16Length(const char* p, const char* end);
+
+// Transcodes the UTF-8 in [p, end) and returns the number of code units
+// written. out must have room for end - p units, which is always enough.
+size_t MMUUtf8ToUtf16(const char* p, const char* end, unsigned short* out);
+
+#endif
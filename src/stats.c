@@ -0,0 +1,53 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "stats.h"
+
+#include <time.h>
+
+unsigned long long MMUStatsNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void mmuStatsMerge(MMUStats* into, const MMUStats* from) {
+    into->documents += from->documents;
+    into->nodesVisited += from->nodesVisited;
+    into->elementsRecognised += from->elementsRecognised;
+    into->elementsIgnored += from->elementsIgnored;
+    into->flushes += from->flushes;
+    into->bytesEmitted += from->bytesEmitted;
+    into->bufferReallocations += from->bufferReallocations;
+    if (into->maxContextDepth < from->maxContextDepth) {
+        into->maxContextDepth = from->maxContextDepth;
+    }
+    if (into->maxListDepth < from->maxListDepth) {
+        into->maxListDepth = from->maxListDepth;
+    }
+    into->parseNanoseconds += from->parseNanoseconds;
+    into->walkNanoseconds += from->walkNanoseconds;
+    into->callbackNanoseconds += from->callbackNanoseconds;
+    into->totalNanoseconds += from->totalNanoseconds;
+}
@@ -0,0 +1,68 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef MMU_STATS_H_
+#define MMU_STATS_H_
+
+#include "markmeup.h"
+
+// Instrumentation hooks, which expand to nothing unless MMU_ENABLE_STATS
+// is defined. options is the MMUOptions of the parse, the counters are
+// only touched when it has a stats struct.
+
+// Monotonic nanoseconds, also behind the MMULimits timeout so always built
+unsigned long long MMUStatsNow(void);
+
+#ifdef MMU_ENABLE_STATS
+
+#define MMU_STATS_ADD(options, field, n) \
+    do { \
+        if ((options)->stats) { \
+            (options)->stats->field += (n); \
+        } \
+    } while (0)
+
+#define MMU_STATS_MAX(options, field, value) \
+    do { \
+        if ((options)->stats && (options)->stats->field < (value)) { \
+            (options)->stats->field = (value); \
+        } \
+    } while (0)
+
+// Declares a timer in the current scope, MMU_STATS_TIMER_END adds the time
+// since then to field
+#define MMU_STATS_TIMER_START(options, timer) \
+    unsigned long long timer = (options)->stats ? MMUStatsNow() : 0
+
+#define MMU_STATS_TIMER_END(options, field, timer) \
+    MMU_STATS_ADD(options, field, MMUStatsNow() - (timer))
+
+#else
+
+#define MMU_STATS_ADD(options, field, n) ((void)0)
+#define MMU_STATS_MAX(options, field, value) ((void)0)
+#define MMU_STATS_TIMER_START(options, timer) ((void)0)
+#define MMU_STATS_TIMER_END(options, field, timer) ((void)0)
+
+#endif
+
+#endif
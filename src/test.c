@@ -3,15 +3,23 @@
 #include <stdio.h>
 
 static void onAppendText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
-    printf("APPEND: [%s] [%zu] [%d] [%d] [%s]\n", text, len, (int)context->textStyle, (int)context->headingLevel, (const char*)callbackContext);
+    printf("APPEND: [%.*s] [%zu] [%d] [%d] [%s]\n", (int)len, text, len, (int)context->textStyle, (int)context->headingLevel, (const char*)callbackContext);
 }
 
-static void onMarkLink(const char* text, size_t start, size_t end, void* callbackContext) {
-    printf("MARK LINK: [%s] (%zu, %zu) [%s]\n", text, start, end, (const char*)callbackContext);
+static void onStartLink(const char* href, void* callbackContext) {
+    printf("START LINK: [%s] [%s]\n", href, (const char*)callbackContext);
 }
 
-static void onMarkParagraph(size_t start, size_t end, void* callbackContext) {
-    printf("MARK PARAGRAPH: (%zu, %zu) [%s]\n", start, end, (const char*)callbackContext);
+static void onEndLink(void* callbackContext) {
+    printf("END LINK: [%s]\n", (const char*)callbackContext);
+}
+
+static void onStartListItem(int depth, unsigned int index, void* callbackContext) {
+    printf("START LIST ITEM: [%d] [%u] [%s]\n", depth, index, (const char*)callbackContext);
+}
+
+static void onEndListItem(void* callbackContext) {
+    printf("END LIST ITEM: [%s]\n", (const char*)callbackContext);
 }
 
 static void onFinish(void* callbackContext) {
@@ -22,8 +30,10 @@ int main() {
     const char* context="Callback Context";
     MMUCallbacks callbacks = {
         onAppendText,
-        onMarkLink,
-        onMarkParagraph,
+        onStartLink,
+        onEndLink,
+        onStartListItem,
+        onEndListItem,
         onFinish
     };
     MMUOptions options = {
@@ -0,0 +1,118 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+#include <stdlib.h>
+
+// Wraps the C heap, keeping count of the blocks it hands out
+typedef struct MMUTestCountingHeap {
+    size_t allocations;
+    size_t live;
+} MMUTestCountingHeap;
+
+static void* countingAllocate(size_t size, void* userData) {
+    MMUTestCountingHeap* heap = (MMUTestCountingHeap*)userData;
+    ++heap->allocations;
+    ++heap->live;
+    return malloc(size);
+}
+
+static void* countingReallocate(void* ptr, size_t size, void* userData) {
+    MMUTestCountingHeap* heap = (MMUTestCountingHeap*)userData;
+    if (!ptr) {
+        ++heap->allocations;
+        ++heap->live;
+    }
+    return realloc(ptr, size);
+}
+
+static void countingDeallocate(void* ptr, void* userData) {
+    MMUTestCountingHeap* heap = (MMUTestCountingHeap*)userData;
+    if (ptr) {
+        --heap->live;
+    }
+    free(ptr);
+}
+
+void MMUTestAllocatorHooks(void) {
+    MMUTestCountingHeap heap;
+    MMUAllocator allocator = { countingAllocate, countingReallocate, countingDeallocate, NULL };
+    MMUArena arena;
+    MMUDocument document;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUTestText html;
+    MMUOptions options;
+    unsigned int state = 7;
+    int backend;
+    int round;
+
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+    memset(&html, 0, sizeof(html));
+    MMUTestWellFormed(&state, &html);
+    allocator.userData = &heap;
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+
+        // Everything markmeup allocates goes through the hooks and is
+        // given back by the end of the parse
+        memset(&heap, 0, sizeof(heap));
+        options.allocator = &allocator;
+        MMUTestLogClear(&actual);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &actual);
+        MMU_CHECK_LOGS(html.data, &expected, &actual);
+        MMU_CHECK(heap.allocations > 0);
+        MMU_CHECK(heap.live == 0);
+
+        // An arena which was too small the first time has grown enough by
+        // the second
+        mmuArenaInit(&arena, 64);
+        options.allocator = &arena.allocator;
+        for (round = 0; round < 2; ++round) {
+            MMUTestLogClear(&actual);
+            mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &actual);
+            MMU_CHECK_LOGS(html.data, &expected, &actual);
+            MMU_CHECK(round == 0 ? arena.overflow > 0 : arena.overflow == 0);
+            mmuArenaReset(&arena);
+        }
+        mmuArenaDestroy(&arena);
+    }
+
+    // A document keeps using its own allocator until it's destroyed
+    memset(&heap, 0, sizeof(heap));
+    mmuDocumentInit(&document);
+    document.allocator = &allocator;
+    MMUTestOptions(&options, MMU_HTML_BACKEND_NATIVE);
+    MMU_CHECK(mmuParseHtmlDocument(html.data, &options, &document) == MMU_STATUS_OK);
+    MMU_CHECK(heap.live > 0);
+    mmuDocumentDestroy(&document);
+    MMU_CHECK(heap.live == 0);
+
+    MMUTestTextDestroy(&html);
+    MMUTestLogDestroy(&expected);
+    MMUTestLogDestroy(&actual);
+}
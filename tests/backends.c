@@ -0,0 +1,65 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+enum {
+    MMUTestBackendDocuments = 5000
+};
+
+// The native tokenizer follows libxml2's recovery rules for everything but
+// misplaced html, head, body and title tags, which the generator leaves out
+void MMUTestBackendsMatch(void) {
+    unsigned int state = 0x5eed0002;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions libxml2Options;
+    MMUOptions nativeOptions;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+    MMUTestOptions(&libxml2Options, MMU_HTML_BACKEND_LIBXML2);
+    MMUTestOptions(&nativeOptions, MMU_HTML_BACKEND_NATIVE);
+
+    for (i = 0; i < MMUTestBackendDocuments; ++i) {
+        MMUTestTextClear(&html);
+        if (i % 2) {
+            MMUTestTagSoup(&state, &html, 0);
+        } else {
+            MMUTestWellFormed(&state, &html);
+        }
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &libxml2Options, &expected);
+        MMUTestLogClear(&actual);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &nativeOptions, &actual);
+
+        MMU_CHECK(MMUTestLogIsComplete(&actual));
+        MMU_CHECK_LOGS(html.data, &expected, &actual);
+    }
+
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    MMUTestTextDestroy(&html);
+}
@@ -0,0 +1,111 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+enum {
+    MMUTestBatchDocuments = 64,
+    MMUTestBatchRounds = 4
+};
+
+// Every document of a batch must come out as if parsed on its own, however
+// the threads split the work, and a pool must be reusable with other
+// options
+void MMUTestBatchMatchesSequential(void) {
+    unsigned int state = 0x5eed0011;
+    MMUTestText html[MMUTestBatchDocuments];
+    const char* inputs[MMUTestBatchDocuments];
+    MMUTestLog expected[MMUTestBatchDocuments];
+    MMUTestLog actual[MMUTestBatchDocuments];
+    void* contexts[MMUTestBatchDocuments];
+    MMUStatus statuses[MMUTestBatchDocuments];
+    MMUDocument documents[MMUTestBatchDocuments];
+    MMUDocument document;
+    MMUBatchPool* pool;
+    MMUOptions options;
+    int round;
+    int i;
+
+    memset(html, 0, sizeof(html));
+    memset(expected, 0, sizeof(expected));
+    memset(actual, 0, sizeof(actual));
+    for (i = 0; i < MMUTestBatchDocuments; ++i) {
+        int fragments = 1 + (int)(MMUTestRandom(&state) % 8);
+        while (fragments-- > 0) {
+            if (MMUTestRandom(&state) % 2) {
+                MMUTestWellFormed(&state, html + i);
+            } else {
+                MMUTestTagSoup(&state, html + i, i % 2);
+            }
+        }
+        inputs[i] = html[i].data;
+        contexts[i] = actual + i;
+        mmuDocumentInit(documents + i);
+    }
+    mmuDocumentInit(&document);
+
+    pool = mmuBatchPoolCreate(4, NULL);
+    for (round = 0; round < MMUTestBatchRounds; ++round) {
+        // Both back-ends, and the pool's threads or a one-off batch
+        MMUTestOptions(&options, round % 2 ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2);
+        for (i = 0; i < MMUTestBatchDocuments; ++i) {
+            MMUTestLogClear(expected + i);
+            mmuParseHtml(inputs[i], &mmuTestLogCallbacks, &options, expected + i);
+            MMUTestLogClear(actual + i);
+            statuses[i] = MMU_STATUS_TIMED_OUT;
+        }
+
+        if (round < 2) {
+            mmuParseHtmlBatchPooled(pool, inputs, MMUTestBatchDocuments, &mmuTestLogCallbacks,
+                    &options, contexts, statuses);
+        } else {
+            mmuParseHtmlBatch(inputs, MMUTestBatchDocuments, &mmuTestLogCallbacks,
+                    &options, contexts, statuses, 3);
+        }
+        for (i = 0; i < MMUTestBatchDocuments; ++i) {
+            MMU_CHECK(statuses[i] == MMU_STATUS_OK);
+            MMU_CHECK(MMUTestLogIsComplete(actual + i));
+            MMU_CHECK_LOGS(inputs[i], expected + i, actual + i);
+        }
+
+        mmuParseHtmlDocumentBatchPooled(pool, inputs, MMUTestBatchDocuments, &options, documents, NULL);
+        for (i = 0; i < MMUTestBatchDocuments; ++i) {
+            mmuParseHtmlDocument(inputs[i], &options, &document);
+            MMU_CHECK(documents[i].textLen == document.textLen
+                    && memcmp(documents[i].text, document.text, document.textLen) == 0);
+            MMU_CHECK(documents[i].spanCount == document.spanCount);
+        }
+    }
+
+    // Batches smaller than the pool, down to none at all
+    mmuParseHtmlBatchPooled(pool, inputs, 1, &mmuTestLogCallbacks, &options, contexts, statuses);
+    mmuParseHtmlBatchPooled(pool, inputs, 0, &mmuTestLogCallbacks, &options, contexts, statuses);
+    mmuBatchPoolDestroy(pool);
+
+    for (i = 0; i < MMUTestBatchDocuments; ++i) {
+        MMUTestTextDestroy(html + i);
+        MMUTestLogDestroy(expected + i);
+        MMUTestLogDestroy(actual + i);
+        mmuDocumentDestroy(documents + i);
+    }
+    mmuDocumentDestroy(&document);
+}
@@ -0,0 +1,71 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+enum {
+    MMUTestBinaryDocuments = 300
+};
+
+// Replaying an encoding must make exactly the callbacks which wrote it,
+// and a truncated encoding must be refused before finish
+void MMUTestBinaryRoundTrip(void) {
+    unsigned int state = 0x5eed0006;
+    MMUBinaryWriter writer;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+    mmuBinaryWriterInit(&writer);
+
+    for (i = 0; i < MMUTestBinaryDocuments; ++i) {
+        size_t cut;
+
+        MMUTestTextClear(&html);
+        MMUTestTagSoup(&state, &html, 1);
+        MMUTestWellFormed(&state, &html);
+        MMUTestOptions(&options, i % 2 ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2);
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+
+        mmuBinaryWriterClear(&writer);
+        mmuParseHtmlBinary(html.data, &options, &writer);
+        MMUTestLogClear(&actual);
+        MMU_CHECK(mmuBinaryReplay(writer.data, writer.len, &mmuTestLogCallbacks, &actual));
+        MMU_CHECK_LOGS(html.data, &expected, &actual);
+
+        cut = MMUTestRandom(&state) % writer.len;
+        MMUTestLogClear(&actual);
+        MMU_CHECK(!mmuBinaryReplay(writer.data, cut, &mmuTestLogCallbacks, &actual));
+        MMU_CHECK(!actual.finished);
+    }
+
+    mmuBinaryWriterDestroy(&writer);
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    MMUTestTextDestroy(&html);
+}
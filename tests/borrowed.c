@@ -0,0 +1,119 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+// Records where each run of text came from
+typedef struct MMUTestBorrowLog {
+    MMUTestLog log;
+    const char* input;
+    size_t inputLen;
+    // One character per run: 'i' for text inside the input, 'c' for a copy
+    char origins[16];
+    size_t runCount;
+} MMUTestBorrowLog;
+
+static void onAppendText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
+    MMUTestBorrowLog* borrowLog = (MMUTestBorrowLog*)callbackContext;
+    int inside = text >= borrowLog->input && text + len <= borrowLog->input + borrowLog->inputLen;
+
+    if (borrowLog->runCount + 1 < sizeof(borrowLog->origins)) {
+        borrowLog->origins[borrowLog->runCount++] = inside ? 'i' : 'c';
+    }
+    mmuTestLogCallbacks.appendText(text, len, context, &borrowLog->log);
+}
+
+static void onStartLink(const char* href, void* callbackContext) {
+    mmuTestLogCallbacks.startLink(href, &((MMUTestBorrowLog*)callbackContext)->log);
+}
+
+static void onEndLink(void* callbackContext) {
+    mmuTestLogCallbacks.endLink(&((MMUTestBorrowLog*)callbackContext)->log);
+}
+
+static void onStartListItem(int depth, unsigned int index, void* callbackContext) {
+    mmuTestLogCallbacks.startListItem(depth, index, &((MMUTestBorrowLog*)callbackContext)->log);
+}
+
+static void onEndListItem(void* callbackContext) {
+    mmuTestLogCallbacks.endListItem(&((MMUTestBorrowLog*)callbackContext)->log);
+}
+
+static void onFinish(void* callbackContext) {
+    mmuTestLogCallbacks.finish(&((MMUTestBorrowLog*)callbackContext)->log);
+}
+
+static const MMUCallbacks borrowCallbacks = {
+    onAppendText, onStartLink, onEndLink, onStartListItem, onEndListItem, onFinish, NULL
+};
+
+static void parseBorrowed(MMUTestBorrowLog* borrowLog, const char* html, const MMUOptions* options) {
+    MMUTestLogClear(&borrowLog->log);
+    borrowLog->input = html;
+    borrowLog->inputLen = strlen(html);
+    memset(borrowLog->origins, 0, sizeof(borrowLog->origins));
+    borrowLog->runCount = 0;
+    mmuParseHtml(html, &borrowCallbacks, options, borrowLog);
+}
+
+void MMUTestBorrowedText(void) {
+    // Plain runs are passed on from the input, while the decoded entity
+    // and the text after a separator are copies
+    static const char html[] = "<p>hello <b>bold</b> x &amp; y</p><p>next</p>";
+    MMUTestBorrowLog borrowLog;
+    MMUTestLog expected;
+    MMUTestText soup;
+    MMUOptions options;
+    unsigned int state = 11;
+    int backend;
+    int i;
+
+    memset(&borrowLog, 0, sizeof(borrowLog));
+    memset(&expected, 0, sizeof(expected));
+    memset(&soup, 0, sizeof(soup));
+
+    MMUTestOptions(&options, MMU_HTML_BACKEND_NATIVE);
+    options.outputFlags = MMU_OUTPUT_BORROWED_TEXT;
+    parseBorrowed(&borrowLog, html, &options);
+    MMU_CHECK(strcmp(borrowLog.log.text.data,
+            "T0/0[hello ]\nT1/0[bold]\nT0/0[ x & y\n\nnext]\nF\n") == 0);
+    MMU_CHECK(strcmp(borrowLog.origins, "iic") == 0);
+
+    // Borrowing never changes what is passed on
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        for (i = 0; i < 20; ++i) {
+            MMUTestTextClear(&soup);
+            MMUTestTagSoup(&state, &soup, i % 2);
+            MMUTestLogClear(&expected);
+            mmuParseHtml(soup.data, &mmuTestLogCallbacks, &options, &expected);
+            options.outputFlags = MMU_OUTPUT_BORROWED_TEXT;
+            parseBorrowed(&borrowLog, soup.data, &options);
+            options.outputFlags = 0;
+            MMU_CHECK_LOGS(soup.data, &expected, &borrowLog.log);
+        }
+    }
+
+    MMUTestTextDestroy(&soup);
+    MMUTestLogDestroy(&expected);
+    MMUTestLogDestroy(&borrowLog.log);
+}
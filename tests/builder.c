@@ -0,0 +1,114 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+#include <stdio.h>
+
+// Appends count copies of string to text
+static void appendRepeated(MMUTestText* text, const char* string, int count) {
+    while (count-- > 0) {
+        MMUTestTextAppendString(text, string);
+    }
+}
+
+// Nesting deeper than the builder's inline stacks spills them to the heap
+static void checkDeepNesting(const MMUOptions* options) {
+    MMUTestText html;
+    MMUTestText expected;
+    MMUTestLog log;
+    int depth = 40;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&log, 0, sizeof(log));
+
+    // Styles: each element pushes a context, and the runs must pop back
+    MMUTestTextAppendString(&html, "<i>");
+    appendRepeated(&html, "<b>", depth);
+    MMUTestTextAppendString(&html, "x");
+    appendRepeated(&html, "</b>", depth);
+    MMUTestTextAppendString(&html, "y</i>z");
+    mmuParseHtml(html.data, &mmuTestLogCallbacks, options, &log);
+    MMU_CHECK(strcmp(log.text.data, "T3/0[x]\nT2/0[y]\nT0/0[z]\nF\n") == 0);
+
+    // Lists: each level is a list and a span
+    MMUTestTextClear(&html);
+    MMUTestLogClear(&log);
+    for (i = 1; i <= depth; ++i) {
+        char line[32];
+        snprintf(line, sizeof(line), "I%d.0\n", i);
+        MMUTestTextAppendString(&expected, line);
+        MMUTestTextAppendString(&html, "<ul><li>");
+    }
+    MMUTestTextAppendString(&html, "<a href=x>x</a>");
+    appendRepeated(&html, "</li></ul>", depth);
+    MMUTestTextAppendString(&expected, "L[x]\nT0/0[x]\n/L\n");
+    appendRepeated(&expected, "/I\n", depth);
+    MMUTestTextAppendString(&expected, "F\n");
+    mmuParseHtml(html.data, &mmuTestLogCallbacks, options, &log);
+    MMU_CHECK(strcmp(log.text.data, expected.data) == 0);
+
+    MMUTestTextDestroy(&html);
+    MMUTestTextDestroy(&expected);
+    MMUTestLogDestroy(&log);
+}
+
+void MMUTestBuilderLimits(void) {
+    unsigned int state = 0x5eed0024;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog log;
+    MMUOptions options;
+    MMUOptions small;
+    int backend;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        small = options;
+        small.bufferSize = 1;
+
+        checkDeepNesting(&options);
+        checkDeepNesting(&small);
+
+        // A one byte text buffer grows as needed without changing the output
+        for (i = 0; i < 50; ++i) {
+            MMUTestTextClear(&html);
+            MMUTestTagSoup(&state, &html, 0);
+            MMUTestLogClear(&expected);
+            MMUTestLogClear(&log);
+            mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+            mmuParseHtml(html.data, &mmuTestLogCallbacks, &small, &log);
+            MMU_CHECK_LOGS(html.data, &expected, &log);
+        }
+    }
+
+    MMUTestTextDestroy(&html);
+    MMUTestLogDestroy(&expected);
+    MMUTestLogDestroy(&log);
+}
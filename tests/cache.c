@@ -0,0 +1,114 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+enum {
+    MMUTestCacheDocuments = 300
+};
+
+// A miss parses and records, a hit replays the recording, and both must
+// call back just like mmuParseHtml
+void MMUTestCacheMatchesParse(void) {
+    unsigned int state = 0x5eed0005;
+    MMUCache* cache = mmuCacheCreate(1 << 20, 0, NULL);
+    MMUCacheStats stats;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+
+    for (i = 0; i < MMUTestCacheDocuments; ++i) {
+        int pass;
+
+        MMUTestTextClear(&html);
+        MMUTestTagSoup(&state, &html, 1);
+        MMUTestWellFormed(&state, &html);
+        MMUTestOptions(&options, i % 2 ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2);
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+
+        for (pass = 0; pass < 2; ++pass) {
+            MMUTestLogClear(&actual);
+            mmuParseHtmlCached(cache, html.data, &mmuTestLogCallbacks, &options, &actual);
+            MMU_CHECK_LOGS(html.data, &expected, &actual);
+        }
+    }
+
+    // Generated documents may repeat, but every second parse must hit
+    mmuCacheGetStats(cache, &stats);
+    MMU_CHECK(stats.hits >= MMUTestCacheDocuments);
+    MMU_CHECK(stats.hits + stats.misses == 2 * MMUTestCacheDocuments);
+
+    mmuCacheDestroy(cache);
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    MMUTestTextDestroy(&html);
+}
+
+// A result cached without limits must not be handed to a parse with limits
+// it doesn't fit
+void MMUTestCacheKeepsLimits(void) {
+    static const char* const html = "<p>one <a href=a>two</a> <a href=b>three</a> four</p>";
+    MMUCache* cache = mmuCacheCreate(1 << 20, 0, NULL);
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    MMULimits limits;
+    int backend;
+    int i;
+
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        for (i = 0; i < 2; ++i) {
+            MMUTestOptions(&options, backend);
+            MMU_CHECK(mmuParseHtmlCached(cache, html, &mmuTestLogCallbacks, &options, &actual)
+                    == MMU_STATUS_OK);
+
+            memset(&limits, 0, sizeof(limits));
+            if (i == 0) {
+                limits.maxOutputBytes = 5;
+            } else {
+                limits.maxLinks = 1;
+            }
+            options.limits = &limits;
+            MMUTestLogClear(&expected);
+            MMU_CHECK(mmuParseHtml(html, &mmuTestLogCallbacks, &options, &expected)
+                    == (i == 0 ? MMU_STATUS_OUTPUT_TOO_LARGE : MMU_STATUS_TOO_MANY_LINKS));
+            MMUTestLogClear(&actual);
+            MMU_CHECK(mmuParseHtmlCached(cache, html, &mmuTestLogCallbacks, &options, &actual)
+                    == (i == 0 ? MMU_STATUS_OUTPUT_TOO_LARGE : MMU_STATUS_TOO_MANY_LINKS));
+            MMU_CHECK_LOGS(html, &expected, &actual);
+        }
+    }
+
+    mmuCacheDestroy(cache);
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+}
@@ -0,0 +1,331 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int mmuTestFailures;
+
+// Failures reported by the running test, the logs are only printed for the
+// first
+static int testFailures;
+
+void MMUTestTextAppend(MMUTestText* text, const char* data, size_t len) {
+    if (text->len + len + 1 > text->capacity) {
+        size_t capacity = text->capacity ? text->capacity : 256;
+        while (capacity < text->len + len + 1) {
+            capacity *= 2;
+        }
+        text->data = realloc(text->data, capacity);
+        text->capacity = capacity;
+    }
+    memcpy(text->data + text->len, data, len);
+    text->len += len;
+    text->data[text->len] = '\0';
+}
+
+void MMUTestTextAppendString(MMUTestText* text, const char* string) {
+    MMUTestTextAppend(text, string, strlen(string));
+}
+
+void MMUTestTextClear(MMUTestText* text) {
+    text->len = 0;
+    if (text->data) {
+        text->data[0] = '\0';
+    }
+}
+
+void MMUTestTextDestroy(MMUTestText* text) {
+    free(text->data);
+    memset(text, 0, sizeof(MMUTestText));
+}
+
+static void logEvent(MMUTestLog* log, const char* event) {
+    if (log->finished) {
+        log->unbalanced = 1;
+    }
+    MMUTestTextAppendString(&log->text, event);
+}
+
+static void onAppendText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
+    MMUTestLog* log = (MMUTestLog*)callbackContext;
+    char prefix[32];
+
+    snprintf(prefix, sizeof(prefix), "T%d/%d[", (int)context->textStyle, (int)context->headingLevel);
+    logEvent(log, prefix);
+    MMUTestTextAppend(&log->text, text, len);
+    MMUTestTextAppendString(&log->text, "]\n");
+}
+
+static void onStartLink(const char* href, void* callbackContext) {
+    MMUTestLog* log = (MMUTestLog*)callbackContext;
+
+    logEvent(log, "L[");
+    MMUTestTextAppendString(&log->text, href);
+    MMUTestTextAppendString(&log->text, "]\n");
+    ++log->openSpans;
+}
+
+static void endSpan(MMUTestLog* log, const char* event) {
+    logEvent(log, event);
+    if (log->openSpans == 0) {
+        log->unbalanced = 1;
+        return;
+    }
+    --log->openSpans;
+}
+
+static void onEndLink(void* callbackContext) {
+    endSpan((MMUTestLog*)callbackContext, "/L\n");
+}
+
+static void onStartListItem(int depth, unsigned int index, void* callbackContext) {
+    MMUTestLog* log = (MMUTestLog*)callbackContext;
+    char event[48];
+
+    snprintf(event, sizeof(event), "I%d.%u\n", depth, index);
+    logEvent(log, event);
+    ++log->openSpans;
+}
+
+static void onEndListItem(void* callbackContext) {
+    endSpan((MMUTestLog*)callbackContext, "/I\n");
+}
+
+static void onFinish(void* callbackContext) {
+    MMUTestLog* log = (MMUTestLog*)callbackContext;
+
+    logEvent(log, "F\n");
+    if (log->openSpans) {
+        log->unbalanced = 1;
+    }
+    log->finished = 1;
+}
+
+const MMUCallbacks mmuTestLogCallbacks = {
+    .appendText = onAppendText,
+    .startLink = onStartLink,
+    .endLink = onEndLink,
+    .startListItem = onStartListItem,
+    .endListItem = onEndListItem,
+    .finish = onFinish
+};
+
+void MMUTestLogClear(MMUTestLog* log) {
+    MMUTestTextClear(&log->text);
+    log->openSpans = 0;
+    log->unbalanced = 0;
+    log->finished = 0;
+}
+
+void MMUTestLogDestroy(MMUTestLog* log) {
+    MMUTestTextDestroy(&log->text);
+}
+
+int MMUTestLogIsComplete(const MMUTestLog* log) {
+    return log->finished && !log->unbalanced && log->openSpans == 0;
+}
+
+unsigned int MMUTestRandom(unsigned int* state) {
+    // xorshift32, state must not be 0
+    unsigned int x = *state ? *state : 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static const char* pick(unsigned int* state, const char* const* strings, size_t count) {
+    return strings[MMUTestRandom(state) % count];
+}
+
+#define MMU_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static const char* const soupTags[] = {
+    "a", "b", "i", "u", "em", "strong", "p", "br", "h1", "h2", "h3", "ul", "ol", "li", "div",
+    "span", "table", "tr", "td", "script", "style", "img", "hr", "font", "center", "form",
+    "dl", "dt", "dd", "pre", "blockquote", "x-foo", "code", "sup",
+    // Only with documentTags
+    "html", "head", "body", "title"
+};
+
+static const char* const soupTexts[] = {
+    "hello", " ", "\n", "  ", "world ", "&amp;", "&lt;", "&foo;", "&#233;", "&#x41;", "&",
+    "<", "a < b", "&nbsp;", "\r\n", "\xc3\xa9", "x", "&amp", "&#0;", "<!-- c -->", "<?php ?>",
+    "\t", "one two  three"
+};
+
+static const char* const hrefs[] = { "u", "x&amp;y", "a b", "" };
+
+void MMUTestTagSoup(unsigned int* state, MMUTestText* html, int documentTags) {
+    size_t tagCount = MMU_COUNT(soupTags) - (documentTags ? 0 : 4);
+    unsigned int parts = 1 + MMUTestRandom(state) % 14;
+    unsigned int i;
+
+    for (i = 0; i < parts; ++i) {
+        unsigned int kind = MMUTestRandom(state) % 100;
+        const char* tag = pick(state, soupTags, tagCount);
+
+        if (kind < 35) {
+            MMUTestTextAppendString(html, "<");
+            MMUTestTextAppendString(html, tag);
+            if (strcmp(tag, "a") == 0 && MMUTestRandom(state) % 5) {
+                MMUTestTextAppendString(html, " href=\"");
+                MMUTestTextAppendString(html, pick(state, hrefs, MMU_COUNT(hrefs)));
+                MMUTestTextAppendString(html, "\"");
+            }
+            if (MMUTestRandom(state) % 10 == 0) {
+                MMUTestTextAppendString(html, " data-x=\"1\"");
+            }
+            MMUTestTextAppendString(html, ">");
+        } else if (kind < 60) {
+            MMUTestTextAppendString(html, "</");
+            MMUTestTextAppendString(html, tag);
+            MMUTestTextAppendString(html, ">");
+        } else {
+            MMUTestTextAppendString(html, pick(state, soupTexts, MMU_COUNT(soupTexts)));
+        }
+    }
+}
+
+static const char* const nestedTags[] = {
+    "a", "b", "i", "u", "em", "strong", "p", "h1", "h2", "ul", "ol", "li", "div", "span",
+    "pre", "blockquote", "code", "sup"
+};
+
+static const char* const nestedTexts[] = {
+    "hello", " ", "\n", "world ", "&amp;", "&lt;", "&#233;", "x y", "\xc3\xa9", "  two  blanks "
+};
+
+static void appendNode(unsigned int* state, MMUTestText* html, int depth) {
+    const char* tag;
+    unsigned int children;
+
+    if (depth > 4 || MMUTestRandom(state) % 10 < 4) {
+        MMUTestTextAppendString(html, pick(state, nestedTexts, MMU_COUNT(nestedTexts)));
+        return;
+    }
+    tag = pick(state, nestedTags, MMU_COUNT(nestedTags));
+    MMUTestTextAppendString(html, "<");
+    MMUTestTextAppendString(html, tag);
+    if (strcmp(tag, "a") == 0) {
+        MMUTestTextAppendString(html, " href=\"");
+        MMUTestTextAppendString(html, pick(state, hrefs, MMU_COUNT(hrefs)));
+        MMUTestTextAppendString(html, "\"");
+    }
+    MMUTestTextAppendString(html, ">");
+    for (children = MMUTestRandom(state) % 4; children > 0; --children) {
+        appendNode(state, html, depth + 1);
+    }
+    MMUTestTextAppendString(html, "</");
+    MMUTestTextAppendString(html, tag);
+    MMUTestTextAppendString(html, ">");
+}
+
+void MMUTestWellFormed(unsigned int* state, MMUTestText* html) {
+    unsigned int nodes = 1 + MMUTestRandom(state) % 5;
+
+    while (nodes-- > 0) {
+        appendNode(state, html, 0);
+    }
+}
+
+void MMUTestOptions(MMUOptions* options, int htmlBackend) {
+    memset(options, 0, sizeof(MMUOptions));
+    options->lineSeparator = "\n";
+    options->paragraphSeparator = "\n\n";
+    options->htmlBackend = htmlBackend;
+}
+
+void MMUTestFail(const char* file, int line, const char* expression) {
+    ++mmuTestFailures;
+    if (testFailures++ < 10) {
+        printf("    %s:%d: %s\n", file, line, expression);
+    }
+}
+
+void MMUTestFailLogs(const char* file, int line, const char* html,
+        const MMUTestLog* expected, const MMUTestLog* actual) {
+    ++mmuTestFailures;
+    if (testFailures++ == 0) {
+        printf("    %s:%d: logs differ for input\n%s\n    expected:\n%s    actual:\n%s",
+                file, line, html, expected->text.data ? expected->text.data : "",
+                actual->text.data ? actual->text.data : "");
+    }
+}
+
+typedef struct MMUTest {
+    const char* name;
+    void (*run)(void);
+} MMUTest;
+
+static const MMUTest tests[] = {
+    { "allocator hooks", MMUTestAllocatorHooks }
+  , { "back-ends match", MMUTestBackendsMatch }
+  , { "batch matches sequential", MMUTestBatchMatchesSequential }
+  , { "binary round trip", MMUTestBinaryRoundTrip }
+  , { "borrowed text", MMUTestBorrowedText }
+  , { "builder limits", MMUTestBuilderLimits }
+  , { "cache matches parse", MMUTestCacheMatchesParse }
+  , { "cache keeps limits", MMUTestCacheKeepsLimits }
+  , { "document spans", MMUTestDocumentSpans }
+  , { "extract text", MMUTestExtractText }
+  , { "file input", MMUTestFileInput }
+  , { "html lists", MMUTestHtmlLists }
+  , { "incremental matches parse", MMUTestIncrementalMatchesParse }
+  , { "limits keep spans balanced", MMUTestLimitsKeepSpansBalanced }
+  , { "markdown matches html", MMUTestMarkdownMatchesHtml }
+  , { "parallel matches sequential", MMUTestParallelMatchesSequential }
+  , { "preview cuts", MMUTestPreviewCuts }
+  , { "reader matches parse", MMUTestReaderMatchesParse }
+  , { "runs coalesce", MMUTestRunsCoalesce }
+  , { "truncated input", MMUTestTruncatedInput }
+  , { "spans close in order", MMUTestSpansCloseInOrder }
+  , { "stats counters", MMUTestStatsCounters }
+  , { "streaming matches parse", MMUTestStreamingMatchesParse }
+  , { "tag lookup", MMUTestTagLookup }
+  , { "utf-16 output", MMUTestUtf16Output }
+  , { "whitespace collapses", MMUTestWhitespaceCollapses }
+};
+
+int main(int argc, char** argv) {
+    size_t i;
+    int failed = 0;
+
+    for (i = 0; i < MMU_COUNT(tests); ++i) {
+        int before = mmuTestFailures;
+
+        // build/check name (make check TEST=name) runs one test
+        if (argc > 1 && strcmp(argv[1], tests[i].name) != 0) {
+            continue;
+        }
+        testFailures = 0;
+        tests[i].run();
+        printf("%-40s %s\n", tests[i].name, mmuTestFailures == before ? "ok" : "FAILED");
+        failed += mmuTestFailures != before;
+    }
+    printf("%d of %d tests failed\n", failed, (int)MMU_COUNT(tests));
+    return failed != 0;
+}
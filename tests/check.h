@@ -0,0 +1,142 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef MMU_CHECK_H_
+#define MMU_CHECK_H_
+
+// Behavioural tests, run by `make check`. Each test compares parses which
+// the API promises to agree (back-ends, streaming, caching, ...) through
+// MMUTestLog, which writes every callback down as a line of text.
+
+#include "markmeup.h"
+
+#include <stddef.h>
+#include <string.h>
+
+typedef struct MMUTestText {
+    char* data;
+    size_t len;
+    size_t capacity;
+} MMUTestText;
+
+void MMUTestTextAppend(MMUTestText* text, const char* data, size_t len);
+void MMUTestTextAppendString(MMUTestText* text, const char* string);
+void MMUTestTextClear(MMUTestText* text);
+void MMUTestTextDestroy(MMUTestText* text);
+
+typedef struct MMUTestLog {
+    MMUTestText text;
+    // Links and list items started but not yet ended
+    int openSpans;
+    // Set by an end without a start, an event after finish or a finish
+    // with spans still open
+    int unbalanced;
+    int finished;
+} MMUTestLog;
+
+// Pass the log itself as the callback context
+extern const MMUCallbacks mmuTestLogCallbacks;
+
+void MMUTestLogClear(MMUTestLog* log);
+void MMUTestLogDestroy(MMUTestLog* log);
+// Whether every span was closed and finish came last, exactly once
+int MMUTestLogIsComplete(const MMUTestLog* log);
+
+// Deterministic pseudo-random numbers, so that failures can be replayed
+unsigned int MMUTestRandom(unsigned int* state);
+// Markup with arbitrary start and end tags, text, references and comments
+// in any order. Without documentTags, <html>, <head>, <body> and <title>
+// are left out.
+void MMUTestTagSoup(unsigned int* state, MMUTestText* html, int documentTags);
+// Properly nested markup which every parser reads the same way
+void MMUTestWellFormed(unsigned int* state, MMUTestText* html);
+
+extern int mmuTestFailures;
+
+void MMUTestFail(const char* file, int line, const char* expression);
+// Reports the two logs and the input they came from, once per test
+void MMUTestFailLogs(const char* file, int line, const char* html,
+        const MMUTestLog* expected, const MMUTestLog* actual);
+
+#define MMU_CHECK(expression) \
+    ((expression) ? (void)0 : MMUTestFail(__FILE__, __LINE__, #expression))
+
+#define MMU_CHECK_LOGS(html, expected, actual) \
+    ((expected)->text.len == (actual)->text.len \
+            && memcmp((expected)->text.data, (actual)->text.data, (expected)->text.len) == 0 \
+        ? (void)0 : MMUTestFailLogs(__FILE__, __LINE__, (html), (expected), (actual)))
+
+// Options as most tests use them, for the given back-end
+void MMUTestOptions(MMUOptions* options, int htmlBackend);
+
+// allocator.c
+void MMUTestAllocatorHooks(void);
+// backends.c
+void MMUTestBackendsMatch(void);
+// batch.c
+void MMUTestBatchMatchesSequential(void);
+// binary.c
+void MMUTestBinaryRoundTrip(void);
+// borrowed.c
+void MMUTestBorrowedText(void);
+// builder.c
+void MMUTestBuilderLimits(void);
+// cache.c
+void MMUTestCacheMatchesParse(void);
+void MMUTestCacheKeepsLimits(void);
+// document.c
+void MMUTestDocumentSpans(void);
+// extract.c
+void MMUTestExtractText(void);
+// file.c
+void MMUTestFileInput(void);
+// incremental.c
+void MMUTestIncrementalMatchesParse(void);
+// limits.c
+void MMUTestLimitsKeepSpansBalanced(void);
+// lists.c
+void MMUTestHtmlLists(void);
+// markdown.c
+void MMUTestMarkdownMatchesHtml(void);
+// parallel.c
+void MMUTestParallelMatchesSequential(void);
+// preview.c
+void MMUTestPreviewCuts(void);
+// reader.c
+void MMUTestReaderMatchesParse(void);
+// runs.c
+void MMUTestRunsCoalesce(void);
+// spans.c
+void MMUTestTruncatedInput(void);
+void MMUTestSpansCloseInOrder(void);
+// stats.c
+void MMUTestStatsCounters(void);
+// streaming.c
+void MMUTestStreamingMatchesParse(void);
+// tags.c
+void MMUTestTagLookup(void);
+
+// utf16.c
+void MMUTestUtf16Output(void);
+// whitespace.c
+void MMUTestWhitespaceCollapses(void);
+#endif
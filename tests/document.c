@@ -0,0 +1,82 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+typedef struct MMUTestSpan {
+    size_t start;
+    size_t length;
+    unsigned char textStyle;
+    char headingLevel;
+    int linkIndex;
+} MMUTestSpan;
+
+static int spanMatches(const MMUSpan* span, const MMUTestSpan* expected) {
+    return span->start == expected->start && span->length == expected->length
+        && span->context.textStyle == expected->textStyle
+        && span->context.headingLevel == expected->headingLevel
+        && span->linkIndex == expected->linkIndex;
+}
+
+void MMUTestDocumentSpans(void) {
+    static const char html[] =
+        "<h2>Title</h2><p>plain <b>bold <a href=\"http://x\">link</a></b> after</p>";
+    static const MMUTestSpan expected[] = {
+        { 0, 5, 0, 2, -1 },
+        { 5, 8, 0, 0, -1 },
+        { 13, 5, MMU_TEXT_STYLE_BOLD, 0, -1 },
+        { 18, 4, MMU_TEXT_STYLE_BOLD, 0, 0 },
+        { 22, 6, 0, 0, -1 }
+    };
+    MMUDocument document;
+    MMUOptions options;
+    size_t i;
+    int backend;
+    int round;
+
+    mmuDocumentInit(&document);
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        // The second round reuses the buffers of the first
+        for (round = 0; round < 2; ++round) {
+            MMU_CHECK(mmuParseHtmlDocument(html, &options, &document) == MMU_STATUS_OK);
+            MMU_CHECK(strcmp(document.text, "Title\n\nplain bold link after") == 0);
+            MMU_CHECK(document.textLen == strlen(document.text));
+            MMU_CHECK(document.spanCount == sizeof(expected) / sizeof(expected[0]));
+            for (i = 0; i < document.spanCount && i < sizeof(expected) / sizeof(expected[0]); ++i) {
+                MMU_CHECK(spanMatches(document.spans + i, expected + i));
+            }
+            MMU_CHECK(document.linkCount == 1);
+            if (document.linkCount == 1) {
+                MMU_CHECK(document.links[0].start == 18 && document.links[0].length == 4);
+                MMU_CHECK(strcmp(mmuDocumentGetHref(&document, 0), "http://x") == 0);
+            }
+        }
+    }
+
+    // Nothing from the previous parse is left over
+    MMU_CHECK(mmuParseHtmlDocument("", &options, &document) == MMU_STATUS_OK);
+    MMU_CHECK(document.spanCount == 0 && document.linkCount == 0 && document.textLen == 0);
+
+    mmuDocumentDestroy(&document);
+}
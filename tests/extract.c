@@ -0,0 +1,87 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+static const char html[] =
+    "<h1>Title</h1><p>Some  <b>bold</b>\n text, <a href=\"http://a\">one</a>"
+    " and <a href=\"b\">two</a>.</p><ul><li>x<li>y</ul>";
+
+static int hrefsMatch(const MMUText* text, const char* const* expected, size_t count) {
+    const char* href = text->hrefs;
+    size_t i;
+
+    if (text->hrefCount != count) {
+        return 0;
+    }
+    for (i = 0; i < count; ++i) {
+        if (strcmp(href, expected[i]) != 0) {
+            return 0;
+        }
+        href += strlen(href) + 1;
+    }
+    return href == text->hrefs + text->hrefsLen;
+}
+
+void MMUTestExtractText(void) {
+    static const char* const hrefs[] = { "http://a", "b" };
+    unsigned int state = 0x5eed0018;
+    MMUTestText generated;
+    MMUDocument document;
+    MMUOptions options;
+    MMUText text;
+    int backend;
+    int i;
+
+    memset(&generated, 0, sizeof(generated));
+    mmuTextInit(&text);
+    mmuDocumentInit(&document);
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        MMU_CHECK(mmuExtractText(html, &options, &text) == MMU_STATUS_OK);
+        MMU_CHECK(strcmp(text.text, "Title\n\nSome  bold\n text, one and two.\n\nxy") == 0);
+        MMU_CHECK(text.textLen == strlen(text.text));
+        MMU_CHECK(hrefsMatch(&text, hrefs, 2));
+
+        options.outputFlags = MMU_OUTPUT_COLLAPSE_WHITESPACE;
+        MMU_CHECK(mmuExtractText(html, &options, &text) == MMU_STATUS_OK);
+        MMU_CHECK(strcmp(text.text, "Title\n\nSome bold text, one and two.\n\nxy") == 0);
+        MMU_CHECK(hrefsMatch(&text, hrefs, 2));
+
+        // The text is what a full parse produces, without its spans
+        options.outputFlags = 0;
+        for (i = 0; i < 20; ++i) {
+            MMUTestTextClear(&generated);
+            MMUTestWellFormed(&state, &generated);
+            mmuExtractText(generated.data, &options, &text);
+            mmuParseHtmlDocument(generated.data, &options, &document);
+            MMU_CHECK(text.textLen == document.textLen && (document.textLen == 0
+                    || memcmp(text.text, document.text, document.textLen) == 0));
+            MMU_CHECK(text.hrefCount == document.linkCount);
+        }
+    }
+
+    MMUTestTextDestroy(&generated);
+    mmuDocumentDestroy(&document);
+    mmuTextDestroy(&text);
+}
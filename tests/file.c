@@ -0,0 +1,117 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char html[] = "<h1>File</h1><p>caf\xc3\xa9 <a href=\"x\">link</a></p><ul><li>item</ul>";
+
+static void writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            MMU_CHECK(n > 0);
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+void MMUTestFileInput(void) {
+    char path[] = "/tmp/markmeup-check-XXXXXX";
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    int backend;
+    int fds[2];
+    int fd;
+
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+
+    fd = mkstemp(path);
+    MMU_CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    writeAll(fd, html, strlen(html));
+    close(fd);
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html, &mmuTestLogCallbacks, &options, &expected);
+
+        // Mapped
+        MMUTestLogClear(&actual);
+        MMU_CHECK(mmuParseHtmlFile(path, &mmuTestLogCallbacks, &options, &actual) == MMU_STATUS_OK);
+        MMU_CHECK_LOGS(html, &expected, &actual);
+
+        // Streamed to libxml2 or read whole for the native tokenizer
+        MMU_CHECK(pipe(fds) == 0);
+        writeAll(fds[1], html, strlen(html));
+        close(fds[1]);
+        MMUTestLogClear(&actual);
+        MMU_CHECK(mmuParseHtmlFd(fds[0], &mmuTestLogCallbacks, &options, &actual) == MMU_STATUS_OK);
+        close(fds[0]);
+        MMU_CHECK_LOGS(html, &expected, &actual);
+
+        // Only len bytes are read, up to the end of the heading's text
+        MMUTestLogClear(&actual);
+        MMU_CHECK(mmuParseHtmlN(html, 8, &mmuTestLogCallbacks, &options, &actual) == MMU_STATUS_OK);
+        MMU_CHECK(strcmp(actual.text.data, "T0/1[File]\nF\n") == 0);
+
+        // A missing file and a read error still finish the document
+        MMUTestLogClear(&actual);
+        errno = 0;
+        MMU_CHECK(mmuParseHtmlFile("/nonexistent/markmeup", &mmuTestLogCallbacks, &options, &actual)
+                == MMU_STATUS_IO_ERROR);
+        MMU_CHECK(errno == ENOENT);
+        MMU_CHECK(strcmp(actual.text.data, "F\n") == 0 && MMUTestLogIsComplete(&actual));
+
+        fd = open("/tmp", O_RDONLY);
+        MMUTestLogClear(&actual);
+        errno = 0;
+        MMU_CHECK(mmuParseHtmlFd(fd, &mmuTestLogCallbacks, &options, &actual) == MMU_STATUS_IO_ERROR);
+        MMU_CHECK(errno == EISDIR);
+        MMU_CHECK(strcmp(actual.text.data, "F\n") == 0 && MMUTestLogIsComplete(&actual));
+        close(fd);
+
+        // Other encodings are converted to UTF-8, by libxml2 for both
+        options.encoding = "ISO-8859-1";
+        MMUTestLogClear(&actual);
+        MMU_CHECK(mmuParseHtml("<p>caf\xe9</p>", &mmuTestLogCallbacks, &options, &actual) == MMU_STATUS_OK);
+        MMU_CHECK(strcmp(actual.text.data, "T0/0[caf\xc3\xa9]\nF\n") == 0);
+    }
+
+    unlink(path);
+    MMUTestLogDestroy(&expected);
+    MMUTestLogDestroy(&actual);
+}
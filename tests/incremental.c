@@ -0,0 +1,299 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+    MMUTestIncrementalDocuments = 100,
+    MMUTestIncrementalEdits = 30,
+    MMUTestOutputMaxOpenSpans = 256
+};
+
+// Output as offsets, which is what deltas are in: three bytes per byte of
+// text (the byte, its style and heading level) and the links and list
+// items with the offsets they start and end at. Runs aren't kept, an edit
+// flushes at every block so they may be split differently.
+typedef struct MMUTestSpan {
+    size_t start;
+    size_t end;
+    char description[64];
+} MMUTestSpan;
+
+typedef struct MMUTestOutput {
+    MMUTestText cells;
+    MMUTestSpan* spans;
+    size_t spanCount;
+    size_t spanCapacity;
+    size_t openSpans[MMUTestOutputMaxOpenSpans];
+    unsigned int openCount;
+    int finished;
+} MMUTestOutput;
+
+static size_t outputLen(const MMUTestOutput* output) {
+    return output->cells.len / 3;
+}
+
+static void clearOutput(MMUTestOutput* output) {
+    MMUTestTextClear(&output->cells);
+    output->spanCount = 0;
+    output->openCount = 0;
+    output->finished = 0;
+}
+
+static MMUTestSpan* addSpan(MMUTestOutput* output) {
+    if (output->spanCount == output->spanCapacity) {
+        output->spanCapacity = output->spanCapacity ? output->spanCapacity * 2 : 16;
+        output->spans = realloc(output->spans, output->spanCapacity * sizeof(MMUTestSpan));
+    }
+    return output->spans + output->spanCount++;
+}
+
+static void onOutputText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
+    MMUTestOutput* output = (MMUTestOutput*)callbackContext;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        char cell[3] = { text[i], (char)context->textStyle, (char)context->headingLevel };
+        MMUTestTextAppend(&output->cells, cell, sizeof(cell));
+    }
+}
+
+static void startSpan(MMUTestOutput* output, const char* description) {
+    MMUTestSpan* span = addSpan(output);
+
+    span->start = outputLen(output);
+    span->end = (size_t)-1;
+    snprintf(span->description, sizeof(span->description), "%s", description);
+    if (output->openCount < MMUTestOutputMaxOpenSpans) {
+        output->openSpans[output->openCount++] = output->spanCount - 1;
+    }
+}
+
+static void endSpan(MMUTestOutput* output) {
+    if (output->openCount > 0) {
+        output->spans[output->openSpans[--output->openCount]].end = outputLen(output);
+    }
+}
+
+static void onOutputStartLink(const char* href, void* callbackContext) {
+    char description[64];
+    snprintf(description, sizeof(description), "L[%s]", href);
+    startSpan((MMUTestOutput*)callbackContext, description);
+}
+
+static void onOutputEndSpan(void* callbackContext) {
+    endSpan((MMUTestOutput*)callbackContext);
+}
+
+static void onOutputStartListItem(int depth, unsigned int index, void* callbackContext) {
+    char description[64];
+    snprintf(description, sizeof(description), "I%d.%u", depth, index);
+    startSpan((MMUTestOutput*)callbackContext, description);
+}
+
+static void onOutputFinish(void* callbackContext) {
+    ((MMUTestOutput*)callbackContext)->finished = 1;
+}
+
+static const MMUCallbacks outputCallbacks = {
+    .appendText = onOutputText,
+    .startLink = onOutputStartLink,
+    .endLink = onOutputEndSpan,
+    .startListItem = onOutputStartListItem,
+    .endListItem = onOutputEndSpan,
+    .finish = onOutputFinish
+};
+
+// Outer spans first where several start at the same offset
+static int compareSpans(const void* a, const void* b) {
+    const MMUTestSpan* x = (const MMUTestSpan*)a;
+    const MMUTestSpan* y = (const MMUTestSpan*)b;
+
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+    if (x->end != y->end) {
+        return x->end > y->end ? -1 : 1;
+    }
+    return strcmp(x->description, y->description);
+}
+
+// Writes the output down as a log, so that two can be compared
+static void describeOutput(MMUTestOutput* output, MMUTestLog* log) {
+    char line[128];
+    size_t i;
+
+    MMUTestLogClear(log);
+    MMUTestTextAppend(&log->text, output->cells.data ? output->cells.data : "", output->cells.len);
+    MMUTestTextAppendString(&log->text, "\n");
+    qsort(output->spans, output->spanCount, sizeof(MMUTestSpan), compareSpans);
+    for (i = 0; i < output->spanCount; ++i) {
+        const MMUTestSpan* span = output->spans + i;
+        snprintf(line, sizeof(line), "%lu-%lu %s\n",
+                (unsigned long)span->start, (unsigned long)span->end, span->description);
+        MMUTestTextAppendString(&log->text, line);
+    }
+}
+
+// Patches output with the output of an edit, as the delta describes
+static void applyDelta(MMUTestOutput* output, const MMUTestOutput* edit, const MMUOutputDelta* delta) {
+    size_t previousLen = outputLen(output);
+    size_t removedEnd = delta->outputStart + delta->removedLen;
+    MMUTestText cells;
+    size_t kept = 0;
+    size_t i;
+
+    memset(&cells, 0, sizeof(cells));
+    MMUTestTextAppend(&cells, output->cells.data, delta->outputStart * 3);
+    MMUTestTextAppend(&cells, edit->cells.data ? edit->cells.data : "", edit->cells.len);
+    MMUTestTextAppend(&cells, output->cells.data + removedEnd * 3, (previousLen - removedEnd) * 3);
+    MMUTestTextDestroy(&output->cells);
+    output->cells = cells;
+
+    for (i = 0; i < output->spanCount; ++i) {
+        MMUTestSpan span = output->spans[i];
+        if (span.start >= delta->outputStart
+                && (span.start < removedEnd || (span.start == removedEnd && removedEnd == previousLen))) {
+            continue;
+        }
+        if (span.start >= removedEnd) {
+            span.start = span.start - delta->removedLen + delta->insertedLen;
+        }
+        if (span.end >= removedEnd && span.end != (size_t)-1) {
+            span.end = span.end - delta->removedLen + delta->insertedLen;
+        }
+        output->spans[kept++] = span;
+    }
+    output->spanCount = kept;
+    for (i = 0; i < edit->spanCount; ++i) {
+        MMUTestSpan* span = addSpan(output);
+        *span = edit->spans[i];
+        span->start += delta->outputStart;
+        span->end += delta->outputStart;
+    }
+}
+
+static void destroyOutput(MMUTestOutput* output) {
+    MMUTestTextDestroy(&output->cells);
+    free(output->spans);
+}
+
+static void appendFragment(unsigned int* state, MMUTestText* html) {
+    if (MMUTestRandom(state) % 2) {
+        MMUTestWellFormed(state, html);
+    } else {
+        MMUTestTagSoup(state, html, 0);
+    }
+}
+
+// Every edit's output, patched into the previous output, must give the
+// output of parsing the edited document from scratch
+void MMUTestIncrementalMatchesParse(void) {
+    unsigned int state = 0x5eed0008;
+    MMUTestText html;
+    MMUTestText edited;
+    MMUTestText inserted;
+    MMUTestOutput patched;
+    MMUTestOutput edit;
+    MMUTestOutput full;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&edited, 0, sizeof(edited));
+    memset(&inserted, 0, sizeof(inserted));
+    memset(&patched, 0, sizeof(patched));
+    memset(&edit, 0, sizeof(edit));
+    memset(&full, 0, sizeof(full));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+
+    for (i = 0; i < MMUTestIncrementalDocuments; ++i) {
+        MMUIncrementalParser* parser;
+        int fragment;
+        int step;
+
+        // Mostly the native tokenizer, which re-parses only part of the
+        // document, and libxml2 now and then, which re-parses it all
+        MMUTestOptions(&options, i % 10 ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2);
+        parser = mmuIncrementalParserCreate(&options);
+
+        MMUTestTextClear(&html);
+        for (fragment = 0; fragment < 20; ++fragment) {
+            appendFragment(&state, &html);
+            MMUTestTextAppendString(&html, MMUTestRandom(&state) % 2 ? "<p>" : "\n<div>");
+        }
+        clearOutput(&patched);
+        mmuIncrementalParserParse(parser, html.data, html.len, &outputCallbacks, &patched);
+
+        for (step = 0; step < MMUTestIncrementalEdits; ++step) {
+            MMUEdit change;
+            MMUOutputDelta delta;
+
+            MMUTestTextClear(&inserted);
+            if (MMUTestRandom(&state) % 3) {
+                appendFragment(&state, &inserted);
+            }
+            change.start = MMUTestRandom(&state) % (html.len + 1);
+            change.removedLen = MMUTestRandom(&state) % 16;
+            if (change.removedLen > html.len - change.start) {
+                change.removedLen = html.len - change.start;
+            }
+            change.insertedLen = inserted.len;
+
+            MMUTestTextClear(&edited);
+            MMUTestTextAppend(&edited, html.data, change.start);
+            MMUTestTextAppend(&edited, inserted.data ? inserted.data : "", inserted.len);
+            MMUTestTextAppend(&edited, html.data + change.start + change.removedLen,
+                    html.len - change.start - change.removedLen);
+            MMUTestTextClear(&html);
+            MMUTestTextAppend(&html, edited.data, edited.len);
+
+            clearOutput(&edit);
+            mmuIncrementalParserEdit(parser, html.data, html.len, &change, &outputCallbacks, &edit, &delta);
+            MMU_CHECK(edit.finished && edit.openCount == 0);
+            MMU_CHECK(outputLen(&edit) == delta.insertedLen);
+            applyDelta(&patched, &edit, &delta);
+
+            clearOutput(&full);
+            mmuParseHtmlN(html.data, html.len, &outputCallbacks, &options, &full);
+            describeOutput(&full, &expected);
+            describeOutput(&patched, &actual);
+            MMU_CHECK_LOGS(html.data, &expected, &actual);
+        }
+        mmuIncrementalParserDestroy(parser);
+    }
+
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    destroyOutput(&full);
+    destroyOutput(&edit);
+    destroyOutput(&patched);
+    MMUTestTextDestroy(&inserted);
+    MMUTestTextDestroy(&edited);
+    MMUTestTextDestroy(&html);
+}
@@ -0,0 +1,94 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+#include "html-parser.h"
+
+enum {
+    MMUTestLimitDocuments = 2000
+};
+
+// However early a limit or a preview stops the parse, every link and list
+// item which was started is ended before finish, and finish comes once
+void MMUTestLimitsKeepSpansBalanced(void) {
+    unsigned int state = 0x5eed0007;
+    MMUTestText html;
+    MMUTestLog log;
+    MMUOptions options;
+    MMULimits limits;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&log, 0, sizeof(log));
+
+    for (i = 0; i < MMUTestLimitDocuments; ++i) {
+        MMUHtmlParser parser;
+        int fragment;
+
+        MMUTestTextClear(&html);
+        for (fragment = 0; fragment < 4; ++fragment) {
+            if (MMUTestRandom(&state) % 2) {
+                MMUTestWellFormed(&state, &html);
+            } else {
+                MMUTestTagSoup(&state, &html, 1);
+            }
+        }
+
+        MMUTestOptions(&options, i % 2 ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2);
+        memset(&limits, 0, sizeof(limits));
+        switch (MMUTestRandom(&state) % 5) {
+            case 0:
+                limits.maxNodes = 1 + MMUTestRandom(&state) % 30;
+                break;
+            case 1:
+                limits.maxDepth = 1 + MMUTestRandom(&state) % 6;
+                break;
+            case 2:
+                limits.maxOutputBytes = 1 + MMUTestRandom(&state) % 40;
+                break;
+            case 3:
+                limits.maxLinks = 1 + MMUTestRandom(&state) % 3;
+                break;
+            default:
+                options.previewLength = 1 + MMUTestRandom(&state) % 40;
+                options.previewEllipsis = MMUTestRandom(&state) % 2 ? "..." : NULL;
+                break;
+        }
+        if (!options.previewLength) {
+            options.limits = &limits;
+        }
+
+        MMUTestLogClear(&log);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &log);
+        MMU_CHECK(MMUTestLogIsComplete(&log));
+
+        MMUTestLogClear(&log);
+        MMUHtmlParserInit(&parser, &mmuTestLogCallbacks, &options, &log);
+        MMUHtmlParserFeed(&parser, html.data, html.len);
+        MMUHtmlParserEnd(&parser);
+        MMUHtmlParserDestroy(&parser);
+        MMU_CHECK(MMUTestLogIsComplete(&log));
+    }
+
+    MMUTestLogDestroy(&log);
+    MMUTestTextDestroy(&html);
+}
@@ -0,0 +1,61 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+typedef struct MMUTestListCase {
+    const char* html;
+    const char* expected;
+} MMUTestListCase;
+
+static const MMUTestListCase listCases[] = {
+    { "<ul><li>a</li><li>b</li></ul>",
+      "I1.0\nT0/0[a]\n/I\nI1.0\nT0/0[b]\n/I\nF\n" },
+    { "x<ol><li>a<li><b>b</b></ol>",
+      "T0/0[x\n\n]\nI1.1\nT0/0[a]\n/I\nI1.2\nT1/0[b]\n/I\nF\n" },
+    { "<ul><li>a<ol><li>b</ol></ul>",
+      "I1.0\nT0/0[a\n\n]\nI2.1\nT0/0[b]\n/I\n/I\nF\n" },
+    { "<ol start=\"3\"><li>a<li>b</ol><ol start=x><li>c</ol>",
+      "I1.3\nT0/0[a]\n/I\nI1.4\nT0/0[b]\n/I\nT0/0[\n\n]\nI1.1\nT0/0[c]\n/I\nF\n" },
+    // Not in a list
+    { "<li>a</li>", "T0/0[a]\nF\n" },
+    { "<li><ul><li>a</ul></li>", "I1.0\nT0/0[a]\n/I\nF\n" }
+};
+
+void MMUTestHtmlLists(void) {
+    MMUTestLog log;
+    MMUOptions options;
+    size_t i;
+    int backend;
+
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        for (i = 0; i < sizeof(listCases) / sizeof(listCases[0]); ++i) {
+            MMUTestLogClear(&log);
+            mmuParseHtml(listCases[i].html, &mmuTestLogCallbacks, &options, &log);
+            MMU_CHECK(strcmp(log.text.data, listCases[i].expected) == 0);
+        }
+    }
+    MMUTestLogDestroy(&log);
+}
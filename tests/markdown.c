@@ -0,0 +1,87 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+typedef struct MMUTestMarkdownCase {
+    const char* markdown;
+    const char* html;
+} MMUTestMarkdownCase;
+
+// Markdown and the html it stands for, which must give the same callbacks
+static const MMUTestMarkdownCase equivalentCases[] = {
+    { "*a* **b** `c`", "<p><em>a</em> <strong>b</strong> <code>c</code></p>" },
+    { "a  \nb", "<p>a<br>b</p>" },
+    { "a\n\nb\nc", "<p>a</p><p>b\nc</p>" },
+    { "[x](http://y) <http://z>", "<p><a href=\"http://y\">x</a> <a href=\"http://z\">http://z</a></p>" },
+    { "# h\n\npara", "<h1>h</h1><p>para</p>" },
+    { "Setext\n===\n\n- a", "<h1>Setext</h1><ul><li>a</li></ul>" },
+    { "- a\n- *b*", "<ul><li>a</li><li><em>b</em></li></ul>" },
+    { "3. a\n4. b", "<ol start=\"3\"><li>a</li><li>b</li></ol>" },
+    { "x\n\n- a\n  - b\n- c", "<p>x</p><ul><li>a<ul><li>b</li></ul></li><li>c</li></ul>" },
+    { "- a\n\n  b", "<ul><li>a<p>b</p></li></ul>" }
+};
+
+typedef struct MMUTestMarkdownDifference {
+    const char* markdown;
+    const char* expected;
+} MMUTestMarkdownDifference;
+
+// Where the result is documented to differ from the html: headings are
+// separated from the text before them, and items always start like those
+// of a tight list
+static const MMUTestMarkdownDifference differentCases[] = {
+    { "para\n\n# h", "T0/0[para\n\n]\nT0/1[h]\nF\n" },
+    { "- a\n\n- b", "I1.0\nT0/0[a]\n/I\nI1.0\nT0/0[b]\n/I\nF\n" }
+};
+
+void MMUTestMarkdownMatchesHtml(void) {
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    size_t i;
+    int backend;
+
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        for (i = 0; i < sizeof(equivalentCases) / sizeof(equivalentCases[0]); ++i) {
+            MMUTestLogClear(&expected);
+            MMUTestLogClear(&actual);
+            mmuParseHtml(equivalentCases[i].html, &mmuTestLogCallbacks, &options, &expected);
+            mmuParseMarkdown(equivalentCases[i].markdown, &mmuTestLogCallbacks, &options, &actual);
+            MMU_CHECK_LOGS(equivalentCases[i].markdown, &expected, &actual);
+        }
+    }
+
+    MMUTestOptions(&options, MMU_HTML_BACKEND_NATIVE);
+    for (i = 0; i < sizeof(differentCases) / sizeof(differentCases[0]); ++i) {
+        MMUTestLogClear(&actual);
+        mmuParseMarkdown(differentCases[i].markdown, &mmuTestLogCallbacks, &options, &actual);
+        MMU_CHECK(strcmp(actual.text.data, differentCases[i].expected) == 0);
+    }
+
+    MMUTestLogDestroy(&expected);
+    MMUTestLogDestroy(&actual);
+}
@@ -0,0 +1,148 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compiles markmeup.hpp as C++17 and checks that its sinks see what the C
+// callbacks see. Run by `make check` after build/check.
+
+#include "markmeup.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void check(bool passed, int line, const char* expression) {
+    if (!passed) {
+        std::printf("    tests/markmeup.cpp:%d: %s\n", line, expression);
+        ++failures;
+    }
+}
+
+#define CHECK(expression) check((expression), __LINE__, #expression)
+
+// Writes every call down in the same format as tests/check.c's MMUTestLog
+struct LogSink {
+    std::string log;
+
+    void text(std::string_view text, const MMUContext& context) {
+        log += "T" + std::to_string(context.textStyle) + "/" + std::to_string(context.headingLevel)
+            + "[" + std::string(text) + "]\n";
+    }
+    void startLink(std::string_view href) {
+        log += "L[" + std::string(href) + "]\n";
+    }
+    void endLink() {
+        log += "/L\n";
+    }
+    void startListItem(int depth, unsigned int index) {
+        log += "I" + std::to_string(depth) + "." + std::to_string(index) + "\n";
+    }
+    void endListItem() {
+        log += "/I\n";
+    }
+    void finish() {
+        log += "F\n";
+    }
+};
+
+// Only text, so links are parsed with MMU_OUTPUT_IGNORE_LINKS
+struct TextSink {
+    std::string all;
+
+    void text(std::string_view run, const MMUContext&) {
+        all += run;
+    }
+};
+
+const char html[] =
+    "<h1>Title</h1><p>Some <b>bold</b> and <a href=\"http://x\">linked</a> text</p>"
+    "<ol start=\"2\"><li>one<li>two<ul><li>nested</ul></ol><p>end<br>line</p>";
+
+void sinksMatchCallbacks() {
+    markmeup::Options options;
+    LogSink pulled;
+    LogSink called;
+
+    CHECK(markmeup::parse(html, pulled, options) == MMU_STATUS_OK);
+    CHECK(mmuParseHtml(html, &markmeup::callbacks<LogSink>(), &options, &called) == MMU_STATUS_OK);
+    CHECK(pulled.log == called.log);
+    CHECK(pulled.log.find("L[http://x]\nT0/0[linked]\n/L\n") != std::string::npos);
+    CHECK(pulled.log.find("I1.2\nT0/0[one]\n/I\nI1.3\nT0/0[two\n\n]\nI2.0\nT0/0[nested]\n") != std::string::npos);
+    CHECK(pulled.log.size() >= 2 && pulled.log.compare(pulled.log.size() - 2, 2, "F\n") == 0);
+
+    LogSink markdown;
+    CHECK(markmeup::parseMarkdown("Some **bold** [linked](http://x)", markdown, options) == MMU_STATUS_OK);
+    CHECK(markdown.log == "T0/0[Some ]\nT1/0[bold]\nT0/0[ ]\nL[http://x]\nT0/0[linked]\n/L\nF\n");
+}
+
+void textSinkSkipsLinks() {
+    TextSink sink;
+    markmeup::Document document;
+
+    CHECK(markmeup::parse(html, sink) == MMU_STATUS_OK);
+    CHECK(document.parse(html) == MMU_STATUS_OK);
+    CHECK(sink.all == document.text());
+    CHECK(sink.all.find("linked text") != std::string::npos);
+    CHECK((markmeup::detail::sinkOptions<TextSink>(markmeup::Options()).outputFlags
+            & MMU_OUTPUT_IGNORE_LINKS) != 0);
+    CHECK((markmeup::detail::sinkOptions<LogSink>(markmeup::Options()).outputFlags
+            & MMU_OUTPUT_IGNORE_LINKS) == 0);
+}
+
+void readerMoves() {
+    markmeup::Reader reader("<p>a</p>");
+    markmeup::Reader moved(std::move(reader));
+    MMUEvent event;
+
+    CHECK(reader.get() == nullptr);
+    CHECK(moved.next(event) && event.type == MMU_EVENT_TEXT && std::string_view(event.text, event.len) == "a");
+    CHECK(!moved.next(event));
+    CHECK(moved.status() == MMU_STATUS_OK);
+}
+
+struct Test {
+    const char* name;
+    void (*run)();
+};
+
+const Test tests[] = {
+    { "c++ sinks match callbacks", sinksMatchCallbacks }
+  , { "c++ text sink skips links", textSinkSkipsLinks }
+  , { "c++ reader moves", readerMoves }
+};
+
+} // namespace
+
+int main() {
+    int failed = 0;
+
+    for (const Test& test : tests) {
+        int before = failures;
+        test.run();
+        std::printf("%-40s %s\n", test.name, failures == before ? "ok" : "FAILED");
+        failed += failures != before;
+    }
+    std::printf("%d of %d tests failed\n", failed, (int)(sizeof(tests) / sizeof(tests[0])));
+    return failed != 0;
+}
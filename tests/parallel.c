@@ -0,0 +1,78 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+#include "parallel.h"
+
+enum {
+    MMUTestParallelDocuments = 300,
+    // Fragments per document
+    MMUTestParallelFragments = 40
+};
+
+// Small chunks cut the documents in many places, so that chunks land both
+// where their speculative parse can be replayed and where it must be redone
+void MMUTestParallelMatchesSequential(void) {
+    unsigned int state = 0x5eed0003;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+    MMUTestOptions(&options, MMU_HTML_BACKEND_NATIVE);
+
+    for (i = 0; i < MMUTestParallelDocuments; ++i) {
+        unsigned int threadCount = 2 + MMUTestRandom(&state) % 3;
+        size_t minChunkSize = 8 + MMUTestRandom(&state) % 120;
+        int fragment;
+
+        MMUTestTextClear(&html);
+        if (i % 4 == 0) {
+            MMUTestTextAppendString(&html, "<div>");
+        }
+        for (fragment = 0; fragment < MMUTestParallelFragments; ++fragment) {
+            if (MMUTestRandom(&state) % 3) {
+                MMUTestWellFormed(&state, &html);
+            } else {
+                MMUTestTagSoup(&state, &html, i % 2);
+            }
+            MMUTestTextAppendString(&html, MMUTestRandom(&state) % 2 ? "<p>" : "<div>x</div>");
+        }
+
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+        MMUTestLogClear(&actual);
+        MMUParallelParseHtml(html.data, html.len, &mmuTestLogCallbacks, &options, &actual,
+                threadCount, minChunkSize);
+
+        MMU_CHECK(MMUTestLogIsComplete(&actual));
+        MMU_CHECK_LOGS(html.data, &expected, &actual);
+    }
+
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    MMUTestTextDestroy(&html);
+}
@@ -0,0 +1,71 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+typedef struct MMUTestPreviewCase {
+    const char* html;
+    size_t previewLength;
+    unsigned int outputFlags;
+    const char* expected;
+} MMUTestPreviewCase;
+
+static const MMUTestPreviewCase previewCases[] = {
+    // Cut inside the first word of a link, which is left out along with
+    // the blank in front of it
+    { "<p>hello <a href=x>wonderful world</a></p>", 7, MMU_OUTPUT_PREVIEW_WORDS,
+      "T0/0[hello...]\nF\n" },
+    { "<p>hello <a href=x>wonderful world</a></p>", 16, MMU_OUTPUT_PREVIEW_WORDS,
+      "T0/0[hello ]\nL[x]\nT0/0[wonderful...]\n/L\nF\n" },
+    { "<p>hello wonderful</p>", 8, MMU_OUTPUT_PREVIEW_WORDS, "T0/0[hello...]\nF\n" },
+    // Cut right where a link starts
+    { "<p>hello <a href=x>world</a></p>", 6, 0, "T0/0[hello ...]\nF\n" },
+    { "<p>hello <a href=x>world</a></p>", 8, 0,
+      "T0/0[hello ]\nL[x]\nT0/0[wo...]\n/L\nF\n" },
+    // Links which fit, empty ones included, are passed on as usual
+    { "<p>a <a href=x>b</a> c</p>", 20, MMU_OUTPUT_PREVIEW_WORDS,
+      "T0/0[a ]\nL[x]\nT0/0[b]\n/L\nT0/0[ c]\nF\n" },
+    { "<p><a href=x></a>text <a href=y>",  20, 0,
+      "L[x]\n/L\nT0/0[text ]\nL[y]\n/L\nF\n" }
+};
+
+void MMUTestPreviewCuts(void) {
+    MMUTestLog log;
+    MMUOptions options;
+    size_t i;
+    int backend;
+
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        options.previewEllipsis = "...";
+        for (i = 0; i < sizeof(previewCases) / sizeof(previewCases[0]); ++i) {
+            options.previewLength = previewCases[i].previewLength;
+            options.outputFlags = previewCases[i].outputFlags;
+            MMUTestLogClear(&log);
+            mmuParseHtml(previewCases[i].html, &mmuTestLogCallbacks, &options, &log);
+            MMU_CHECK(strcmp(log.text.data, previewCases[i].expected) == 0);
+        }
+    }
+    MMUTestLogDestroy(&log);
+}
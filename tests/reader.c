@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+enum {
+    MMUTestReaderDocuments = 2000
+};
+
+// Hands the reader's events to the log as callbacks would have come
+static void readAll(MMUReader* reader, MMUTestLog* log) {
+    MMUEvent events[7];
+    size_t count;
+    size_t i;
+
+    while ((count = mmuReaderRead(reader, events, sizeof(events) / sizeof(events[0]))) > 0) {
+        for (i = 0; i < count; ++i) {
+            const MMUEvent* event = events + i;
+            switch (event->type) {
+                case MMU_EVENT_TEXT:
+                    mmuTestLogCallbacks.appendText(event->text, event->len, &event->context, log);
+                    break;
+                case MMU_EVENT_START_LINK:
+                    mmuTestLogCallbacks.startLink(event->text, log);
+                    break;
+                case MMU_EVENT_END_LINK:
+                    mmuTestLogCallbacks.endLink(log);
+                    break;
+                case MMU_EVENT_START_LIST_ITEM:
+                    mmuTestLogCallbacks.startListItem(event->depth, event->index, log);
+                    break;
+                case MMU_EVENT_END_LIST_ITEM:
+                    mmuTestLogCallbacks.endListItem(log);
+                    break;
+            }
+        }
+    }
+    mmuTestLogCallbacks.finish(log);
+}
+
+void MMUTestReaderMatchesParse(void) {
+    unsigned int state = 0x5eed0004;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+
+    for (i = 0; i < MMUTestReaderDocuments; ++i) {
+        int backend = i % 2 ? MMU_HTML_BACKEND_NATIVE : MMU_HTML_BACKEND_LIBXML2;
+        MMUReader* reader;
+        int fragment;
+
+        // Long enough for several of the reader's steps
+        MMUTestTextClear(&html);
+        for (fragment = i % 50; fragment >= 0; --fragment) {
+            if (MMUTestRandom(&state) % 2) {
+                MMUTestWellFormed(&state, &html);
+            } else {
+                MMUTestTagSoup(&state, &html, 1);
+            }
+        }
+
+        MMUTestOptions(&options, backend);
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+        MMUTestLogClear(&actual);
+        reader = mmuReaderCreate(html.data, html.len, &options);
+        readAll(reader, &actual);
+        mmuReaderDestroy(reader);
+
+        MMU_CHECK(MMUTestLogIsComplete(&actual));
+        MMU_CHECK_LOGS(html.data, &expected, &actual);
+    }
+
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    MMUTestTextDestroy(&html);
+}
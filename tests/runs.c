@@ -0,0 +1,91 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+typedef struct MMUTestRunCase {
+    const char* html;
+    const char* expected;
+} MMUTestRunCase;
+
+// Markup which doesn't change how the text looks doesn't split its run
+static const MMUTestRunCase runCases[] = {
+    { "<p>a<span>b</span><b></b>c<i>d</i></p>", "T0/0[abc]\nT2/0[d]\nF\n" },
+    { "<b>x</b><strong>y</strong><b><i></i>z</b>", "T1/0[xyz]\nF\n" },
+    { "a<br>b&amp;c", "T0/0[a\nb&c]\nF\n" },
+    // Links and list items still end runs
+    { "a<a href=x>b</a>c", "T0/0[a]\nL[x]\nT0/0[b]\n/L\nT0/0[c]\nF\n" }
+};
+
+// Whether two runs in a row of log share a context
+static int hasSplitRun(const char* log) {
+    const char* previous = NULL;
+    const char* line;
+
+    for (line = log; *line; line = strchr(line, '\n') + 1) {
+        if (line[0] == 'T') {
+            if (previous && strncmp(previous, line, strcspn(line, "[")) == 0
+                    && previous[strcspn(line, "[")] == '[') {
+                return 1;
+            }
+            previous = line;
+        } else {
+            previous = NULL;
+        }
+        // Text may hold newlines, so skip to the end of the run
+        if (line[0] == 'T') {
+            line = strstr(line, "]\n");
+        }
+    }
+    return 0;
+}
+
+void MMUTestRunsCoalesce(void) {
+    unsigned int state = 0x5eed0019;
+    MMUTestText html;
+    MMUTestLog log;
+    MMUOptions options;
+    size_t i;
+    int backend;
+
+    memset(&html, 0, sizeof(html));
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        for (i = 0; i < sizeof(runCases) / sizeof(runCases[0]); ++i) {
+            MMUTestLogClear(&log);
+            mmuParseHtml(runCases[i].html, &mmuTestLogCallbacks, &options, &log);
+            MMU_CHECK(strcmp(log.text.data, runCases[i].expected) == 0);
+        }
+        for (i = 0; i < 50; ++i) {
+            MMUTestTextClear(&html);
+            MMUTestTagSoup(&state, &html, 0);
+            MMUTestLogClear(&log);
+            mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &log);
+            MMU_CHECK(!hasSplitRun(log.text.data));
+        }
+    }
+
+    MMUTestTextDestroy(&html);
+    MMUTestLogDestroy(&log);
+}
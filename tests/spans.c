@@ -0,0 +1,99 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+#include "html-parser.h"
+
+// Input cut off inside open elements, which libxml2 ends without the end
+// events (and the native tokenizer without end tags)
+static const char* const truncatedInputs[] = {
+    "<p><a href=x>y<",
+    "<p><a href=x>y",
+    "<a href=x><b>y</b",
+    "<ul><li>one<li><a href=\"u\">two",
+    "<ol><li><a href=a><a href=b>x<",
+    "<a href=x>y<!-- never closed"
+};
+
+void MMUTestTruncatedInput(void) {
+    MMUTestLog log;
+    MMUOptions options;
+    size_t i;
+    int backend;
+
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        for (i = 0; i < sizeof(truncatedInputs) / sizeof(truncatedInputs[0]); ++i) {
+            const char* html = truncatedInputs[i];
+            MMUHtmlParser parser;
+            size_t offset;
+
+            MMUTestLogClear(&log);
+            MMU_CHECK(mmuParseHtml(html, &mmuTestLogCallbacks, &options, &log) == MMU_STATUS_OK);
+            MMU_CHECK(MMUTestLogIsComplete(&log));
+
+            // Fed a byte at a time
+            MMUTestLogClear(&log);
+            MMUHtmlParserInit(&parser, &mmuTestLogCallbacks, &options, &log);
+            for (offset = 0; html[offset]; ++offset) {
+                MMUHtmlParserFeed(&parser, html + offset, 1);
+            }
+            MMU_CHECK(MMUHtmlParserEnd(&parser) == MMU_STATUS_OK);
+            MMUHtmlParserDestroy(&parser);
+            MMU_CHECK(MMUTestLogIsComplete(&log));
+        }
+    }
+    MMUTestLogDestroy(&log);
+}
+
+// Spans left open are closed innermost first, whether the input ended
+// inside them or the builder stopped there
+void MMUTestSpansCloseInOrder(void) {
+    static const char* const html = "<ul><li>a<a href=x>bc d<ul><li>e<a href=y>f g<";
+    static const char* const expected =
+        "I1.0\nT0/0[a]\nL[x]\nT0/0[bc d\n\n]\nI2.0\nT0/0[e]\nL[y]\nT0/0[f g]\n/L\n/I\n/L\n/I\nF\n";
+    MMUTestLog log;
+    MMUOptions options;
+    MMUHtmlParser parser;
+    int backend;
+
+    memset(&log, 0, sizeof(log));
+
+    MMUTestOptions(&options, MMU_HTML_BACKEND_LIBXML2);
+    MMUHtmlParserInit(&parser, &mmuTestLogCallbacks, &options, &log);
+    MMUHtmlParserFeed(&parser, html, strlen(html));
+    MMUHtmlParserEnd(&parser);
+    MMUHtmlParserDestroy(&parser);
+    MMU_CHECK(strcmp(log.text.data, expected) == 0);
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        options.previewLength = 3;
+        options.previewEllipsis = "";
+        MMUTestLogClear(&log);
+        mmuParseHtml(html, &mmuTestLogCallbacks, &options, &log);
+        MMU_CHECK(strcmp(log.text.data, "I1.0\nT0/0[a]\nL[x]\nT0/0[bc]\n/L\n/I\nF\n") == 0);
+    }
+    MMUTestLogDestroy(&log);
+}
@@ -0,0 +1,75 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+void MMUTestStatsCounters(void) {
+    static const char html[] = "<p>a <b>b</b> <x-y>c</x-y></p><ul><li>d<ul><li>e</ul></ul>";
+    MMUStats stats;
+    MMUStats merged;
+    MMUTestLog log;
+    MMUOptions options;
+    int backend;
+
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        memset(&stats, 0, sizeof(stats));
+        options.stats = &stats;
+        MMUTestLogClear(&log);
+        mmuParseHtml(html, &mmuTestLogCallbacks, &options, &log);
+#ifdef MMU_ENABLE_STATS
+        MMU_CHECK(stats.documents == 1);
+        // p, b, ul, li, ul and li, and the unknown x-y, next to which
+        // libxml2 reports the html and body elements it implies
+        MMU_CHECK(stats.elementsRecognised == 6);
+        MMU_CHECK(stats.elementsIgnored == (backend == MMU_HTML_BACKEND_LIBXML2 ? 3u : 1u));
+        MMU_CHECK(stats.bytesEmitted == strlen("a b c\n\nd\n\ne"));
+        MMU_CHECK(stats.maxListDepth == 2);
+        MMU_CHECK(stats.nodesVisited >= 12);
+        MMU_CHECK(stats.totalNanoseconds > 0 && stats.totalNanoseconds >= stats.parseNanoseconds);
+#else
+        // Without MMU_ENABLE_STATS the counters are left alone
+        MMU_CHECK(stats.documents == 0 && stats.nodesVisited == 0 && stats.totalNanoseconds == 0);
+#endif
+    }
+
+    // Counts add up, depths keep the deepest
+    memset(&stats, 0, sizeof(stats));
+    memset(&merged, 0, sizeof(merged));
+    stats.documents = 2;
+    stats.bytesEmitted = 10;
+    stats.maxContextDepth = 3;
+    stats.maxListDepth = 1;
+    stats.totalNanoseconds = 5;
+    merged.documents = 1;
+    merged.bytesEmitted = 4;
+    merged.maxContextDepth = 1;
+    merged.maxListDepth = 4;
+    merged.totalNanoseconds = 7;
+    mmuStatsMerge(&merged, &stats);
+    MMU_CHECK(merged.documents == 3 && merged.bytesEmitted == 14 && merged.totalNanoseconds == 12);
+    MMU_CHECK(merged.maxContextDepth == 3 && merged.maxListDepth == 4);
+
+    MMUTestLogDestroy(&log);
+}
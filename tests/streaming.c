@@ -0,0 +1,76 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+#include "html-parser.h"
+
+enum {
+    MMUTestStreamingDocuments = 500
+};
+
+void MMUTestStreamingMatchesParse(void) {
+    unsigned int state = 0x5eed0001;
+    MMUTestText html;
+    MMUTestLog expected;
+    MMUTestLog actual;
+    MMUOptions options;
+    MMUHtmlParser parser;
+    int i;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+    // Streaming always goes through libxml2, so that is what it must match
+    MMUTestOptions(&options, MMU_HTML_BACKEND_LIBXML2);
+    MMUHtmlParserInit(&parser, &mmuTestLogCallbacks, &options, &actual);
+
+    for (i = 0; i < MMUTestStreamingDocuments; ++i) {
+        size_t offset = 0;
+
+        MMUTestTextClear(&html);
+        MMUTestWellFormed(&state, &html);
+        MMUTestLogClear(&expected);
+        mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &expected);
+
+        // In chunks of 1 to 16 bytes, so that tags, entities and UTF-8
+        // sequences get split
+        MMUTestLogClear(&actual);
+        MMUHtmlParserReset(&parser, &actual);
+        while (offset < html.len) {
+            size_t size = 1 + MMUTestRandom(&state) % 16;
+            if (size > html.len - offset) {
+                size = html.len - offset;
+            }
+            MMUHtmlParserFeed(&parser, html.data + offset, size);
+            offset += size;
+        }
+        MMUHtmlParserEnd(&parser);
+
+        MMU_CHECK(MMUTestLogIsComplete(&actual));
+        MMU_CHECK_LOGS(html.data, &expected, &actual);
+    }
+
+    MMUHtmlParserDestroy(&parser);
+    MMUTestLogDestroy(&actual);
+    MMUTestLogDestroy(&expected);
+    MMUTestTextDestroy(&html);
+}
@@ -0,0 +1,47 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+#include "html-tags.h"
+
+// MMUHtmlTagLookup is written by hand, so check it against the tag table
+void MMUTestTagLookup(void) {
+    static const char* const unknownNames[] = { "", "x", "ab", "bx", "h7", "lis", "tablex", "x-foo" };
+    char name[32];
+    unsigned int tag;
+    size_t i;
+
+    for (tag = MMU_HTML_TAG_UNKNOWN + 1; tag < MMU_HTML_TAG_COUNT; ++tag) {
+        const char* tagName = MMUHtmlTagGetInfo((MMUHtmlTag)tag)->name;
+        size_t len = strlen(tagName);
+
+        MMU_CHECK(MMUHtmlTagLookup(tagName, len) == (MMUHtmlTag)tag);
+        // Prefixes and longer names are other tags or none
+        MMU_CHECK(MMUHtmlTagLookup(tagName, len - 1) != (MMUHtmlTag)tag);
+        memcpy(name, tagName, len);
+        name[len] = 'x';
+        MMU_CHECK(MMUHtmlTagLookup(name, len + 1) == MMU_HTML_TAG_UNKNOWN);
+    }
+    for (i = 0; i < sizeof(unknownNames) / sizeof(unknownNames[0]); ++i) {
+        MMU_CHECK(MMUHtmlTagLookup(unknownNames[i], strlen(unknownNames[i])) == MMU_HTML_TAG_UNKNOWN);
+    }
+}
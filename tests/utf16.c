@@ -0,0 +1,116 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+// e acute, a character outside the BMP (a surrogate pair in UTF-16) and x
+static const char html[] = "<p>\xc3\xa9<a href=\"y\">\xf0\x9f\x98\x80x</a></p>";
+static const unsigned short utf16[] = { 0x00e9, 0xd83d, 0xde00, 0x0078 };
+
+typedef struct MMUTestUtf16Text {
+    unsigned short text[16];
+    size_t len;
+    int utf8Calls;
+} MMUTestUtf16Text;
+
+static void appendText(const char* text, size_t len, const MMUContext* context, void* callbackContext) {
+    (void)text;
+    (void)len;
+    (void)context;
+    ++((MMUTestUtf16Text*)callbackContext)->utf8Calls;
+}
+
+static void appendTextUtf16(const unsigned short* text, size_t len, const MMUContext* context,
+        void* callbackContext) {
+    MMUTestUtf16Text* collected = (MMUTestUtf16Text*)callbackContext;
+
+    (void)context;
+    MMU_CHECK(text[len] == 0);
+    if (collected->len + len <= sizeof(collected->text) / sizeof(collected->text[0])) {
+        memcpy(collected->text + collected->len, text, len * sizeof(*text));
+    }
+    collected->len += len;
+}
+
+static void ignoreLink(const char* href, void* callbackContext) {
+    (void)href;
+    (void)callbackContext;
+}
+
+static void ignoreListItem(int depth, unsigned int index, void* callbackContext) {
+    (void)depth;
+    (void)index;
+    (void)callbackContext;
+}
+
+static void ignoreEnd(void* callbackContext) {
+    (void)callbackContext;
+}
+
+static const MMUCallbacks utf16Callbacks = {
+    appendText, ignoreLink, ignoreEnd, ignoreListItem, ignoreEnd, ignoreEnd, appendTextUtf16
+};
+
+void MMUTestUtf16Output(void) {
+    MMUTestUtf16Text collected;
+    MMUDocument document;
+    MMUOptions options;
+    int backend;
+
+    mmuDocumentInit(&document);
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+
+        // Offsets count code units, the text stays UTF-8
+        options.outputFlags = MMU_OUTPUT_UTF16_OFFSETS;
+        MMU_CHECK(mmuParseHtmlDocument(html, &options, &document) == MMU_STATUS_OK);
+        MMU_CHECK(document.textLen == 7 && document.utf16Len == 4);
+        MMU_CHECK(document.spanCount == 2);
+        if (document.spanCount == 2) {
+            MMU_CHECK(document.spans[0].start == 0 && document.spans[0].length == 2);
+            MMU_CHECK(document.spans[0].utf16Start == 0 && document.spans[0].utf16Length == 1);
+            MMU_CHECK(document.spans[1].start == 2 && document.spans[1].length == 5);
+            MMU_CHECK(document.spans[1].utf16Start == 1 && document.spans[1].utf16Length == 3);
+        }
+        MMU_CHECK(document.linkCount == 1);
+        if (document.linkCount == 1) {
+            MMU_CHECK(document.links[0].utf16Start == 1 && document.links[0].utf16Length == 3);
+        }
+
+        // The text itself is transcoded
+        options.outputFlags = MMU_OUTPUT_UTF16_TEXT;
+        MMU_CHECK(mmuParseHtmlDocument(html, &options, &document) == MMU_STATUS_OK);
+        MMU_CHECK(document.utf16Len == 4 && document.utf16Text);
+        if (document.utf16Text) {
+            MMU_CHECK(memcmp(document.utf16Text, utf16, sizeof(utf16)) == 0);
+        }
+
+        // And so is the text given to callbacks, through appendTextUtf16 only
+        memset(&collected, 0, sizeof(collected));
+        MMU_CHECK(mmuParseHtml(html, &utf16Callbacks, &options, &collected) == MMU_STATUS_OK);
+        MMU_CHECK(collected.utf8Calls == 0);
+        MMU_CHECK(collected.len == 4 && memcmp(collected.text, utf16, sizeof(utf16)) == 0);
+    }
+
+    mmuDocumentDestroy(&document);
+}
@@ -0,0 +1,109 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) [2014] [Jason Choy]
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "check.h"
+
+typedef struct MMUTestWhitespaceCase {
+    const char* html;
+    const char* expected;
+} MMUTestWhitespaceCase;
+
+static const MMUTestWhitespaceCase whitespaceCases[] = {
+    { "<p> a \t\n b\r\n</p><p>\td </p>", "T0/0[a b\n\nd]\nF\n" },
+    // A run of blanks split across elements still becomes one space, which
+    // goes with the next word
+    { "a <b> b\t</b>\n<i> c</i> d", "T0/0[a]\nT1/0[ b]\nT2/0[ c]\nT0/0[ d]\nF\n" },
+    { "<pre> a\t\n  b </pre>c \n d", "T0/0[ a\t\n  b c d]\nF\n" }
+};
+
+// libxml2 drops form feeds from its input, so only the native back-end
+// passes them on to be collapsed
+static const MMUTestWhitespaceCase formFeedCases[] = {
+    { "<p> a\f\fb\f</p><p>\fc</p>", "T0/0[a b\n\nc]\nF\n" },
+    { "a\f<b>\fb</b>", "T0/0[a]\nT1/0[ b]\nF\n" },
+    { "<pre> a\f</pre>\fb", "T0/0[ a\fb]\nF\n" }
+};
+
+// Appends a line of words, with one blank before each but the first
+static void appendLine(MMUTestText* text, size_t words, size_t blankAt, const char* blank) {
+    size_t i;
+
+    for (i = 0; i < words; ++i) {
+        if (i) {
+            MMUTestTextAppendString(text, i == blankAt ? blank : " ");
+        }
+        MMUTestTextAppendString(text, "word");
+    }
+}
+
+void MMUTestWhitespaceCollapses(void) {
+    MMUTestText html;
+    MMUTestText expected;
+    MMUTestLog log;
+    MMUOptions options;
+    size_t i;
+    int backend;
+
+    memset(&html, 0, sizeof(html));
+    memset(&expected, 0, sizeof(expected));
+    memset(&log, 0, sizeof(log));
+
+    for (backend = MMU_HTML_BACKEND_LIBXML2; backend <= MMU_HTML_BACKEND_NATIVE; ++backend) {
+        MMUTestOptions(&options, backend);
+        options.outputFlags |= MMU_OUTPUT_COLLAPSE_WHITESPACE;
+        for (i = 0; i < sizeof(whitespaceCases) / sizeof(whitespaceCases[0]); ++i) {
+            MMUTestLogClear(&log);
+            mmuParseHtml(whitespaceCases[i].html, &mmuTestLogCallbacks, &options, &log);
+            MMU_CHECK(strcmp(log.text.data, whitespaceCases[i].expected) == 0);
+        }
+        if (backend == MMU_HTML_BACKEND_NATIVE) {
+            for (i = 0; i < sizeof(formFeedCases) / sizeof(formFeedCases[0]); ++i) {
+                MMUTestLogClear(&log);
+                mmuParseHtml(formFeedCases[i].html, &mmuTestLogCallbacks, &options, &log);
+                MMU_CHECK(strcmp(log.text.data, formFeedCases[i].expected) == 0);
+            }
+        }
+
+        // Lines long enough for the vector kernels, with one blank other
+        // than a space, or a run of blanks, moved across every block offset
+        for (i = 1; i < 20; ++i) {
+            const char* blank = i % 2 ? "\t" : " \r\n";
+
+            if (backend == MMU_HTML_BACKEND_NATIVE) {
+                blank = i % 2 ? "\f" : " \f\t";
+            }
+            MMUTestTextClear(&html);
+            MMUTestTextClear(&expected);
+            appendLine(&html, 20, i, blank);
+            MMUTestTextAppendString(&expected, "T0/0[");
+            appendLine(&expected, 20, i, " ");
+            MMUTestTextAppendString(&expected, "]\nF\n");
+            MMUTestLogClear(&log);
+            mmuParseHtml(html.data, &mmuTestLogCallbacks, &options, &log);
+            MMU_CHECK(strcmp(log.text.data, expected.data) == 0);
+        }
+    }
+
+    MMUTestTextDestroy(&html);
+    MMUTestTextDestroy(&expected);
+    MMUTestLogDestroy(&log);
+}